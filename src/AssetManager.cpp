@@ -0,0 +1,83 @@
+
+#include "AssetManager.hpp"
+#include "MeshCache.hpp"
+
+AssetManager::AssetManager( ThreadPool& pool )
+	: pool( pool ), completions( std::make_shared<Completions>() )
+{
+}
+
+AssetManager::~AssetManager()
+{
+	std::lock_guard<std::mutex> lock( completions->mutex );
+	completions->cancelled = true;
+}
+
+AssetHandle<Mesh> AssetManager::RequestMesh( const std::string& path, std::function<void( const Asset<Mesh>& )> onDone )
+{
+	// Goes through the binary cache, and builds the BVH if there isn't one
+	return Request<Mesh>( path, &LoadMesh, std::move( onDone ) );
+}
+
+AssetHandle<Texture> AssetManager::RequestTexture( const std::string& path, std::function<void( const Asset<Texture>& )> onDone )
+{
+	// Builds the mip chain file if there isn't one
+	return Request<Texture>( path, &LoadTexture, std::move( onDone ) );
+}
+
+void AssetManager::StartLoading( std::shared_ptr<AssetBase> asset )
+{
+	pendingCount++;
+
+	std::shared_ptr<Completions> shared = completions;
+	pool.Submit( [shared, asset]()
+	{
+		{
+			std::lock_guard<std::mutex> lock( shared->mutex );
+			if ( shared->cancelled )
+			{
+				return;
+			}
+		}
+
+		const bool loaded = asset->Load();
+		asset->state.store( loaded ? AssetState::Ready : AssetState::Failed, std::memory_order_release );
+
+		std::lock_guard<std::mutex> lock( shared->mutex );
+		shared->finished.push_back( asset );
+	} );
+}
+
+void AssetManager::RunCallbacks( AssetBase& asset )
+{
+	// A callback might request more assets, so don't iterate the original
+	const auto callbacks = std::move( asset.readyCallbacks );
+	asset.readyCallbacks.clear();
+
+	for ( const auto& callback : callbacks )
+	{
+		callback();
+	}
+}
+
+void AssetManager::Update()
+{
+	std::vector<std::shared_ptr<AssetBase>> justFinished;
+	{
+		std::lock_guard<std::mutex> lock( completions->mutex );
+		justFinished.swap( completions->finished );
+	}
+
+	pendingCount -= justFinished.size();
+	for ( const std::shared_ptr<AssetBase>& asset : justFinished )
+	{
+		RunCallbacks( *asset );
+	}
+
+	std::vector<std::shared_ptr<AssetBase>> requestedAgain;
+	requestedAgain.swap( alreadyFinished );
+	for ( const std::shared_ptr<AssetBase>& asset : requestedAgain )
+	{
+		RunCallbacks( *asset );
+	}
+}
@@ -0,0 +1,161 @@
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
+#include "Mesh.hpp"
+#include "Texture.hpp"
+#include "ThreadPool.hpp"
+
+enum class AssetState
+{
+	Loading,
+	Ready,
+	Failed
+};
+
+// Something that gets loaded in the background. The data is only there once it's ready,
+// until then whoever uses it is expected to draw a placeholder
+class AssetBase
+{
+public:
+	virtual ~AssetBase() = default;
+
+	AssetState GetState() const
+	{
+		return state.load( std::memory_order_acquire );
+	}
+
+	bool IsReady() const
+	{
+		return GetState() == AssetState::Ready;
+	}
+
+	const std::string& GetPath() const
+	{
+		return path;
+	}
+
+protected:
+	friend class AssetManager;
+
+	// Runs on a worker thread: read, decode and build whatever acceleration structures it needs
+	virtual bool Load() = 0;
+
+	std::string path;
+	std::atomic<AssetState> state{ AssetState::Loading };
+	// Only touched on the main thread
+	std::vector<std::function<void()>> readyCallbacks;
+};
+
+template<typename T>
+class Asset : public AssetBase
+{
+public:
+	// Null until the asset is ready
+	const std::shared_ptr<const T>& Get() const
+	{
+		return data;
+	}
+
+protected:
+	friend class AssetManager;
+
+	using Loader = bool( const char* path, T& outData );
+
+	bool Load() override
+	{
+		auto loaded = std::make_shared<T>();
+		if ( !loader( path.c_str(), *loaded ) )
+		{
+			return false;
+		}
+
+		data = std::move( loaded );
+		return true;
+	}
+
+	Loader* loader{ nullptr };
+	std::shared_ptr<const T> data;
+};
+
+template<typename T>
+using AssetHandle = std::shared_ptr<Asset<T>>;
+
+// Loads assets on a thread pool, so the render loop never waits on the disk or on BVH builds
+// Requests and callbacks are main-thread only; asking for the same path twice gives the same asset
+class AssetManager
+{
+public:
+	explicit AssetManager( ThreadPool& pool );
+	// Loads that haven't started yet get skipped, the ones in flight finish without reporting back
+	~AssetManager();
+
+	// The callback runs on the main thread, from Update, once the asset either loaded or failed
+	AssetHandle<Mesh> RequestMesh( const std::string& path, std::function<void( const Asset<Mesh>& )> onDone = nullptr );
+	// Only the pinned mip tail gets loaded here, the TextureCache streams the rest
+	AssetHandle<Texture> RequestTexture( const std::string& path, std::function<void( const Asset<Texture>& )> onDone = nullptr );
+
+	// Call once per frame, runs the callbacks of the assets that finished since the last call
+	void Update();
+
+	uint32_t GetPendingCount() const
+	{
+		return pendingCount;
+	}
+
+private:
+	template<typename T>
+	AssetHandle<T> Request( const std::string& path, typename Asset<T>::Loader* loader, std::function<void( const Asset<T>& )> onDone )
+	{
+		std::shared_ptr<AssetBase>& cached = assets[path];
+		AssetHandle<T> asset = std::dynamic_pointer_cast<Asset<T>>( cached );
+		const bool isNew = asset == nullptr;
+
+		if ( isNew )
+		{
+			asset = std::make_shared<Asset<T>>();
+			asset->path = path;
+			asset->loader = loader;
+			cached = asset;
+		}
+
+		if ( onDone )
+		{
+			Asset<T>* raw = asset.get();
+			asset->readyCallbacks.push_back( [raw, onDone]() { onDone( *raw ); } );
+		}
+
+		if ( isNew )
+		{
+			StartLoading( asset );
+		}
+		else if ( asset->GetState() != AssetState::Loading && onDone )
+		{
+			// Already done, so just get the callback to run on the next update
+			alreadyFinished.push_back( asset );
+		}
+
+		return asset;
+	}
+
+	void StartLoading( std::shared_ptr<AssetBase> asset );
+	static void RunCallbacks( AssetBase& asset );
+
+	// Shared with the tasks, so that they can outlive the manager
+	struct Completions
+	{
+		std::mutex mutex;
+		std::vector<std::shared_ptr<AssetBase>> finished;
+		bool cancelled{ false };
+	};
+
+	ThreadPool& pool;
+	std::shared_ptr<Completions> completions;
+	std::unordered_map<std::string, std::shared_ptr<AssetBase>> assets;
+	// Requested again after they were done, main thread only
+	std::vector<std::shared_ptr<AssetBase>> alreadyFinished;
+	uint32_t pendingCount{ 0 };
+};
@@ -0,0 +1,432 @@
+
+#include <algorithm>
+
+#include "Bvh.hpp"
+
+// Past this depth we just make a leaf, so the traversal stacks can be fixed-size
+constexpr uint32_t MaxDepth = 48;
+constexpr int BinCount = 16;
+// Cost of visiting a node, relative to the cost of testing one primitive
+constexpr float TraversalCost = 1.0f;
+
+constexpr uint32_t Bvh::InvalidIndex;
+
+Aabb Aabb::Transformed( const glm::mat4& matrix ) const
+{
+	if ( !IsValid() )
+	{
+		return *this;
+	}
+
+	const glm::vec3 center = Center();
+	const glm::vec3 extents = maxs - center;
+
+	const glm::vec3 newCenter = glm::vec3( matrix * glm::vec4( center, 1.0f ) );
+	glm::vec3 newExtents{ 0.0f };
+	for ( int column = 0; column < 3; column++ )
+	{
+		newExtents += glm::abs( glm::vec3( matrix[column] ) ) * extents[column];
+	}
+
+	Aabb result;
+	result.mins = newCenter - newExtents;
+	result.maxs = newCenter + newExtents;
+	return result;
+}
+
+Frustum Frustum::FromMatrix( const glm::mat4& viewProj )
+{
+	// GLM is column-major, so gather the rows first
+	glm::vec4 rows[4];
+	for ( int i = 0; i < 4; i++ )
+	{
+		rows[i] = glm::vec4( viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i] );
+	}
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0]; // Left
+	frustum.planes[1] = rows[3] - rows[0]; // Right
+	frustum.planes[2] = rows[3] + rows[1]; // Bottom
+	frustum.planes[3] = rows[3] - rows[1]; // Top
+	frustum.planes[4] = rows[3] + rows[2]; // Near
+	frustum.planes[5] = rows[3] - rows[2]; // Far
+
+	for ( glm::vec4& plane : frustum.planes )
+	{
+		plane /= glm::length( glm::vec3( plane ) );
+	}
+
+	return frustum;
+}
+
+Frustum::Result Frustum::Classify( const Aabb& box ) const
+{
+	Result result = Inside;
+	for ( const glm::vec4& plane : planes )
+	{
+		// The corners furthest along and furthest against the plane normal
+		const glm::vec3 positive
+		{
+			plane.x >= 0.0f ? box.maxs.x : box.mins.x,
+			plane.y >= 0.0f ? box.maxs.y : box.mins.y,
+			plane.z >= 0.0f ? box.maxs.z : box.mins.z
+		};
+		const glm::vec3 negative
+		{
+			plane.x >= 0.0f ? box.mins.x : box.maxs.x,
+			plane.y >= 0.0f ? box.mins.y : box.maxs.y,
+			plane.z >= 0.0f ? box.mins.z : box.maxs.z
+		};
+
+		if ( glm::dot( glm::vec3( plane ), positive ) + plane.w < 0.0f )
+		{
+			return Outside;
+		}
+		if ( glm::dot( glm::vec3( plane ), negative ) + plane.w < 0.0f )
+		{
+			result = Intersecting;
+		}
+	}
+
+	return result;
+}
+
+void Bvh::Build( const Aabb* primitiveBounds, const uint32_t& primitiveCount, const uint32_t& maxLeafSize )
+{
+	nodeStorage.clear();
+	parents.clear();
+	primitiveIndexStorage.resize( primitiveCount );
+	primitiveLeaves.assign( primitiveCount, InvalidIndex );
+	this->maxLeafSize = std::max( maxLeafSize, 1U );
+
+	if ( primitiveCount == 0 )
+	{
+		UpdateViews();
+		return;
+	}
+
+	TrackedVector<glm::vec3, MemoryTag::Bvh> centroids( primitiveCount );
+	for ( uint32_t i = 0; i < primitiveCount; i++ )
+	{
+		primitiveIndexStorage[i] = i;
+		centroids[i] = primitiveBounds[i].Center();
+	}
+
+	// A binary tree with N leaves has at most 2N - 1 nodes
+	nodeStorage.reserve( primitiveCount * 2 - 1 );
+	parents.reserve( primitiveCount * 2 - 1 );
+
+	BuildRecursive( primitiveBounds, centroids.data(), 0, primitiveCount, InvalidIndex, 0 );
+	UpdateViews();
+}
+
+void Bvh::SetExternal( const BvhNode* externalNodes, const uint32_t& externalNodeCount, const uint32_t* externalPrimitiveIndices )
+{
+	nodeStorage.clear();
+	primitiveIndexStorage.clear();
+	parents.clear();
+	primitiveLeaves.clear();
+
+	nodes = externalNodes;
+	nodeCount = externalNodeCount;
+	primitiveIndices = externalPrimitiveIndices;
+}
+
+bool Bvh::IsValidLayout( const BvhNode* externalNodes, const uint32_t& externalNodeCount,
+	const uint32_t* externalPrimitiveIndices, const uint32_t& primitiveCount )
+{
+	if ( (externalNodeCount == 0) != (primitiveCount == 0) )
+	{
+		return false;
+	}
+
+	for ( uint32_t i = 0; i < primitiveCount; i++ )
+	{
+		if ( externalPrimitiveIndices[i] >= primitiveCount )
+		{
+			return false;
+		}
+	}
+
+	// Walks the tree the way the queries do, children always come after their parent, so it can't loop,
+	// and every node has to be reached exactly once
+	struct Entry
+	{
+		uint32_t node;
+		uint32_t depth;
+	};
+
+	Entry stack[MaxDepth + 2];
+	uint32_t stackSize = 0;
+	uint32_t visited = 0;
+	if ( externalNodeCount > 0 )
+	{
+		stack[stackSize++] = { 0, 0 };
+	}
+
+	while ( stackSize > 0 )
+	{
+		const Entry entry = stack[--stackSize];
+		const BvhNode& node = externalNodes[entry.node];
+		// Reached twice, which could otherwise take forever
+		if ( ++visited > externalNodeCount )
+		{
+			return false;
+		}
+
+		if ( node.IsLeaf() )
+		{
+			if ( uint64_t( node.offset ) + node.count > primitiveCount )
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const uint32_t left = entry.node + 1;
+		if ( entry.depth >= MaxDepth || left >= externalNodeCount || node.offset <= left || node.offset >= externalNodeCount )
+		{
+			return false;
+		}
+		stack[stackSize++] = { node.offset, entry.depth + 1 };
+		stack[stackSize++] = { left, entry.depth + 1 };
+	}
+
+	return visited == externalNodeCount;
+}
+
+void Bvh::UpdateViews()
+{
+	nodes = nodeStorage.data();
+	nodeCount = nodeStorage.size();
+	primitiveIndices = primitiveIndexStorage.data();
+}
+
+uint32_t Bvh::BuildRecursive( const Aabb* primitiveBounds, const glm::vec3* centroids,
+	const uint32_t& first, const uint32_t& count, const uint32_t& parent, const uint32_t& depth )
+{
+	const uint32_t nodeIndex = nodeStorage.size();
+	nodeStorage.emplace_back();
+	parents.push_back( parent );
+
+	Aabb bounds;
+	Aabb centroidBounds;
+	for ( uint32_t i = first; i < first + count; i++ )
+	{
+		bounds.Add( primitiveBounds[primitiveIndexStorage[i]] );
+		centroidBounds.Add( centroids[primitiveIndexStorage[i]] );
+	}
+	nodeStorage[nodeIndex].bounds = bounds;
+
+	const auto makeLeaf = [&]()
+	{
+		nodeStorage[nodeIndex].offset = first;
+		nodeStorage[nodeIndex].count = count;
+		for ( uint32_t i = first; i < first + count; i++ )
+		{
+			primitiveLeaves[primitiveIndexStorage[i]] = nodeIndex;
+		}
+		return nodeIndex;
+	};
+
+	if ( count <= maxLeafSize || depth >= MaxDepth )
+	{
+		return makeLeaf();
+	}
+
+	// Find the cheapest split plane among the bin boundaries of all 3 axes
+	struct Bin
+	{
+		Aabb bounds;
+		uint32_t count{ 0 };
+	};
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestSplit = 0;
+
+	for ( int axis = 0; axis < 3; axis++ )
+	{
+		const float extent = centroidBounds.maxs[axis] - centroidBounds.mins[axis];
+		if ( extent <= 0.0f )
+		{
+			continue;
+		}
+
+		Bin bins[BinCount];
+		const float scale = BinCount / extent;
+		for ( uint32_t i = first; i < first + count; i++ )
+		{
+			const uint32_t primitive = primitiveIndexStorage[i];
+			const int bin = std::min( BinCount - 1, int( (centroids[primitive][axis] - centroidBounds.mins[axis]) * scale ) );
+			bins[bin].count++;
+			bins[bin].bounds.Add( primitiveBounds[primitive] );
+		}
+
+		// Sweep from the left, then from the right, to get the cost of each split
+		float leftAreas[BinCount - 1];
+		uint32_t leftCounts[BinCount - 1];
+		Aabb accumulated;
+		uint32_t accumulatedCount = 0;
+		for ( int i = 0; i < BinCount - 1; i++ )
+		{
+			accumulated.Add( bins[i].bounds );
+			accumulatedCount += bins[i].count;
+			leftAreas[i] = accumulatedCount ? accumulated.SurfaceArea() : 0.0f;
+			leftCounts[i] = accumulatedCount;
+		}
+
+		accumulated = Aabb();
+		accumulatedCount = 0;
+		for ( int i = BinCount - 1; i > 0; i-- )
+		{
+			accumulated.Add( bins[i].bounds );
+			accumulatedCount += bins[i].count;
+			if ( !accumulatedCount || !leftCounts[i - 1] )
+			{
+				continue;
+			}
+
+			const float cost = leftCounts[i - 1] * leftAreas[i - 1] + accumulatedCount * accumulated.SurfaceArea();
+			if ( cost < bestCost )
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	uint32_t middle = first + count / 2;
+	if ( bestAxis >= 0 )
+	{
+		// Don't split if intersecting everything here is cheaper than walking into two children
+		const float parentArea = bounds.SurfaceArea();
+		const float leafCost = count * parentArea;
+		const float splitCost = TraversalCost * parentArea + bestCost;
+		if ( leafCost <= splitCost && count <= maxLeafSize * 4 )
+		{
+			return makeLeaf();
+		}
+
+		const float extent = centroidBounds.maxs[bestAxis] - centroidBounds.mins[bestAxis];
+		const float scale = BinCount / extent;
+		const float minimum = centroidBounds.mins[bestAxis];
+		const auto iterator = std::partition( primitiveIndexStorage.begin() + first, primitiveIndexStorage.begin() + first + count,
+			[&]( const uint32_t& primitive )
+			{
+				return std::min( BinCount - 1, int( (centroids[primitive][bestAxis] - minimum) * scale ) ) < bestSplit;
+			} );
+
+		middle = iterator - primitiveIndexStorage.begin();
+	}
+	// Otherwise all the centroids are in the same spot, so any split is as good as the other
+
+	BuildRecursive( primitiveBounds, centroids, first, middle - first, nodeIndex, depth + 1 );
+	const uint32_t rightChild = BuildRecursive( primitiveBounds, centroids, middle, first + count - middle, nodeIndex, depth + 1 );
+
+	nodeStorage[nodeIndex].offset = rightChild;
+	nodeStorage[nodeIndex].count = 0;
+	return nodeIndex;
+}
+
+void Bvh::RefitNode( const uint32_t& index, const Aabb* primitiveBounds )
+{
+	BvhNode& node = nodeStorage[index];
+	Aabb bounds;
+
+	if ( node.IsLeaf() )
+	{
+		for ( uint32_t i = node.offset; i < node.offset + node.count; i++ )
+		{
+			bounds.Add( primitiveBounds[primitiveIndexStorage[i]] );
+		}
+	}
+	else
+	{
+		bounds.Add( nodeStorage[index + 1].bounds );
+		bounds.Add( nodeStorage[node.offset].bounds );
+	}
+
+	node.bounds = bounds;
+}
+
+void Bvh::Refit( const Aabb* primitiveBounds )
+{
+	// Children always come after their parent, so going backwards visits them first
+	for ( uint32_t i = nodeStorage.size(); i > 0; i-- )
+	{
+		RefitNode( i - 1, primitiveBounds );
+	}
+}
+
+void Bvh::RefitPrimitive( const uint32_t& primitive, const Aabb* primitiveBounds )
+{
+	uint32_t node = primitiveLeaves[primitive];
+	while ( node != InvalidIndex )
+	{
+		const Aabb oldBounds = nodeStorage[node].bounds;
+		RefitNode( node, primitiveBounds );
+
+		// Nothing above this will change either
+		if ( nodeStorage[node].bounds == oldBounds )
+		{
+			break;
+		}
+
+		node = parents[node];
+	}
+}
+
+void Bvh::CullFrustum( const Frustum& frustum, const Aabb* primitiveBounds, TrackedVector<uint32_t, MemoryTag::Frame>& outVisible ) const
+{
+	if ( nodeCount == 0 )
+	{
+		return;
+	}
+
+	// Once a node is fully inside, its whole subtree is too, so the plane tests can be skipped
+	struct Entry
+	{
+		uint32_t node;
+		bool inside;
+	};
+
+	Entry stack[MaxDepth + 2];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, false };
+
+	while ( stackSize > 0 )
+	{
+		const Entry entry = stack[--stackSize];
+		const BvhNode& node = nodes[entry.node];
+
+		bool inside = entry.inside;
+		if ( !inside )
+		{
+			const Frustum::Result result = frustum.Classify( node.bounds );
+			if ( result == Frustum::Outside )
+			{
+				continue;
+			}
+			inside = result == Frustum::Inside;
+		}
+
+		if ( node.IsLeaf() )
+		{
+			for ( uint32_t i = node.offset; i < node.offset + node.count; i++ )
+			{
+				const uint32_t primitive = primitiveIndices[i];
+				if ( inside || frustum.Classify( primitiveBounds[primitive] ) != Frustum::Outside )
+				{
+					outVisible.push_back( primitive );
+				}
+			}
+		}
+		else
+		{
+			stack[stackSize++] = { node.offset, inside };
+			stack[stackSize++] = { entry.node + 1, inside };
+		}
+	}
+}
@@ -0,0 +1,354 @@
+
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Memory.hpp"
+
+// Axis-aligned bounding box, starts out "inverted" so that adding the first point makes it valid
+struct Aabb
+{
+	void Add( const glm::vec3& point )
+	{
+		mins = glm::min( mins, point );
+		maxs = glm::max( maxs, point );
+	}
+
+	void Add( const Aabb& other )
+	{
+		mins = glm::min( mins, other.mins );
+		maxs = glm::max( maxs, other.maxs );
+	}
+
+	bool IsValid() const
+	{
+		return mins.x <= maxs.x && mins.y <= maxs.y && mins.z <= maxs.z;
+	}
+
+	glm::vec3 Center() const
+	{
+		return (mins + maxs) * 0.5f;
+	}
+
+	float SurfaceArea() const
+	{
+		const glm::vec3 d = maxs - mins;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	// Bounds of this box after transforming it, without transforming all 8 corners (Arvo's method)
+	Aabb Transformed( const glm::mat4& matrix ) const;
+
+	bool operator==( const Aabb& other ) const
+	{
+		return mins == other.mins && maxs == other.maxs;
+	}
+
+	glm::vec3 mins{ FLT_MAX, FLT_MAX, FLT_MAX };
+	glm::vec3 maxs{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+};
+
+// The 6 clipping planes of a view-projection matrix, with normals pointing inwards
+struct Frustum
+{
+	enum Result
+	{
+		Outside = 0,
+		Intersecting,
+		Inside
+	};
+
+	static Frustum FromMatrix( const glm::mat4& viewProj );
+
+	Result Classify( const Aabb& box ) const;
+
+	glm::vec4 planes[6];
+};
+
+struct Ray
+{
+	Ray( const glm::vec3& origin, const glm::vec3& direction )
+		: origin( origin ), direction( direction ), inverseDirection( 1.0f / direction )
+	{
+	}
+
+	// Slab test, returns the distance at which the ray enters the box, or FLT_MAX if it misses
+	// it or only hits it further than maxDistance
+	float IntersectAabb( const Aabb& box, const float& maxDistance ) const
+	{
+		const glm::vec3 t1 = (box.mins - origin) * inverseDirection;
+		const glm::vec3 t2 = (box.maxs - origin) * inverseDirection;
+		const glm::vec3 tNear = glm::min( t1, t2 );
+		const glm::vec3 tFar = glm::max( t1, t2 );
+
+		const float enter = glm::max( glm::max( tNear.x, tNear.y ), glm::max( tNear.z, 0.0f ) );
+		const float exit = glm::min( glm::min( tFar.x, tFar.y ), glm::min( tFar.z, maxDistance ) );
+		return enter <= exit ? enter : FLT_MAX;
+	}
+
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 inverseDirection;
+};
+
+// A BVH node, 32 bytes so two of them share a cache line
+// Nodes are stored depth-first, so the left child of an interior node is always the
+// very next node, and only the right child's index needs to be stored
+struct BvhNode
+{
+	bool IsLeaf() const
+	{
+		return count != 0;
+	}
+
+	Aabb bounds;
+	// Leaf: index of the first primitive in the primitive list
+	// Interior: index of the right child
+	uint32_t offset{ 0 };
+	// Leaf: number of primitives, interior: 0
+	uint32_t count{ 0 };
+};
+
+static_assert( sizeof( BvhNode ) == 32, "BvhNode should stay at 32 bytes" );
+
+// Bounding volume hierarchy over an arbitrary list of primitives, built with the binned
+// surface area heuristic. It only knows about primitive bounds, so the same thing can be
+// used for scene objects and for the triangles inside a mesh
+class Bvh
+{
+public:
+	static constexpr uint32_t InvalidIndex = ~0U;
+
+	Bvh() = default;
+	// The views point into the vectors' buffers, which survive a move but not a copy
+	Bvh( const Bvh& ) = delete;
+	Bvh& operator=( const Bvh& ) = delete;
+	Bvh( Bvh&& ) = default;
+	Bvh& operator=( Bvh&& ) = default;
+
+	void Build( const Aabb* primitiveBounds, const uint32_t& primitiveCount, const uint32_t& maxLeafSize = 4 );
+
+	// Uses nodes and primitive indices that live elsewhere, e.g. in a mapped cache file
+	// A BVH like that can be queried, but not refit
+	void SetExternal( const BvhNode* externalNodes, const uint32_t& externalNodeCount, const uint32_t* externalPrimitiveIndices );
+	// Whether nodes and primitive indices from somewhere that can't be trusted, like a file, make a tree that
+	// can be walked without reading out of bounds or overflowing the traversal stacks
+	// Looks at every node and every primitive index
+	static bool IsValidLayout( const BvhNode* externalNodes, const uint32_t& externalNodeCount,
+		const uint32_t* externalPrimitiveIndices, const uint32_t& primitiveCount );
+
+	// Refits the whole tree bottom-up, for when most primitives moved
+	void Refit( const Aabb* primitiveBounds );
+	// Refits only the path from this primitive's leaf to the root, for when one primitive moved
+	void RefitPrimitive( const uint32_t& primitive, const Aabb* primitiveBounds );
+
+	// Appends the primitives whose bounds touch the frustum
+	// Primitives in leaves that straddle the frustum are tested individually against their bounds
+	void CullFrustum( const Frustum& frustum, const Aabb* primitiveBounds, TrackedVector<uint32_t, MemoryTag::Frame>& outVisible ) const;
+
+	// Generic depth-first walk. nodeTest( const BvhNode& ) decides whether to descend into a node,
+	// leafVisit( uint32_t primitive ) is then called for every primitive in the leaves that passed
+	// This is what frustum culling, occlusion queries and ray casts are built on top of
+	template<typename NodeTest, typename LeafVisit>
+	void Traverse( NodeTest&& nodeTest, LeafVisit&& leafVisit ) const
+	{
+		if ( nodeCount == 0 )
+		{
+			return;
+		}
+
+		// Deeper than the build's depth limit
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		uint32_t current = 0;
+
+		while ( true )
+		{
+			const BvhNode& node = nodes[current];
+			if ( nodeTest( node ) )
+			{
+				if ( node.IsLeaf() )
+				{
+					for ( uint32_t i = 0; i < node.count; i++ )
+					{
+						leafVisit( primitiveIndices[node.offset + i] );
+					}
+				}
+				else
+				{
+					stack[stackSize++] = node.offset;
+					current = current + 1;
+					continue;
+				}
+			}
+
+			if ( stackSize == 0 )
+			{
+				break;
+			}
+			current = stack[--stackSize];
+		}
+	}
+
+	// Calls rangeVisit( uint32_t first, uint32_t count ) for the ranges of the primitive list whose leaves touch
+	// the frustum, in order. A subtree's leaves are next to each other in there, so a subtree that's entirely inside
+	// comes out as one range, and the primitives never get looked at one by one
+	template<typename RangeVisit>
+	void CullFrustumRanges( const Frustum& frustum, RangeVisit&& rangeVisit ) const
+	{
+		if ( nodeCount == 0 )
+		{
+			return;
+		}
+
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		uint32_t current = 0;
+
+		while ( true )
+		{
+			const BvhNode& node = nodes[current];
+			const Frustum::Result result = frustum.Classify( node.bounds );
+			if ( result == Frustum::Intersecting && !node.IsLeaf() )
+			{
+				stack[stackSize++] = node.offset;
+				current = current + 1;
+				continue;
+			}
+
+			if ( result != Frustum::Outside )
+			{
+				// From the subtree's leftmost leaf to its rightmost one
+				uint32_t leftmost = current;
+				while ( !nodes[leftmost].IsLeaf() )
+				{
+					leftmost = leftmost + 1;
+				}
+				uint32_t rightmost = current;
+				while ( !nodes[rightmost].IsLeaf() )
+				{
+					rightmost = nodes[rightmost].offset;
+				}
+
+				const uint32_t first = nodes[leftmost].offset;
+				const uint32_t end = nodes[rightmost].offset + nodes[rightmost].count;
+				if ( end > first )
+				{
+					rangeVisit( first, end - first );
+				}
+			}
+
+			if ( stackSize == 0 )
+			{
+				break;
+			}
+			current = stack[--stackSize];
+		}
+	}
+
+	// Front-to-back walk along a ray, skipping nodes that are further than the closest hit so far
+	// leafIntersect( const uint32_t* primitives, uint32_t count, float& closest ) should test the given
+	// primitives and lower closest when it finds something nearer
+	template<typename LeafIntersect>
+	void IntersectRay( const Ray& ray, float& closest, LeafIntersect&& leafIntersect ) const
+	{
+		if ( nodeCount == 0 || ray.IntersectAabb( nodes[0].bounds, closest ) == FLT_MAX )
+		{
+			return;
+		}
+
+		struct Entry
+		{
+			uint32_t node;
+			float distance;
+		};
+
+		Entry stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { 0, 0.0f };
+
+		while ( stackSize > 0 )
+		{
+			const Entry entry = stack[--stackSize];
+			// Something closer was found after this got pushed
+			if ( entry.distance >= closest )
+			{
+				continue;
+			}
+
+			const BvhNode& node = nodes[entry.node];
+			if ( node.IsLeaf() )
+			{
+				leafIntersect( &primitiveIndices[node.offset], node.count, closest );
+				continue;
+			}
+
+			uint32_t nearChild = entry.node + 1;
+			uint32_t farChild = node.offset;
+			float nearDistance = ray.IntersectAabb( nodes[nearChild].bounds, closest );
+			float farDistance = ray.IntersectAabb( nodes[farChild].bounds, closest );
+			if ( farDistance < nearDistance )
+			{
+				std::swap( nearChild, farChild );
+				std::swap( nearDistance, farDistance );
+			}
+
+			// Push the far one first so the near one gets popped next
+			if ( farDistance != FLT_MAX )
+			{
+				stack[stackSize++] = { farChild, farDistance };
+			}
+			if ( nearDistance != FLT_MAX )
+			{
+				stack[stackSize++] = { nearChild, nearDistance };
+			}
+		}
+	}
+
+	bool IsEmpty() const
+	{
+		return nodeCount == 0;
+	}
+
+	const BvhNode* GetNodes() const
+	{
+		return nodes;
+	}
+
+	uint32_t GetNodeCount() const
+	{
+		return nodeCount;
+	}
+
+	// Primitive indices in leaf order, a leaf references the range [offset, offset + count)
+	// There are as many of them as there are primitives
+	const uint32_t* GetPrimitiveIndices() const
+	{
+		return primitiveIndices;
+	}
+
+private:
+	void UpdateViews();
+
+	uint32_t BuildRecursive( const Aabb* primitiveBounds, const glm::vec3* centroids,
+		const uint32_t& first, const uint32_t& count, const uint32_t& parent, const uint32_t& depth );
+
+	void RefitNode( const uint32_t& node, const Aabb* primitiveBounds );
+
+	// What the queries look at, either the storage below or someone else's memory
+	const BvhNode* nodes{ nullptr };
+	uint32_t nodeCount{ 0 };
+	const uint32_t* primitiveIndices{ nullptr };
+
+	TrackedVector<BvhNode, MemoryTag::Bvh> nodeStorage;
+	TrackedVector<uint32_t, MemoryTag::Bvh> primitiveIndexStorage;
+	// Used by the incremental refit to walk from a leaf up to the root
+	TrackedVector<uint32_t, MemoryTag::Bvh> parents;
+	TrackedVector<uint32_t, MemoryTag::Bvh> primitiveLeaves;
+	uint32_t maxLeafSize{ 4 };
+};
@@ -0,0 +1,73 @@
+
+#include <algorithm>
+#include <cmath>
+
+#include "DynamicResolution.hpp"
+
+namespace
+{
+	constexpr float MinScale = 0.25f;
+	// How much of each new frame time goes into the average
+	constexpr float AverageWeight = 0.2f;
+	// Frames to wait after a change, for the average to catch up with it
+	constexpr uint32_t SettleFrames = 8;
+	// How far off the target the frame time can be before the scale changes
+	constexpr float Tolerance = 0.1f;
+	// Down faster than up, a slow frame hurts more than a blurry one
+	constexpr float MaxStepDown = 0.8f;
+	constexpr float MaxStepUp = 1.1f;
+}
+
+void DynamicResolution::SetEnabled( const bool& newEnabled )
+{
+	enabled = newEnabled;
+	averageFrameTime = 0.0f;
+	framesSinceChange = 0;
+}
+
+void DynamicResolution::SetTargetFrameTime( const float& seconds )
+{
+	targetFrameTime = seconds;
+	framesSinceChange = 0;
+}
+
+void DynamicResolution::Update( const float& frameTime )
+{
+	if ( !enabled || frameTime <= 0.0f )
+	{
+		return;
+	}
+
+	averageFrameTime = averageFrameTime == 0.0f ? frameTime : averageFrameTime + (frameTime - averageFrameTime) * AverageWeight;
+	if ( ++framesSinceChange < SettleFrames )
+	{
+		return;
+	}
+
+	const float ratio = targetFrameTime / averageFrameTime;
+	if ( std::fabs( ratio - 1.0f ) < Tolerance )
+	{
+		return;
+	}
+
+	const float newScale = std::min( std::max( scale * std::min( std::max( std::sqrt( ratio ), MaxStepDown ), MaxStepUp ), MinScale ), 1.0f );
+	if ( newScale != scale )
+	{
+		scale = newScale;
+		framesSinceChange = 0;
+	}
+}
+
+void DynamicResolution::GetRenderSize( const uint32_t& windowWidth, const uint32_t& windowHeight, uint32_t& outWidth, uint32_t& outHeight ) const
+{
+	outWidth = windowWidth;
+	outHeight = windowHeight;
+	if ( GetScale() == 1.0f )
+	{
+		return;
+	}
+
+	// Rounded to the nearest multiple of 8
+	outWidth = std::min( std::max( uint32_t( windowWidth * scale + 4.0f ) & ~7U, 8U ), windowWidth );
+	outHeight = std::min( std::max( uint32_t( windowHeight * scale + 4.0f ) & ~7U, 8U ), windowHeight );
+}
@@ -0,0 +1,42 @@
+
+#pragma once
+
+#include <cstdint>
+
+// Picks the resolution to render at, some fraction of the window's, so frames take about as long as the target
+// The frame time goes roughly with the pixel count, so the scale moves with the square root of how far off it is,
+// in small steps and only every few frames, so it settles instead of going back and forth
+class DynamicResolution
+{
+public:
+	void SetEnabled( const bool& newEnabled );
+
+	bool IsEnabled() const
+	{
+		return enabled;
+	}
+
+	// In seconds
+	void SetTargetFrameTime( const float& seconds );
+
+	// With how long the last frame took, in seconds
+	void Update( const float& frameTime );
+
+	// The window's size at the current scale, in multiples of 8 pixels so small changes don't reallocate
+	// the framebuffer, the same as the window's size if that's what it comes to anyway
+	void GetRenderSize( const uint32_t& windowWidth, const uint32_t& windowHeight, uint32_t& outWidth, uint32_t& outHeight ) const;
+
+	// Of the window's width and height, 1 when it's off
+	float GetScale() const
+	{
+		return enabled ? scale : 1.0f;
+	}
+
+private:
+	bool enabled{ false };
+	float targetFrameTime{ 1.0f / 60.0f };
+	float scale{ 1.0f };
+	// Smoothed over the last few frames, 0 until there is one
+	float averageFrameTime{ 0.0f };
+	uint32_t framesSinceChange{ 0 };
+};
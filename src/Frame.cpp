@@ -0,0 +1,661 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+using namespace std::chrono;
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "Frame.hpp"
+#include "PerfCounters.hpp"
+
+glm::vec3 viewOrigin{ 0.0f, 0.0f, 0.0f };
+glm::vec3 viewAngles{ 0.0f, 0.0f, 0.0f };
+glm::vec3 viewForward{ 1.0f, 0.0f, 0.0f };
+glm::vec3 viewRight{ 0.0f, -1.0f, 0.0f };
+glm::vec3 viewUp{ 0.0f, 0.0f, 1.0f };
+
+float viewSpeed = 10.0f;
+
+glm::mat4 projMatrix;
+glm::mat4 viewMatrix;
+// projMatrix * viewMatrix, like the two it's only rebuilt when it changes, see SetupMatrices
+glm::mat4 viewProjMatrix;
+// The size RunFrame was last asked to draw for, the projection gets rebuilt when it changes
+float viewWidth = 1024.0f;
+float viewHeight = 1024.0f;
+bool projectionDirty{ true };
+// What the view matrix was last built from, nothing at first
+bool viewBuilt{ false };
+glm::vec3 builtViewOrigin;
+glm::vec3 builtViewAngles;
+
+ThreadPool threadPool;
+AssetManager assets( threadPool );
+TextureCache textureCache( assets, threadPool, 256U << 20 );
+std::vector<AssetHandle<Texture>> textures;
+
+Scene scene;
+TrackedVector<uint32_t, MemoryTag::Frame> visibleObjects;
+PickResult picked;
+float pickTime{ 0.0f };
+// Drawn in place of meshes that are still loading
+std::shared_ptr<const Mesh> placeholderMesh;
+
+Framebuffer framebuffer;
+Rasterizer rasterizer;
+
+TrackedVector<Light, MemoryTag::Scene> lights;
+// Index of the spot light that follows the camera around
+size_t headlight{ 0 };
+glm::vec3 ambientLight{ 0.08f };
+LightGrid lightGrid;
+
+RenderMode renderMode = RenderMode::Solid;
+PipelineState pipelineState;
+ShadingPath shadingPath = ShadingPath::Forward;
+bool depthPrepass{ false };
+bool depthClearElision{ true };
+bool multisampling{ false };
+bool fxaa{ false };
+DynamicResolution dynamicResolution;
+bool showCrosshair{ false };
+
+const char* const FrameStageNames[]
+{
+	"update",
+	"rasterize",
+	"postprocess",
+	"lines",
+	"present"
+};
+
+void BeginFrameStage( const FrameStage& stage )
+{
+	GetPerfCounters().BeginStage( uint32_t( stage ) );
+}
+
+TrackedVector<DrawCall, MemoryTag::Frame> drawCalls;
+
+// Takes points in [-1, 1] coordinates, anti-aliased into the framebuffer
+void DrawLine( const float& x1, const float& y1, const float& x2, const float& y2, const glm::vec4& color )
+{
+	rasterizer.DrawLine( framebuffer, glm::vec4( x1, y1, 0.0f, 1.0f ), glm::vec4( x2, y2, 0.0f, 1.0f ), color );
+}
+
+inline glm::vec4 GetVec4From( const glm::vec3& v )
+{
+	return glm::vec4( v, 1.0f );
+}
+
+void DrawTriangle( const Triangle& tri, const glm::mat4& modelViewProj, const glm::vec4& color )
+{
+	const glm::vec4 transformed[3]
+	{
+		modelViewProj * GetVec4From( tri.verts[0] ),
+		modelViewProj * GetVec4From( tri.verts[1] ),
+		modelViewProj * GetVec4From( tri.verts[2] )
+	};
+
+	// Clipped against the near plane by the rasterizer
+	for ( int i = 0; i < 3; i++ )
+	{
+		rasterizer.DrawLine( framebuffer, transformed[i], transformed[(i + 1) % 3], color );
+	}
+}
+
+// Only rebuilds what changed since the last frame: the projection on resizes, the view when the camera moved
+void SetupMatrices()
+{
+	using namespace glm;
+
+	const bool viewDirty = !viewBuilt || viewOrigin != builtViewOrigin || viewAngles != builtViewAngles;
+	if ( !projectionDirty && !viewDirty )
+	{
+		return;
+	}
+
+	if ( projectionDirty )
+	{
+		projMatrix = perspective( 90.0f, viewWidth / viewHeight, 0.01f, 1000.0f );
+		projectionDirty = false;
+	}
+
+	if ( viewDirty )
+	{
+		// Spherical coords
+		const vec3 angles = radians( viewAngles );
+
+		const float cosPitch = cos( angles.x );
+		const float sinPitch = sin( angles.x );
+		const float cosYaw = cos( angles.y );
+		const float sinYaw = sin( angles.y );
+		const float cosRoll = cos( angles.z );
+		const float sinRoll = sin( angles.z );
+
+		viewForward = 
+		{
+			cosYaw * cosPitch,
+			-sinYaw * cosPitch,
+			-sinPitch
+		};
+
+		viewUp =
+		{
+			(cosRoll * sinPitch * cosYaw) + (-sinRoll * -sinYaw),
+			(cosRoll * -sinPitch * sinYaw) + (-sinRoll * cosYaw),
+			cosPitch * cosRoll
+		};
+
+		viewRight = cross( viewForward, viewUp );
+
+		viewMatrix = lookAt( viewOrigin, viewOrigin + viewForward, viewUp );
+		viewBuilt = true;
+		builtViewOrigin = viewOrigin;
+		builtViewAngles = viewAngles;
+	}
+
+	viewProjMatrix = projMatrix * viewMatrix;
+}
+
+inline float crandom()
+{
+	return rand() / 32768.0f;
+}
+
+inline glm::vec3 randVec()
+{
+	return glm::vec3( crandom(), crandom(), crandom() ) * crandom() * 15.0f;
+}
+
+std::shared_ptr<const Mesh> CreatePlaceholderMesh()
+{
+	// A unit cube
+	const glm::vec3 corners[8]
+	{
+		{ -1.0f, -1.0f, -1.0f }, { 1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, -1.0f }, { -1.0f, 1.0f, -1.0f },
+		{ -1.0f, -1.0f, 1.0f }, { 1.0f, -1.0f, 1.0f }, { 1.0f, 1.0f, 1.0f }, { -1.0f, 1.0f, 1.0f }
+	};
+	// Counter-clockwise when looking at the outside
+	const int faces[6][4]
+	{
+		{ 3, 2, 1, 0 }, { 5, 6, 7, 4 }, { 1, 5, 4, 0 }, { 2, 6, 5, 1 }, { 3, 7, 6, 2 }, { 0, 4, 7, 3 }
+	};
+
+	std::vector<Triangle> triangles;
+	for ( const auto& face : faces )
+	{
+		triangles.push_back( { { corners[face[0]], corners[face[1]], corners[face[2]] } } );
+		triangles.push_back( { { corners[face[0]], corners[face[2]], corners[face[3]] } } );
+	}
+
+	return std::make_shared<Mesh>( Mesh::FromTriangles( triangles ) );
+}
+
+void CreateScene( const std::vector<std::string>& meshPaths, const std::vector<std::string>& texturePaths )
+{
+	placeholderMesh = CreatePlaceholderMesh();
+
+	for ( const std::string& path : texturePaths )
+	{
+		textures.push_back( textureCache.Request( path ) );
+	}
+
+	// Every mesh starts out as a placeholder and gets swapped in once it's loaded
+	for ( const std::string& path : meshPaths )
+	{
+		const uint32_t object = scene.AddObject( placeholderMesh );
+		const auto tpStart = system_clock::now();
+
+		assets.RequestMesh( path, [object, tpStart]( const Asset<Mesh>& asset )
+		{
+			if ( !asset.IsReady() )
+			{
+				std::cerr << "Couldn't load " << asset.GetPath() << std::endl;
+				return;
+			}
+
+			const Mesh& mesh = *asset.Get();
+			std::cout << "Loaded " << asset.GetPath() << ": " << mesh.GetVertexCount() << " vertices, " << mesh.GetTriangleCount()
+				<< " triangles (" << duration_cast<milliseconds>(system_clock::now() - tpStart).count() << " ms)" << std::endl;
+
+			scene.SetMesh( object, asset.Get() );
+			// The placeholder's triangle index means nothing for the new mesh
+			if ( picked.object == object )
+			{
+				picked = PickResult();
+			}
+		} );
+	}
+
+	if ( !meshPaths.empty() )
+	{
+		scene.Update();
+		return;
+	}
+
+	// Some triangles
+	scene.AddObject( std::make_shared<Mesh>( Mesh::FromTriangles( { { { { -1.0f, -1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 1.0f } } } } ) ) );
+	for ( int i = 0; i < 8; i++ )
+	{
+		scene.AddObject( std::make_shared<Mesh>( Mesh::FromTriangles( { { { randVec(), randVec(), randVec() } } } ) ) );
+	}
+
+	scene.Update();
+}
+
+// Per frame stage and per thread, since the last reset, with the ratios that tell whether it's waiting on memory
+// or branches, or just has a lot to do
+void PrintPerfCounters( const std::string& heading )
+{
+	const PerfCounters& perf = GetPerfCounters();
+	if ( !perf.IsEnabled() )
+	{
+		return;
+	}
+
+	const auto print = [&perf]( const std::string& name, const PerfCounts& counts )
+	{
+		const double instructions = std::max( double( counts[PerfEvent::Instructions] ), 1.0 );
+		std::cout << "  " << name << ": " << counts[PerfEvent::Cycles] / 1000000.0 << " M cycles, "
+			<< counts[PerfEvent::Instructions] / 1000000.0 << " M instructions, "
+			<< counts[PerfEvent::Instructions] / std::max( double( counts[PerfEvent::Cycles] ), 1.0 ) << " IPC, "
+			<< counts[PerfEvent::CacheMisses] * 1000.0 / instructions << " cache misses and "
+			<< counts[PerfEvent::BranchMisses] * 1000.0 / instructions << " branch misses per 1000 instructions" << std::endl;
+	};
+
+	std::cout << heading << ", per stage:" << std::endl;
+	for ( uint32_t stage = 0; stage < uint32_t( FrameStage::Count ); stage++ )
+	{
+		print( FrameStageNames[stage], perf.GetStageCounts( stage ) );
+	}
+	std::cout << "Per thread, 0 is the main thread:" << std::endl;
+	for ( uint32_t thread = 0; thread < perf.GetThreadCount(); thread++ )
+	{
+		print( "thread " + std::to_string( thread ), perf.GetThreadCounts( thread ) );
+	}
+}
+
+// Everything the renderer allocated, by what it's for, with the highest it's been since the start
+void PrintMemoryUsage( const std::string& heading )
+{
+	const auto print = []( const char* name, const MemoryStats& stats )
+	{
+		std::cout << "  " << name << ": " << stats.currentBytes / (1024.0 * 1024.0) << " MiB in "
+			<< stats.allocationCount << " allocations, peak " << stats.peakBytes / (1024.0 * 1024.0) << " MiB" << std::endl;
+	};
+
+	std::cout << heading << ":" << std::endl;
+	for ( uint32_t tag = 0; tag < uint32_t( MemoryTag::Count ); tag++ )
+	{
+		print( GetMemoryTagName( MemoryTag( tag ) ), GetMemoryStats( MemoryTag( tag ) ) );
+	}
+	print( "total", GetTotalMemoryStats() );
+}
+
+// The same on every platform, unlike the random triangles, for the golden images
+// Cubes around the middle, where the ring of lights is, on a floor
+void CreateGoldenScene()
+{
+	placeholderMesh = CreatePlaceholderMesh();
+
+	scene.AddObject( placeholderMesh, glm::scale( glm::translate( glm::mat4( 1.0f ), glm::vec3( 0.0f, 0.0f, -2.0f ) ), glm::vec3( 16.0f, 16.0f, 0.25f ) ) );
+	for ( int y = 0; y < 4; y++ )
+	{
+		for ( int x = 0; x < 4; x++ )
+		{
+			const glm::vec3 position( x * 6.0f - 9.0f, y * 6.0f - 9.0f, float( (x + y) % 3 ) );
+			glm::mat4 transform = glm::translate( glm::mat4( 1.0f ), position );
+			transform = glm::rotate( transform, glm::radians( 20.0f * (x * 4 + y) ), glm::normalize( glm::vec3( 1.0f, float( x ), float( y ) + 1.0f ) ) );
+			scene.AddObject( placeholderMesh, glm::scale( transform, glm::vec3( 1.0f + 0.25f * ((x * 3 + y) % 4) ) ) );
+		}
+	}
+
+	scene.Update();
+}
+
+void CreateLights()
+{
+	Light sun;
+	sun.type = LightType::Directional;
+	sun.direction = glm::vec3( 0.4f, 0.3f, -1.0f );
+	sun.color = glm::vec3( 0.5f, 0.48f, 0.45f );
+	lights.push_back( sun );
+
+	// A ring of small coloured lights around the middle of the scene
+	for ( int i = 0; i < 24; i++ )
+	{
+		const float angle = glm::radians( i * 15.0f );
+		Light light;
+		light.position = glm::vec3( std::cos( angle ) * 12.0f, std::sin( angle ) * 12.0f, 2.0f );
+		light.color = glm::vec3( 0.5f + 0.5f * std::cos( angle ), 0.5f + 0.5f * std::cos( angle + 2.1f ), 0.5f + 0.5f * std::cos( angle + 4.2f ) ) * 2.0f;
+		light.range = 8.0f;
+		lights.push_back( light );
+	}
+
+	Light spot;
+	spot.type = LightType::Spot;
+	spot.color = glm::vec3( 1.5f );
+	spot.range = 40.0f;
+	headlight = lights.size();
+	lights.push_back( spot );
+
+	// Now that there's something to light things up
+	pipelineState.shader = Shader::BlinnPhong;
+}
+
+void PickObject( const float& cursorX, const float& cursorY, const glm::mat4& viewProj )
+{
+	auto tpStart = system_clock::now();
+
+	// Unproject the cursor on the near and far planes to get the ray through it
+	const float ndcX = (cursorX / viewWidth) * 2.0f - 1.0f;
+	const float ndcY = 1.0f - (cursorY / viewHeight) * 2.0f;
+	const glm::mat4 inverseViewProj = glm::inverse( viewProj );
+
+	glm::vec4 nearPoint = inverseViewProj * glm::vec4( ndcX, ndcY, -1.0f, 1.0f );
+	glm::vec4 farPoint = inverseViewProj * glm::vec4( ndcX, ndcY, 1.0f, 1.0f );
+	nearPoint /= nearPoint.w;
+	farPoint /= farPoint.w;
+
+	const Ray ray( glm::vec3( nearPoint ), glm::normalize( glm::vec3( farPoint - nearPoint ) ) );
+	scene.Pick( ray, picked );
+
+	auto tpEnd = system_clock::now();
+	pickTime = duration_cast<microseconds>(tpEnd - tpStart).count() * 0.001f;
+}
+
+void UpdateRenderSettings( const UserCommands& uc )
+{
+	if ( uc.flags & UserCommands::CycleRenderMode )
+	{
+		renderMode = RenderMode( (int( renderMode ) + 1) % int( RenderMode::Count ) );
+	}
+	if ( uc.flags & UserCommands::ToggleTexturing )
+	{
+		pipelineState.textured = !pipelineState.textured;
+	}
+	if ( uc.flags & UserCommands::CycleShader )
+	{
+		pipelineState.shader = Shader( (int( pipelineState.shader ) + 1) % int( Shader::Count ) );
+	}
+	if ( uc.flags & UserCommands::ToggleBlending )
+	{
+		// See-through things shouldn't hide what's behind them
+		pipelineState.blend = !pipelineState.blend;
+		pipelineState.depthWrite = !pipelineState.blend;
+	}
+	if ( uc.flags & UserCommands::CycleCullMode )
+	{
+		pipelineState.cullMode = CullMode( (int( pipelineState.cullMode ) + 1) % int( CullMode::Count ) );
+	}
+	if ( uc.flags & UserCommands::CycleShadingPath )
+	{
+		shadingPath = ShadingPath( (int( shadingPath ) + 1) % int( ShadingPath::Count ) );
+	}
+	if ( uc.flags & UserCommands::ToggleDepthPrepass )
+	{
+		depthPrepass = !depthPrepass;
+	}
+	if ( uc.flags & UserCommands::ToggleDepthClearElision )
+	{
+		depthClearElision = !depthClearElision;
+	}
+	if ( uc.flags & UserCommands::ToggleMultisampling )
+	{
+		multisampling = !multisampling;
+	}
+	if ( uc.flags & UserCommands::ToggleFxaa )
+	{
+		fxaa = !fxaa;
+	}
+	if ( uc.flags & UserCommands::ToggleDynamicResolution )
+	{
+		dynamicResolution.SetEnabled( !dynamicResolution.IsEnabled() );
+	}
+	if ( uc.flags & UserCommands::PrintMemoryUsage )
+	{
+		PrintMemoryUsage( "Memory in use" );
+	}
+}
+
+// Blended objects need what's behind them already shaded, so those always go forward
+ShadingPath GetShadingPath()
+{
+	return pipelineState.blend ? ShadingPath::Forward : shadingPath;
+}
+
+// Fills the visible objects into the framebuffer
+void RasterizeObjects( const glm::mat4& viewProj )
+{
+	const ShadingPath path = GetShadingPath();
+	const bool prepass = depthPrepass && path == ShadingPath::Forward && !pipelineState.blend && pipelineState.depthWrite;
+
+	drawCalls.clear();
+	for ( const uint32_t& index : visibleObjects )
+	{
+		const SceneObject& object = scene.GetObject( index );
+		const bool isPlaceholder = object.mesh == placeholderMesh;
+
+		DrawCall call;
+		call.mesh = object.mesh.get();
+		call.modelViewProj = viewProj * object.transform;
+		call.model = object.transform;
+		call.lights = &lightGrid;
+		call.color = isPlaceholder ? glm::vec4( 0.3f, 0.3f, 0.3f, 1.0f ) : glm::vec4( 1.0f );
+		call.state = pipelineState;
+
+		if ( pipelineState.blend )
+		{
+			call.color.a = 0.5f;
+		}
+
+		// Spread the textures across the objects
+		if ( !isPlaceholder && !textures.empty() )
+		{
+			const Asset<Texture>& texture = *textures[index % textures.size()];
+			if ( texture.IsReady() )
+			{
+				call.texture = texture.Get().get();
+			}
+		}
+
+		drawCalls.push_back( call );
+	}
+
+	if ( prepass )
+	{
+		for ( DrawCall& call : drawCalls )
+		{
+			rasterizer.DrawDepth( framebuffer, call );
+			call.state.depthTest = DepthTest::Equal;
+			call.state.depthWrite = false;
+		}
+	}
+
+	for ( const DrawCall& call : drawCalls )
+	{
+		switch ( path )
+		{
+		case ShadingPath::Deferred: rasterizer.DrawGBuffer( framebuffer, call ); break;
+		case ShadingPath::Visibility: rasterizer.DrawVisibility( framebuffer, call ); break;
+		default: rasterizer.Draw( framebuffer, call ); break;
+		}
+	}
+
+	if ( path == ShadingPath::Deferred )
+	{
+		rasterizer.ShadeDeferred( framebuffer, lightGrid, viewProj, threadPool );
+	}
+	else if ( path == ShadingPath::Visibility )
+	{
+		rasterizer.ResolveVisibility( framebuffer, threadPool );
+	}
+}
+
+void RunFrame( const float& deltaTime, const UserCommands& uc, const uint32_t& width, const uint32_t& height )
+{
+	if ( float( width ) != viewWidth || float( height ) != viewHeight )
+	{
+		viewWidth = width;
+		viewHeight = height;
+		projectionDirty = true;
+	}
+
+	viewAngles.x += uc.mouseY * deltaTime * 80.0f;
+	viewAngles.y += uc.mouseX * deltaTime * 80.0f;
+
+	// Clamp the pitch
+	if ( viewAngles.x > 89.0f )
+		viewAngles.x = 89.0f;
+	if ( viewAngles.x < -89.0f )
+		viewAngles.x = -89.0f;
+
+	// Offset the view position
+	viewOrigin += uc.forward * viewForward * deltaTime * viewSpeed;
+	viewOrigin += uc.right * viewRight * deltaTime * viewSpeed;
+	viewOrigin += uc.up * viewUp * deltaTime * viewSpeed;
+	
+	BeginFrameStage( FrameStage::Update );
+	SetupMatrices();
+	UpdateRenderSettings( uc );
+
+	const glm::mat4& viewProj = viewProjMatrix;
+
+	// Swap in whatever finished loading, and stream texture levels in and out
+	assets.Update();
+	textureCache.Update();
+	scene.Update();
+
+	if ( uc.flags & UserCommands::LeftMouseButton )
+	{
+		PickObject( uc.cursorX, uc.cursorY, viewProj );
+	}
+
+	visibleObjects.clear();
+	scene.CullVisible( Frustum::FromMatrix( viewProj ), visibleObjects );
+
+	// Draw the objects that survived frustum culling, filled in by the rasterizer
+	// View-sized, unless the frames are too slow for that
+	uint32_t renderWidth, renderHeight;
+	dynamicResolution.GetRenderSize( width, height, renderWidth, renderHeight );
+	framebuffer.Resize( renderWidth, renderHeight );
+	framebuffer.SetGBufferEnabled( shadingPath == ShadingPath::Deferred );
+	framebuffer.SetVisibilityEnabled( shadingPath == ShadingPath::Visibility );
+	const bool solid = renderMode == RenderMode::Solid || renderMode == RenderMode::SolidWireframe;
+	framebuffer.SetMultisampleEnabled( multisampling && solid && GetShadingPath() == ShadingPath::Forward );
+	// Only if the deferred shading or the resolve actually runs, they put the depth of empty pixels back to 0
+	const bool keepDepth = depthClearElision && solid && GetShadingPath() != ShadingPath::Forward;
+	framebuffer.ClearTiles( 0xFF000000, keepDepth );
+
+	lights[headlight].position = viewOrigin;
+	lights[headlight].direction = viewForward;
+	lightGrid.Build( lights, ambientLight, viewOrigin, viewProj, framebuffer.GetWidth(), framebuffer.GetHeight() );
+
+	BeginFrameStage( FrameStage::Rasterize );
+	if ( solid )
+	{
+		RasterizeObjects( viewProj );
+	}
+	else if ( renderMode == RenderMode::HiddenLine )
+	{
+		// Only sorted into bands of rows here, the depth and the lines both get drawn in the resolve
+		for ( const uint32_t& index : visibleObjects )
+		{
+			const SceneObject& object = scene.GetObject( index );
+			DrawCall call;
+			call.mesh = object.mesh.get();
+			call.modelViewProj = viewProj * object.transform;
+			call.color = object.mesh == placeholderMesh ? glm::vec4( 80.0f / 255.0f, 80.0f / 255.0f, 80.0f / 255.0f, 1.0f ) : glm::vec4( 1.0f );
+			// A little nearer, so the edges don't sink into their own triangles
+			call.state.cullMode = pipelineState.cullMode;
+			call.state.lineDepthBias = 0.002f;
+			rasterizer.DrawHiddenLines( framebuffer, call, threadPool );
+		}
+	}
+	BeginFrameStage( FrameStage::PostProcess );
+	framebuffer.ResolveSamples( threadPool );
+	// Before the lines, which are anti-aliased already
+	if ( fxaa && solid )
+	{
+		framebuffer.ApplyFxaa( threadPool );
+	}
+
+	// And as lines on top of that
+	BeginFrameStage( FrameStage::Lines );
+	if ( renderMode == RenderMode::HiddenLine )
+	{
+		rasterizer.ResolveHiddenLines( framebuffer, threadPool );
+	}
+	for ( const uint32_t& index : visibleObjects )
+	{
+		const SceneObject& object = scene.GetObject( index );
+		const glm::mat4 modelViewProj = viewProj * object.transform;
+		const Mesh& mesh = *object.mesh;
+
+		if ( renderMode == RenderMode::SolidWireframe || renderMode == RenderMode::Wireframe )
+		{
+			DrawCall call;
+			call.mesh = &mesh;
+			call.modelViewProj = modelViewProj;
+			call.color = object.mesh == placeholderMesh ? glm::vec4( 80.0f / 255.0f, 80.0f / 255.0f, 80.0f / 255.0f, 1.0f ) : glm::vec4( 1.0f );
+			call.state.depthTest = DepthTest::Off;
+			call.state.cullMode = CullMode::None;
+			rasterizer.DrawWireframe( framebuffer, call );
+		}
+
+		// Picked triangle in yellow
+		if ( index == picked.object )
+		{
+			DrawTriangle( mesh.GetTriangle( picked.triangle ), modelViewProj, glm::vec4( 1.0f, 1.0f, 0.0f, 1.0f ) );
+		}
+	}
+
+	{
+		const glm::vec4 red( 1.0f, 100.0f / 255.0f, 100.0f / 255.0f, 1.0f );
+		const glm::vec4 green( 100.0f / 255.0f, 1.0f, 100.0f / 255.0f, 1.0f );
+		const glm::vec4 blue( 100.0f / 255.0f, 100.0f / 255.0f, 1.0f, 1.0f );
+
+		// Top view
+		// Forward = red
+		DrawLine( 0.0f, 0.0f, viewForward.x * 0.1f, viewForward.y * 0.1f, red );
+		// Right = green
+		DrawLine( 0.0f, 0.0f, viewRight.x * 0.1f, viewRight.y * 0.1f, green );
+		// Up = blue
+		DrawLine( 0.0f, 0.0f, viewUp.x * 0.1f, viewUp.y * 0.1f, blue );
+
+		// Side view
+		// Forward = red
+		DrawLine( 0.3f, 0.0f, 0.3f + viewForward.x * 0.1f, viewForward.z * 0.1f, red );
+		// Right = green
+		DrawLine( 0.3f, 0.0f, 0.3f + viewRight.x * 0.1f, viewRight.z * 0.1f, green );
+		// Up = blue
+		DrawLine( 0.3f, 0.0f, 0.3f + viewUp.x * 0.1f, viewUp.z * 0.1f, blue );
+	}
+
+	// Crosshair
+	if ( showCrosshair )
+	{
+		const glm::vec4 white( 1.0f );
+		const float size = 0.02f;
+		DrawLine( -size, 0.0f, size, 0.0f, white );
+		DrawLine( 0.0f, -size * viewWidth / viewHeight, 0.0f, size * viewWidth / viewHeight, white );
+	}
+
+	// Whoever puts it on screen carries on in this stage
+	BeginFrameStage( FrameStage::Present );
+	framebuffer.FinishClears( threadPool );
+}
+
+const PickResult& GetPicked()
+{
+	return picked;
+}
+
+float GetPickTime()
+{
+	return pickTime;
+}
@@ -0,0 +1,99 @@
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DynamicResolution.hpp"
+#include "Input.hpp"
+#include "Rasterizer.hpp"
+#include "Scene.hpp"
+#include "TextureCache.hpp"
+
+// Drawing a frame of the scene into the framebuffer: everything but the window, the input and putting it on
+// screen, so the golden image test renders exactly what the renderer does
+
+enum class RenderMode
+{
+	Wireframe = 0,
+	Solid,
+	SolidWireframe,
+	// Only the edges that aren't hidden behind something, see Rasterizer::DrawHiddenLines
+	HiddenLine,
+	Count
+};
+
+// How opaque objects get shaded, see Rasterizer::DrawGBuffer and Rasterizer::DrawVisibility
+enum class ShadingPath
+{
+	Forward = 0,
+	Deferred,
+	Visibility,
+	Count
+};
+
+// What the hardware performance counters get split up by, see -perfcounters
+enum class FrameStage
+{
+	// Camera, assets, culling and the light grid
+	Update = 0,
+	// Everything that goes into the framebuffer before the post-processing, including the depth for hidden lines
+	Rasterize,
+	// MSAA resolve and FXAA
+	PostProcess,
+	Lines,
+	// The remaining clears, upscaling, and putting it on screen, and whatever happens between frames
+	Present,
+	Count
+};
+
+extern const char* const FrameStageNames[];
+
+extern ThreadPool threadPool;
+extern AssetManager assets;
+// 256 MB unless overridden with -texturebudget
+extern TextureCache textureCache;
+extern Scene scene;
+extern Framebuffer framebuffer;
+
+extern glm::vec3 viewOrigin;
+// Pitch, yaw and roll, in degrees
+extern glm::vec3 viewAngles;
+
+// The keys go through these, see UserCommands
+extern RenderMode renderMode;
+extern PipelineState pipelineState;
+extern ShadingPath shadingPath;
+// Forward only, the depth of all opaque objects first, then only the visible pixels get shaded
+extern bool depthPrepass;
+// Deferred and visibility buffer frames leave the depth buffer alone, see Framebuffer::ClearTiles
+extern bool depthClearElision;
+// 4x MSAA, forward only
+extern bool multisampling;
+// Post-process anti-aliasing of the solid render modes, on top of the multisampling or instead of it
+extern bool fxaa;
+// Renders at a lower resolution when the frames take too long, whoever times the frames updates it, see -targetfps
+extern DynamicResolution dynamicResolution;
+// In the middle of the view, which is what picking goes through while the mouse looks around
+extern bool showCrosshair;
+
+// OBJ files to look at and BMP textures to spread over them, some random triangles if there are no meshes
+void CreateScene( const std::vector<std::string>& meshPaths, const std::vector<std::string>& texturePaths );
+// The same on every platform, unlike the random triangles, for the golden images
+void CreateGoldenScene();
+void CreateLights();
+
+// Moves the camera and goes through the commands, then draws the scene for a view of this size into the
+// framebuffer, which dynamicResolution may make smaller
+void RunFrame( const float& deltaTime, const UserCommands& uc, const uint32_t& viewWidth, const uint32_t& viewHeight );
+
+// What the last click hit, if anything
+const PickResult& GetPicked();
+// How long finding that took, in milliseconds
+float GetPickTime();
+
+void BeginFrameStage( const FrameStage& stage );
+// Per frame stage and per thread, since the last reset
+void PrintPerfCounters( const std::string& heading );
+// Everything the renderer allocated, by what it's for, with the highest it's been since the start
+void PrintMemoryUsage( const std::string& heading );
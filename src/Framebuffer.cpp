@@ -0,0 +1,269 @@
+
+#include <algorithm>
+
+#include "Framebuffer.hpp"
+#include "Kernels.hpp"
+
+void Framebuffer::Resize( const uint32_t& newWidth, const uint32_t& newHeight )
+{
+	if ( newWidth == width && newHeight == height )
+	{
+		return;
+	}
+
+	width = newWidth;
+	height = newHeight;
+	pitch = (width + FramebufferPadding - 1) / FramebufferPadding * FramebufferPadding;
+	paddedHeight = (height + 1) & ~1U;
+
+	const size_t pixelCount = size_t( pitch ) * paddedHeight;
+	color.Allocate( pixelCount );
+	depth.Allocate( pixelCount );
+	// Keeping the depth from one frame to the next needs it to start out cleared
+	GetKernels().fill( reinterpret_cast<uint32_t*>( depth.Get() ), 0, pixelCount );
+	staleDepth = false;
+	if ( gBufferEnabled )
+	{
+		normals.Allocate( pixelCount );
+		albedo.Allocate( pixelCount );
+	}
+	if ( visibilityEnabled )
+	{
+		visibility.Allocate( pixelCount );
+	}
+	if ( multisampleEnabled )
+	{
+		colorSamples.Allocate( pixelCount * MultisampleCount );
+		depthSamples.Allocate( pixelCount * MultisampleCount );
+	}
+	postColor.Free();
+
+	// Whatever was pending is gone along with the old buffers
+	clearPending = false;
+	pendingTiles.assign( GetTilesX() * GetTilesY(), 0 );
+	UpdateClearParameters();
+}
+
+void Framebuffer::Clear( const uint32_t& clearColor )
+{
+	const size_t pixelCount = size_t( pitch ) * paddedHeight;
+	const Kernels& kernels = GetKernels();
+	kernels.fillStream( color.Get(), clearColor, pixelCount );
+	kernels.fillStream( reinterpret_cast<uint32_t*>( depth.Get() ), 0, pixelCount );
+	if ( gBufferEnabled )
+	{
+		kernels.fillStream( albedo.Get(), 0, pixelCount );
+	}
+	if ( visibilityEnabled )
+	{
+		kernels.fillStream( visibility.Get(), 0, pixelCount );
+	}
+	if ( multisampleEnabled )
+	{
+		kernels.fillStream( colorSamples.Get(), clearColor, pixelCount * MultisampleCount );
+		kernels.fillStream( reinterpret_cast<uint32_t*>( depthSamples.Get() ), 0, pixelCount * MultisampleCount );
+	}
+
+	depthSign = -depthSign;
+	staleDepth = false;
+	clearPending = false;
+}
+
+void Framebuffer::ClearTiles( const uint32_t& clearColor, const bool& keepDepth )
+{
+	clearParameters.color = clearColor;
+	clearParameters.keepDepth = keepDepth;
+	depthSign = -depthSign;
+	staleDepth = keepDepth;
+	std::fill( pendingTiles.begin(), pendingTiles.end(), uint8_t( 1 ) );
+	clearPending = true;
+}
+
+void Framebuffer::FinishClears( ThreadPool& pool )
+{
+	if ( !clearPending )
+	{
+		return;
+	}
+
+	const auto clearTileRow = GetKernels().clearTileRow;
+	pool.ParallelFor( GetTilesY(), [&]( uint32_t tileY )
+	{
+		clearTileRow( clearParameters, tileY );
+	} );
+
+	clearPending = false;
+}
+
+void Framebuffer::SetGBufferEnabled( const bool& enabled )
+{
+	if ( enabled == gBufferEnabled )
+	{
+		return;
+	}
+
+	gBufferEnabled = enabled;
+	if ( enabled )
+	{
+		const size_t pixelCount = size_t( pitch ) * paddedHeight;
+		normals.Allocate( pixelCount );
+		albedo.Allocate( pixelCount );
+		GetKernels().fill( albedo.Get(), 0, pixelCount );
+	}
+	else
+	{
+		normals.Free();
+		albedo.Free();
+	}
+	UpdateClearParameters();
+}
+
+void Framebuffer::SetVisibilityEnabled( const bool& enabled )
+{
+	if ( enabled == visibilityEnabled )
+	{
+		return;
+	}
+
+	visibilityEnabled = enabled;
+	if ( enabled )
+	{
+		const size_t pixelCount = size_t( pitch ) * paddedHeight;
+		visibility.Allocate( pixelCount );
+		GetKernels().fill( visibility.Get(), 0, pixelCount );
+	}
+	else
+	{
+		visibility.Free();
+	}
+	UpdateClearParameters();
+}
+
+void Framebuffer::SetMultisampleEnabled( const bool& enabled )
+{
+	if ( enabled == multisampleEnabled )
+	{
+		return;
+	}
+
+	multisampleEnabled = enabled;
+	if ( enabled )
+	{
+		const size_t sampleCount = GetSampleStride() * MultisampleCount;
+		colorSamples.Allocate( sampleCount );
+		depthSamples.Allocate( sampleCount );
+		GetKernels().fill( colorSamples.Get(), 0, sampleCount );
+		GetKernels().fill( reinterpret_cast<uint32_t*>( depthSamples.Get() ), 0, sampleCount );
+	}
+	else
+	{
+		colorSamples.Free();
+		depthSamples.Free();
+	}
+	UpdateClearParameters();
+}
+
+void Framebuffer::ResolveSamples( ThreadPool& pool )
+{
+	if ( !multisampleEnabled || width == 0 || height == 0 )
+	{
+		return;
+	}
+
+	ResolveParameters parameters;
+	parameters.colorBuffer = color.Get();
+	parameters.colorSamples = colorSamples.Get();
+	parameters.sampleStride = GetSampleStride();
+	parameters.width = width;
+	parameters.height = height;
+	parameters.pitch = pitch;
+	parameters.pendingClear = GetPendingClear();
+
+	const auto resolveRow = GetKernels().resolveSamplesRow;
+	pool.ParallelFor( GetTilesY(), [&]( uint32_t tileY )
+	{
+		resolveRow( parameters, tileY );
+	} );
+}
+
+void Framebuffer::ApplyFxaa( ThreadPool& pool )
+{
+	if ( width == 0 || height == 0 )
+	{
+		return;
+	}
+
+	FinishClears( pool );
+	if ( postColor.Get() == nullptr )
+	{
+		postColor.Allocate( size_t( pitch ) * paddedHeight );
+	}
+
+	FxaaParameters parameters;
+	parameters.colorBuffer = color.Get();
+	parameters.outputBuffer = postColor.Get();
+	parameters.width = width;
+	parameters.height = height;
+	parameters.pitch = pitch;
+
+	// The edge search reaches into the rows of tiles around, so all of the luma has to be there first
+	const Kernels& kernels = GetKernels();
+	pool.ParallelFor( GetTilesY(), [&]( uint32_t tileY )
+	{
+		kernels.fxaaLumaRow( parameters, tileY );
+	} );
+	pool.ParallelFor( GetTilesY(), [&]( uint32_t tileY )
+	{
+		kernels.fxaaRow( parameters, tileY );
+	} );
+
+	color.Swap( postColor );
+	UpdateClearParameters();
+}
+
+void Framebuffer::Upscale( const uint32_t& targetWidth, const uint32_t& targetHeight, ThreadPool& pool )
+{
+	if ( width == 0 || height == 0 || targetWidth == 0 || targetHeight == 0 )
+	{
+		return;
+	}
+
+	if ( targetWidth != upscaledWidth || targetHeight != upscaledHeight )
+	{
+		upscaledWidth = targetWidth;
+		upscaledHeight = targetHeight;
+		upscaledPitch = (targetWidth + FramebufferPadding - 1) / FramebufferPadding * FramebufferPadding;
+		upscaledColor.Allocate( size_t( upscaledPitch ) * ((targetHeight + 1) & ~1U) );
+	}
+
+	UpscaleParameters parameters;
+	parameters.sourceBuffer = color.Get();
+	parameters.sourceWidth = width;
+	parameters.sourceHeight = height;
+	parameters.sourcePitch = pitch;
+	parameters.targetBuffer = upscaledColor.Get();
+	parameters.targetWidth = targetWidth;
+	parameters.targetHeight = targetHeight;
+	parameters.targetPitch = upscaledPitch;
+
+	const auto upscaleRow = GetKernels().upscaleRow;
+	pool.ParallelFor( (targetHeight + TileSize - 1) / TileSize, [&]( uint32_t tileY )
+	{
+		upscaleRow( parameters, tileY );
+	} );
+}
+
+void Framebuffer::UpdateClearParameters()
+{
+	clearParameters.colorBuffer = color.Get();
+	clearParameters.depthBuffer = depth.Get();
+	clearParameters.albedoBuffer = gBufferEnabled ? albedo.Get() : nullptr;
+	clearParameters.visibilityBuffer = visibilityEnabled ? visibility.Get() : nullptr;
+	clearParameters.pitch = pitch;
+	clearParameters.paddedHeight = paddedHeight;
+	clearParameters.pendingTiles = pendingTiles.data();
+	clearParameters.tilesX = GetTilesX();
+	clearParameters.colorSamples = multisampleEnabled ? colorSamples.Get() : nullptr;
+	clearParameters.depthSamples = multisampleEnabled ? depthSamples.Get() : nullptr;
+	clearParameters.sampleStride = GetSampleStride();
+}
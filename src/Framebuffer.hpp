@@ -0,0 +1,210 @@
+
+#pragma once
+
+#include "Kernels.hpp"
+#include "Memory.hpp"
+#include "ThreadPool.hpp"
+
+// Colour (ARGB8888) and depth buffers for the software rasterizer
+// The buffers are padded to a multiple of FramebufferPadding pixels wide and 2 tall, so that pixel
+// blocks at the right and bottom edges can be loaded and stored without bounds checks
+class Framebuffer
+{
+public:
+	// Only reallocates if the size actually changed
+	void Resize( const uint32_t& newWidth, const uint32_t& newHeight );
+
+	// The G-buffer's albedo and the visibility buffer get cleared along with the rest, so they read as empty
+	// Depth always clears to 0, infinitely far away, see DepthTest
+	// Right away, with streaming stores
+	void Clear( const uint32_t& color );
+
+	// Same, but each tile only gets cleared once the rasterizer first draws into it, while it's going to
+	// be in the cache anyway, see ClearParameters
+	// FinishClears has to come before anything else reads the buffers
+	// With keepDepth, the depth of the tiles that get drawn into isn't cleared at all: the depth sign flips
+	// with every clear, so what the last frame left is all farther than anything this frame draws
+	// Only for frames that go through ShadeDeferred or ResolveVisibility, which put the pixels nothing
+	// was drawn into back to 0, otherwise the last frame's depth would be around two frames later, with
+	// the sign matching again
+	void ClearTiles( const uint32_t& color, const bool& keepDepth );
+	// The tiles nothing was drawn into, spread over the pool by rows of tiles
+	void FinishClears( ThreadPool& pool );
+	// For the kernels, null if no tile is waiting for its clear
+	const ClearParameters* GetPendingClear() const
+	{
+		return clearPending ? &clearParameters : nullptr;
+	}
+
+	// What the depth of this frame gets multiplied with, flips with every clear
+	float GetDepthSign() const
+	{
+		return depthSign;
+	}
+
+	// The depth buffer may still have the last frame's depth where nothing was drawn yet
+	bool HasStaleDepth() const
+	{
+		return staleDepth;
+	}
+
+	// The extra buffers for deferred shading are only there while they're needed
+	void SetGBufferEnabled( const bool& enabled );
+
+	bool IsGBufferEnabled() const
+	{
+		return gBufferEnabled;
+	}
+
+	// Same for the visibility buffer
+	void SetVisibilityEnabled( const bool& enabled );
+
+	bool IsVisibilityEnabled() const
+	{
+		return visibilityEnabled;
+	}
+
+	// MultisampleCount colour and depth samples per pixel, which Rasterizer::Draw and DrawDepth draw into
+	// instead of the colour and depth buffers, the deferred and visibility buffer paths don't multisample
+	void SetMultisampleEnabled( const bool& enabled );
+
+	bool IsMultisampleEnabled() const
+	{
+		return multisampleEnabled;
+	}
+
+	// Averages the samples into the colour buffer, spread over the pool by rows of tiles
+	// Has to come after the draws and before FinishClears
+	void ResolveSamples( ThreadPool& pool );
+
+	// FXAA over the colour buffer, after FinishClears, which it does first, and before anything that shouldn't
+	// get smoothed, like lines, spread over the pool by rows of tiles
+	// Goes through another buffer that then gets swapped in, so GetColor changes, and it leaves the colour
+	// buffer opaque
+	void ApplyFxaa( ThreadPool& pool );
+
+	// Bilinear scaling of the colour buffer to another size, for rendering at a lower resolution than it's
+	// shown at, spread over the pool by rows of tiles, after everything else that goes into the colour buffer
+	// Into a buffer of its own, padded the same way, which only gets reallocated when the size changes
+	// Comes out opaque
+	void Upscale( const uint32_t& targetWidth, const uint32_t& targetHeight, ThreadPool& pool );
+
+	const uint32_t* GetUpscaledColor() const
+	{
+		return upscaledColor.Get();
+	}
+
+	uint32_t GetUpscaledPitch() const
+	{
+		return upscaledPitch;
+	}
+
+	uint32_t GetWidth() const
+	{
+		return width;
+	}
+
+	uint32_t GetHeight() const
+	{
+		return height;
+	}
+
+	// In pixels, distance between the starts of two rows
+	uint32_t GetPitch() const
+	{
+		return pitch;
+	}
+
+	uint32_t* GetColor() const
+	{
+		return color.Get();
+	}
+
+	float* GetDepth() const
+	{
+		return depth.Get();
+	}
+
+	// Octahedral-encoded, 16 bits per component
+	uint32_t* GetNormals() const
+	{
+		return normals.Get();
+	}
+
+	// RGB of the unlit surface colour, the top byte is the material ID, 0 where nothing was drawn
+	uint32_t* GetAlbedo() const
+	{
+		return albedo.Get();
+	}
+
+	// Per pixel, the ID of the triangle that's visible there, 0 where nothing was drawn
+	uint32_t* GetVisibility() const
+	{
+		return visibility.Get();
+	}
+
+	// Sample i of a pixel is GetSampleStride() * i after sample 0, which is at the same offset as the pixel
+	// in the other buffers
+	uint32_t* GetColorSamples() const
+	{
+		return colorSamples.Get();
+	}
+
+	float* GetDepthSamples() const
+	{
+		return depthSamples.Get();
+	}
+
+	size_t GetSampleStride() const
+	{
+		return size_t( pitch ) * paddedHeight;
+	}
+
+	uint32_t GetTilesX() const
+	{
+		return (width + TileSize - 1) / TileSize;
+	}
+
+	uint32_t GetTilesY() const
+	{
+		return (height + TileSize - 1) / TileSize;
+	}
+
+private:
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	uint32_t pitch{ 0 };
+	uint32_t paddedHeight{ 0 };
+
+	AlignedArray<uint32_t> color{ MemoryTag::Framebuffer };
+	AlignedArray<float> depth{ MemoryTag::Depth };
+
+	bool gBufferEnabled{ false };
+	AlignedArray<uint32_t> normals{ MemoryTag::Framebuffer };
+	AlignedArray<uint32_t> albedo{ MemoryTag::Framebuffer };
+
+	bool visibilityEnabled{ false };
+	AlignedArray<uint32_t> visibility{ MemoryTag::Framebuffer };
+
+	bool multisampleEnabled{ false };
+	AlignedArray<uint32_t> colorSamples{ MemoryTag::Framebuffer };
+	AlignedArray<float> depthSamples{ MemoryTag::Depth };
+
+	// Where ApplyFxaa puts its result, only there once it's been used
+	AlignedArray<uint32_t> postColor{ MemoryTag::Framebuffer };
+
+	AlignedArray<uint32_t> upscaledColor{ MemoryTag::Framebuffer };
+	uint32_t upscaledWidth{ 0 };
+	uint32_t upscaledHeight{ 0 };
+	uint32_t upscaledPitch{ 0 };
+
+	// Points at the buffers, has to follow them around whenever they change
+	void UpdateClearParameters();
+
+	float depthSign{ 1.0f };
+	bool staleDepth{ false };
+
+	bool clearPending{ false };
+	TrackedVector<uint8_t, MemoryTag::Framebuffer> pendingTiles;
+	ClearParameters clearParameters{};
+};
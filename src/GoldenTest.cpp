@@ -0,0 +1,399 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std::chrono;
+
+#include "SDL.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "src/Frame.hpp"
+#include "src/PerfCounters.hpp"
+
+// The golden image test: fixed views of the golden scene, each with its own render settings, rendered without
+// a window and compared against reference images that were rendered the same way before, to catch
+// optimisations that change the output
+// CTest runs it once per instruction set with the references in tests/golden, see CMakeLists.txt
+// Nothing moves in the scene, so it also checks the BVH refits by moving the objects about, see CheckRefit
+
+// What the test exits with when the CPU can't run the kernels it was asked for, CTest counts it as skipped
+constexpr int SkippedExitCode = 77;
+
+struct GoldenView
+{
+	const char* name;
+	glm::vec3 origin;
+	glm::vec3 angles;
+	RenderMode mode;
+	ShadingPath path;
+	Shader shader;
+	bool multisampling;
+	bool fxaa;
+};
+
+const GoldenView goldenViews[]
+{
+	{ "unlit", { -16.0f, 0.0f, 3.0f }, { 8.0f, 0.0f, 0.0f }, RenderMode::Solid, ShadingPath::Forward, Shader::Unlit, false, false },
+	{ "gouraud", { -16.0f, 0.0f, 3.0f }, { 8.0f, 0.0f, 0.0f }, RenderMode::Solid, ShadingPath::Forward, Shader::Gouraud, false, false },
+	{ "phong", { -18.0f, -10.0f, 10.0f }, { 26.0f, -29.0f, 0.0f }, RenderMode::Solid, ShadingPath::Forward, Shader::BlinnPhong, false, false },
+	{ "phong_msaa", { -18.0f, -10.0f, 10.0f }, { 26.0f, -29.0f, 0.0f }, RenderMode::Solid, ShadingPath::Forward, Shader::BlinnPhong, true, false },
+	{ "phong_fxaa", { -18.0f, -10.0f, 10.0f }, { 26.0f, -29.0f, 0.0f }, RenderMode::Solid, ShadingPath::Forward, Shader::BlinnPhong, false, true },
+	{ "deferred", { -18.0f, -10.0f, 10.0f }, { 26.0f, -29.0f, 0.0f }, RenderMode::Solid, ShadingPath::Deferred, Shader::BlinnPhong, false, false },
+	{ "visibility", { -18.0f, -10.0f, 10.0f }, { 26.0f, -29.0f, 0.0f }, RenderMode::Solid, ShadingPath::Visibility, Shader::BlinnPhong, false, false },
+	{ "wireframe", { -16.0f, 0.0f, 3.0f }, { 8.0f, 0.0f, 0.0f }, RenderMode::Wireframe, ShadingPath::Forward, Shader::Unlit, false, false },
+	{ "hidden_line", { -18.0f, -10.0f, 10.0f }, { 26.0f, -29.0f, 0.0f }, RenderMode::HiddenLine, ShadingPath::Forward, Shader::Unlit, false, false }
+};
+
+constexpr uint32_t GoldenWidth = 640;
+constexpr uint32_t GoldenHeight = 480;
+// Frames to wait at most for the meshes to load and the textures to stream in, before rendering anyway
+constexpr int GoldenMaxSettleFrames = 1000;
+// Of each view, after it settled, the time is the average
+constexpr int GoldenTimedFrames = 10;
+
+// ARGB8888, tightly packed, saved without the alpha since the references are in the repo
+bool SaveImage( const std::string& path, std::vector<uint32_t>& pixels, const uint32_t& width, const uint32_t& height )
+{
+	SDL_Surface* wrapped = SDL_CreateRGBSurfaceWithFormatFrom( pixels.data(), width, height, 32, width * sizeof( uint32_t ), SDL_PIXELFORMAT_ARGB8888 );
+	if ( wrapped == nullptr )
+	{
+		return false;
+	}
+
+	SDL_Surface* surface = SDL_ConvertSurfaceFormat( wrapped, SDL_PIXELFORMAT_RGB24, 0 );
+	SDL_FreeSurface( wrapped );
+	if ( surface == nullptr )
+	{
+		return false;
+	}
+
+	const bool saved = SDL_SaveBMP( surface, path.c_str() ) == 0;
+	SDL_FreeSurface( surface );
+	return saved;
+}
+
+bool LoadImage( const std::string& path, std::vector<uint32_t>& outPixels, uint32_t& outWidth, uint32_t& outHeight )
+{
+	SDL_Surface* loaded = SDL_LoadBMP( path.c_str() );
+	if ( loaded == nullptr )
+	{
+		return false;
+	}
+
+	SDL_Surface* surface = SDL_ConvertSurfaceFormat( loaded, SDL_PIXELFORMAT_ARGB8888, 0 );
+	SDL_FreeSurface( loaded );
+	if ( surface == nullptr )
+	{
+		return false;
+	}
+
+	outWidth = surface->w;
+	outHeight = surface->h;
+	outPixels.resize( size_t( outWidth ) * outHeight );
+	SDL_LockSurface( surface );
+	for ( uint32_t y = 0; y < outHeight; y++ )
+	{
+		std::memcpy( &outPixels[size_t( y ) * outWidth], static_cast<const char*>( surface->pixels ) + size_t( y ) * surface->pitch,
+			outWidth * sizeof( uint32_t ) );
+	}
+	SDL_UnlockSurface( surface );
+	SDL_FreeSurface( surface );
+	return true;
+}
+
+// Renders every golden view and compares it with the reference image in directory, or replaces the reference
+// Pixels match if none of their colour channels are more than tolerance apart, the ones that don't end up
+// in a diff image next to the reference, along with what was rendered, both named after the kernels so the
+// tests of the instruction sets don't overwrite each other's
+// Returns how many views didn't match, or had no reference to compare with
+int RunGoldenImages( const std::string& directory, const bool& update, const int& tolerance )
+{
+	dynamicResolution.SetEnabled( false );
+
+	int failures = 0;
+	for ( const GoldenView& view : goldenViews )
+	{
+		viewOrigin = view.origin;
+		viewAngles = view.angles;
+		renderMode = view.mode;
+		shadingPath = view.path;
+		pipelineState.shader = view.shader;
+		multisampling = view.multisampling;
+		fxaa = view.fxaa;
+
+		// Until the meshes are in and the texture levels the view needs are streamed in, for a couple of frames
+		// in a row, with the loads and streaming getting some time in between
+		int settledFrames = 0;
+		for ( int frame = 0; frame < GoldenMaxSettleFrames && settledFrames < 2; frame++ )
+		{
+			RunFrame( 0.0f, UserCommands(), GoldenWidth, GoldenHeight );
+			if ( assets.GetPendingCount() == 0 && textureCache.GetStreamingCount() == 0 )
+			{
+				settledFrames++;
+			}
+			else
+			{
+				settledFrames = 0;
+				std::this_thread::sleep_for( milliseconds( 1 ) );
+			}
+		}
+
+		GetPerfCounters().ResetCounts();
+		const auto tpStart = system_clock::now();
+		for ( int frame = 0; frame < GoldenTimedFrames; frame++ )
+		{
+			RunFrame( 0.0f, UserCommands(), GoldenWidth, GoldenHeight );
+		}
+		const float frameTime = duration_cast<microseconds>(system_clock::now() - tpStart).count() * 0.001f / GoldenTimedFrames;
+
+		const uint32_t width = framebuffer.GetWidth();
+		const uint32_t height = framebuffer.GetHeight();
+		std::vector<uint32_t> rendered( size_t( width ) * height );
+		for ( uint32_t y = 0; y < height; y++ )
+		{
+			for ( uint32_t x = 0; x < width; x++ )
+			{
+				rendered[size_t( y ) * width + x] = framebuffer.GetColor()[size_t( y ) * framebuffer.GetPitch() + x] | 0xFF000000;
+			}
+		}
+
+		const std::string path = directory + "/" + view.name;
+		// Only the timed frames, just after they're done
+		GetPerfCounters().BeginStage( uint32_t( FrameStage::Present ) );
+		PrintPerfCounters( std::string( "Performance counters of " ) + view.name );
+		std::cout << view.name << ": " << frameTime << " ms, ";
+		if ( update )
+		{
+			if ( SaveImage( path + ".bmp", rendered, width, height ) )
+			{
+				std::cout << "written" << std::endl;
+			}
+			else
+			{
+				std::cout << "couldn't write " << path << ".bmp" << std::endl;
+				failures++;
+			}
+			continue;
+		}
+
+		std::vector<uint32_t> reference;
+		uint32_t referenceWidth, referenceHeight;
+		if ( !LoadImage( path + ".bmp", reference, referenceWidth, referenceHeight ) || referenceWidth != width || referenceHeight != height )
+		{
+			std::cout << "no reference image of the same size at " << path << ".bmp" << std::endl;
+			failures++;
+			continue;
+		}
+
+		// Differences in red, the rest is the reference darkened
+		std::vector<uint32_t> diff( rendered.size() );
+		uint32_t differing = 0;
+		int worst = 0;
+		for ( size_t i = 0; i < rendered.size(); i++ )
+		{
+			int difference = 0;
+			for ( int shift = 0; shift < 24; shift += 8 )
+			{
+				difference = std::max( difference, std::abs( int( (rendered[i] >> shift) & 0xFF ) - int( (reference[i] >> shift) & 0xFF ) ) );
+			}
+			worst = std::max( worst, difference );
+
+			if ( difference > tolerance )
+			{
+				differing++;
+				diff[i] = 0xFF000000 | (std::min( 64 + difference * 4, 255 ) << 16);
+			}
+			else
+			{
+				diff[i] = 0xFF000000 | ((reference[i] >> 2) & 0x3F3F3F);
+			}
+		}
+
+		if ( differing == 0 )
+		{
+			std::cout << "matches" << std::endl;
+			continue;
+		}
+
+		const std::string outputPath = path + "." + GetSimdLevelName( GetKernels().level );
+		std::cout << differing << " pixels differ by up to " << worst << ", see " << outputPath << ".diff.bmp" << std::endl;
+		SaveImage( outputPath + ".diff.bmp", diff, width, height );
+		SaveImage( outputPath + ".rendered.bmp", rendered, width, height );
+		failures++;
+	}
+
+	return failures;
+}
+
+// Moves the golden scene's objects about and refits instead of rebuilding: Scene::SetTransform refits the path
+// above each object, Bvh::Refit the whole tree at once. Culling and picking through those have to find exactly
+// what they find through a BVH built from scratch over the moved objects, from cameras all around the scene
+// Returns how many frustums and rays didn't
+int CheckRefit()
+{
+	Scene refitted;
+	Scene rebuilt;
+	std::vector<Aabb> bounds;
+	std::vector<Aabb> movedBounds;
+	for ( uint32_t i = 0; i < scene.GetObjectCount(); i++ )
+	{
+		const SceneObject& object = scene.GetObject( i );
+		refitted.AddObject( object.mesh, object.transform );
+		bounds.push_back( object.worldBounds );
+	}
+	refitted.Update();
+
+	// Far enough that objects end up under other parts of the tree than the ones they were built into
+	for ( uint32_t i = 0; i < scene.GetObjectCount(); i++ )
+	{
+		const SceneObject& object = scene.GetObject( i );
+		const glm::vec3 offset( float( int( i * 5 % 7 ) - 3 ) * 3.0f, float( int( i * 3 % 5 ) - 2 ) * 4.0f, float( i % 3 ) );
+		const glm::mat4 transform = glm::rotate( glm::translate( glm::mat4( 1.0f ), offset ) * object.transform,
+			glm::radians( 30.0f * i ), glm::vec3( 0.0f, 0.0f, 1.0f ) );
+		refitted.SetTransform( i, transform );
+		rebuilt.AddObject( object.mesh, transform );
+		movedBounds.push_back( rebuilt.GetObject( i ).worldBounds );
+	}
+	rebuilt.Update();
+
+	Bvh wholeRefitted;
+	wholeRefitted.Build( bounds.data(), bounds.size() );
+	wholeRefitted.Refit( movedBounds.data() );
+
+	int mismatches = 0;
+	constexpr int Cameras = 16;
+	constexpr int RaysX = 16;
+	constexpr int RaysY = 12;
+	for ( int camera = 0; camera < Cameras; camera++ )
+	{
+		const float angle = glm::radians( camera * 360.0f / Cameras );
+		const glm::vec3 eye( std::cos( angle ) * 30.0f, std::sin( angle ) * 30.0f, 4.0f + float( camera % 4 ) * 4.0f );
+		// Narrow, so most of them only see part of the scene
+		const glm::mat4 viewProj = glm::perspective( glm::radians( 40.0f ), 4.0f / 3.0f, 0.01f, 1000.0f )
+			* glm::lookAt( eye, glm::vec3( 0.0f ), glm::vec3( 0.0f, 0.0f, 1.0f ) );
+		const Frustum frustum = Frustum::FromMatrix( viewProj );
+
+		// In whatever order the trees were walked in
+		TrackedVector<uint32_t, MemoryTag::Frame> expected;
+		TrackedVector<uint32_t, MemoryTag::Frame> visible;
+		TrackedVector<uint32_t, MemoryTag::Frame> wholeVisible;
+		rebuilt.CullVisible( frustum, expected );
+		refitted.CullVisible( frustum, visible );
+		wholeRefitted.CullFrustum( frustum, movedBounds.data(), wholeVisible );
+		std::sort( expected.begin(), expected.end() );
+		std::sort( visible.begin(), visible.end() );
+		std::sort( wholeVisible.begin(), wholeVisible.end() );
+		mismatches += (visible != expected) + (wholeVisible != expected);
+
+		const glm::mat4 inverseViewProj = glm::inverse( viewProj );
+		for ( int y = 0; y < RaysY; y++ )
+		{
+			for ( int x = 0; x < RaysX; x++ )
+			{
+				glm::vec4 farPoint = inverseViewProj * glm::vec4( (x + 0.5f) * 2.0f / RaysX - 1.0f, (y + 0.5f) * 2.0f / RaysY - 1.0f, 1.0f, 1.0f );
+				farPoint /= farPoint.w;
+				const Ray ray( eye, glm::normalize( glm::vec3( farPoint ) - eye ) );
+
+				PickResult expectedPick;
+				PickResult pick;
+				rebuilt.Pick( ray, expectedPick );
+				refitted.Pick( ray, pick );
+				mismatches += pick.object != expectedPick.object || pick.triangle != expectedPick.triangle || pick.distance != expectedPick.distance;
+			}
+		}
+	}
+
+	std::cout << "refit: ";
+	if ( mismatches == 0 )
+	{
+		std::cout << "culling and picking match a fresh build, from " << Cameras << " cameras with " << RaysX * RaysY << " rays each" << std::endl;
+	}
+	else
+	{
+		std::cout << mismatches << " frustums and rays found something else than through a fresh build" << std::endl;
+	}
+
+	return mismatches;
+}
+
+// Usage: SoftRendaGolden <reference directory> -tolerance <per channel> [-simd <sse2|avx2|avx512>] [-update] [-perfcounters]
+int main( int argc, char** argv )
+{
+	std::string directory;
+	bool update = false;
+	int tolerance = -1;
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( !std::strcmp( argv[i], "-tolerance" ) && i + 1 < argc )
+		{
+			tolerance = std::atoi( argv[++i] );
+		}
+		else if ( !std::strcmp( argv[i], "-simd" ) && i + 1 < argc )
+		{
+			// Exactly these kernels, unlike the renderer's -simd there's no falling back to the ones below
+			SimdLevel level;
+			if ( !ParseSimdLevel( argv[++i], level ) )
+			{
+				std::cerr << "Unknown instruction set " << argv[i] << ", expected sse2, avx2 or avx512" << std::endl;
+				return 2;
+			}
+
+			SelectKernels( level );
+			if ( GetKernels().level != level )
+			{
+				std::cout << "Skipped, the " << argv[i] << " kernels can't run here, the CPU supports "
+					<< GetSimdLevelName( DetectSimdLevel() ) << std::endl;
+				return SkippedExitCode;
+			}
+		}
+		else if ( !std::strcmp( argv[i], "-update" ) )
+		{
+			// Writes new references instead of comparing
+			update = true;
+		}
+		else if ( !std::strcmp( argv[i], "-perfcounters" ) )
+		{
+			// After each view
+			if ( !GetPerfCounters().Enable() )
+			{
+				std::cerr << "No hardware performance counters, they need Linux, a CPU that exposes them and perf_event_paranoid at 2 or less" << std::endl;
+			}
+		}
+		else if ( directory.empty() )
+		{
+			directory = argv[i];
+		}
+		else
+		{
+			std::cerr << "Unknown argument " << argv[i] << std::endl;
+			return 2;
+		}
+	}
+
+	// Both come from the test, a default here would quietly apply to every test that forgot one
+	if ( directory.empty() || (tolerance < 0 && !update) )
+	{
+		std::cerr << "Usage: SoftRendaGolden <reference directory> -tolerance <per channel> [-simd <sse2|avx2|avx512>] [-update] [-perfcounters]" << std::endl;
+		return 2;
+	}
+
+	SDL_Init( 0 );
+
+	std::cout << "Using " << GetSimdLevelName( GetKernels().level ) << " kernels (the CPU supports "
+		<< GetSimdLevelName( DetectSimdLevel() ) << ")" << std::endl;
+
+	CreateGoldenScene();
+	CreateLights();
+	int failures = RunGoldenImages( directory, update, tolerance );
+	failures += CheckRefit();
+
+	PrintMemoryUsage( "Memory at exit" );
+	SDL_Quit();
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+
+#include "Input.hpp"
+
+constexpr uint32_t InputRecordingHeader::Magic;
+constexpr uint32_t InputRecordingHeader::CurrentVersion;
+
+InputRecorder::~InputRecorder()
+{
+	if ( file != nullptr )
+	{
+		std::fclose( file );
+	}
+}
+
+bool InputRecorder::Open( const char* path )
+{
+	if ( file != nullptr )
+	{
+		std::fclose( file );
+	}
+
+	file = std::fopen( path, "wb" );
+	if ( file == nullptr )
+	{
+		return false;
+	}
+
+	InputRecordingHeader header{};
+	header.magic = InputRecordingHeader::Magic;
+	header.version = InputRecordingHeader::CurrentVersion;
+	if ( std::fwrite( &header, sizeof( header ), 1, file ) != 1 )
+	{
+		std::fclose( file );
+		file = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void InputRecorder::Write( const RecordedFrame& frame )
+{
+	if ( file != nullptr )
+	{
+		std::fwrite( &frame, sizeof( frame ), 1, file );
+	}
+}
+
+bool InputReplay::Load( const char* path )
+{
+	frames.clear();
+	position = 0;
+
+	std::FILE* file = std::fopen( path, "rb" );
+	if ( file == nullptr )
+	{
+		return false;
+	}
+
+	InputRecordingHeader header{};
+	const bool valid = std::fread( &header, sizeof( header ), 1, file ) == 1
+		&& header.magic == InputRecordingHeader::Magic && header.version == InputRecordingHeader::CurrentVersion;
+	if ( valid )
+	{
+		// A partly written frame at the end is dropped
+		RecordedFrame frame;
+		while ( std::fread( &frame, sizeof( frame ), 1, file ) == 1 )
+		{
+			frames.push_back( frame );
+		}
+	}
+
+	std::fclose( file );
+	return valid;
+}
+
+bool InputReplay::Next( RecordedFrame& outFrame )
+{
+	if ( position >= frames.size() )
+	{
+		return false;
+	}
+
+	outFrame = frames[position++];
+	return true;
+}
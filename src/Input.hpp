@@ -0,0 +1,110 @@
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// What the player did during a frame
+struct UserCommands
+{
+	enum Flags
+	{
+		Quit = 1,
+		SpeedModifier = 2,
+		LeftMouseButton = 4,
+		RightMouseButton = 8,
+		// Number keys, they flip the render settings
+		CycleRenderMode = 16,
+		ToggleTexturing = 32,
+		CycleShader = 64,
+		ToggleBlending = 128,
+		CycleCullMode = 256,
+		CycleShadingPath = 512,
+		ToggleDepthPrepass = 1024,
+		ToggleDepthClearElision = 2048,
+		ToggleMultisampling = 4096,
+		ToggleFxaa = 8192,
+		ToggleDynamicResolution = 16384,
+		// M
+		PrintMemoryUsage = 32768
+	};
+
+	int flags{ 0 };
+
+	float forward{ 0.0f };
+	float right{ 0.0f };
+	float up{ 0.0f };
+
+	float mouseX{ 0.0f };
+	float mouseY{ 0.0f };
+
+	// Where the cursor was when a mouse button got pressed, in window coords
+	float cursorX{ 0.0f };
+	float cursorY{ 0.0f };
+};
+
+// Input recordings are an InputRecordingHeader followed by a RecordedFrame per frame, laid out the way they are in
+// memory, written as the frames happen, so one that got cut short is still good up to there
+struct InputRecordingHeader
+{
+	static constexpr uint32_t Magic = 'S' | ('R' << 8) | ('I' << 16) | ('R' << 24);
+	// Bump this whenever RecordedFrame or UserCommands change
+	static constexpr uint32_t CurrentVersion = 1;
+
+	uint32_t magic;
+	uint32_t version;
+};
+
+// Along with the commands, all a frame depends on from outside, so replaying them moves the camera the same way
+struct RecordedFrame
+{
+	UserCommands commands;
+	// How long the frame before took, in seconds, the camera moves by it
+	float deltaTime;
+	// What the window's size was, it's rendered at that
+	uint32_t windowWidth;
+	uint32_t windowHeight;
+};
+
+class InputRecorder
+{
+public:
+	InputRecorder() = default;
+	~InputRecorder();
+
+	InputRecorder( const InputRecorder& ) = delete;
+	InputRecorder& operator=( const InputRecorder& ) = delete;
+
+	// Starts a new recording, replacing whatever was at path
+	bool Open( const char* path );
+
+	bool IsOpen() const
+	{
+		return file != nullptr;
+	}
+
+	void Write( const RecordedFrame& frame );
+
+private:
+	std::FILE* file{ nullptr };
+};
+
+class InputReplay
+{
+public:
+	// Reads the whole recording in, fails if it's missing or from another version
+	bool Load( const char* path );
+
+	// The frames in order, false once they're all through
+	bool Next( RecordedFrame& outFrame );
+
+	size_t GetFrameCount() const
+	{
+		return frames.size();
+	}
+
+private:
+	std::vector<RecordedFrame> frames;
+	size_t position{ 0 };
+};
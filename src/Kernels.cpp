@@ -0,0 +1,166 @@
+
+#include <cstring>
+
+#include "Kernels.hpp"
+
+#if defined( _MSC_VER ) && (defined( _M_X64 ) || defined( _M_IX86 ))
+#include <intrin.h>
+#define THE_X86 1
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+#define THE_X86 1
+#else
+#define THE_X86 0
+#endif
+
+namespace
+{
+#if THE_X86
+	struct CpuidResult
+	{
+		uint32_t eax;
+		uint32_t ebx;
+		uint32_t ecx;
+		uint32_t edx;
+	};
+
+	CpuidResult Cpuid( const uint32_t& leaf, const uint32_t& subleaf )
+	{
+		CpuidResult result{};
+#if defined( _MSC_VER )
+		int registers[4];
+		__cpuidex( registers, int( leaf ), int( subleaf ) );
+		result = { uint32_t( registers[0] ), uint32_t( registers[1] ), uint32_t( registers[2] ), uint32_t( registers[3] ) };
+#else
+		__cpuid_count( leaf, subleaf, result.eax, result.ebx, result.ecx, result.edx );
+#endif
+		return result;
+	}
+
+	// Which register states the OS saves on a context switch
+	uint64_t GetEnabledStates()
+	{
+#if defined( _MSC_VER )
+		return _xgetbv( 0 );
+#else
+		// Not through the intrinsic, that one would need -mxsave for this whole file
+		uint32_t eax, edx;
+		__asm__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"( 0 ) );
+		return (uint64_t( edx ) << 32) | eax;
+#endif
+	}
+#endif
+
+	const Kernels* GetKernelsFor( const SimdLevel& level )
+	{
+		switch ( level )
+		{
+		case SimdLevel::Avx512: return GetKernelsAvx512();
+		case SimdLevel::Avx2: return GetKernelsAvx2();
+		default: return GetKernelsSse2();
+		}
+	}
+
+	// The best compiled-in kernels at or below this level
+	const Kernels* FindKernels( const SimdLevel& level )
+	{
+		for ( int candidate = int( level ); candidate > 0; candidate-- )
+		{
+			if ( const Kernels* kernels = GetKernelsFor( SimdLevel( candidate ) ) )
+			{
+				return kernels;
+			}
+		}
+
+		return GetKernelsSse2();
+	}
+
+	const Kernels*& GetActiveKernels()
+	{
+		static const Kernels* active = FindKernels( DetectSimdLevel() );
+		return active;
+	}
+
+	const char* const SimdLevelNames[]
+	{
+		"sse2",
+		"avx2",
+		"avx512"
+	};
+}
+
+SimdLevel DetectSimdLevel()
+{
+#if THE_X86
+	const uint32_t maxLeaf = Cpuid( 0, 0 ).eax;
+	if ( maxLeaf < 7 )
+	{
+		return SimdLevel::Sse2;
+	}
+
+	const CpuidResult features = Cpuid( 1, 0 );
+	const CpuidResult extended = Cpuid( 7, 0 );
+
+	const bool osxsave = features.ecx & (1U << 27);
+	if ( !osxsave )
+	{
+		return SimdLevel::Sse2;
+	}
+
+	// The CPU having the instructions isn't enough, the OS has to save the wider registers too
+	const uint64_t states = GetEnabledStates();
+	const bool ymmEnabled = (states & 0x6) == 0x6;
+	const bool zmmEnabled = (states & 0xE6) == 0xE6;
+
+	const bool avx = features.ecx & (1U << 28);
+	const bool fma = features.ecx & (1U << 12);
+	const bool avx2 = extended.ebx & (1U << 5);
+	if ( !ymmEnabled || !avx || !fma || !avx2 )
+	{
+		return SimdLevel::Sse2;
+	}
+
+	const bool avx512f = extended.ebx & (1U << 16);
+	const bool avx512dq = extended.ebx & (1U << 17);
+	const bool avx512bw = extended.ebx & (1U << 30);
+	const bool avx512vl = extended.ebx & (1U << 31);
+	if ( zmmEnabled && avx512f && avx512dq && avx512bw && avx512vl )
+	{
+		return SimdLevel::Avx512;
+	}
+
+	return SimdLevel::Avx2;
+#else
+	return SimdLevel::Sse2;
+#endif
+}
+
+const char* GetSimdLevelName( const SimdLevel& level )
+{
+	return SimdLevelNames[int( level )];
+}
+
+bool ParseSimdLevel( const char* name, SimdLevel& outLevel )
+{
+	for ( int level = 0; level < int( SimdLevel::Count ); level++ )
+	{
+		if ( !std::strcmp( name, SimdLevelNames[level] ) )
+		{
+			outLevel = SimdLevel( level );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void SelectKernels( const SimdLevel& level )
+{
+	const SimdLevel supported = DetectSimdLevel();
+	GetActiveKernels() = FindKernels( int( level ) < int( supported ) ? level : supported );
+}
+
+const Kernels& GetKernels()
+{
+	return *GetActiveKernels();
+}
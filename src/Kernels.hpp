@@ -0,0 +1,392 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Texture;
+
+// Instruction sets the kernels get compiled for, from the baseline upwards
+enum class SimdLevel : uint8_t
+{
+	Sse2 = 0,
+	Avx2,
+	Avx512,
+	Count
+};
+
+// Depth is stored reversed, as 1 / w, so 0 is infinitely far away and float keeps the same relative
+// precision all the way out, where z / w would have next to none left
+// Every clear flips the sign it's stored with, see Framebuffer::ClearTiles
+enum class DepthTest : uint8_t
+{
+	Off = 0,
+	// Nearer than what's there already
+	Nearer,
+	// Exactly what's there already, for drawing again after a depth pre-pass, never writes depth
+	Equal,
+	Count
+};
+
+enum class CullMode : uint8_t
+{
+	None = 0,
+	Back,
+	Front,
+	Count
+};
+
+// The vertex and pixel shader pairs a draw can use, see Shaders.hpp
+enum class Shader : uint8_t
+{
+	// The draw's colour, times the texture
+	Unlit = 0,
+	// Also times the vertex normals, as colours
+	VertexColors,
+	// Lit per vertex, the lighting gets interpolated
+	Gouraud,
+	// Lit per pixel, with Blinn-Phong highlights, only going through the lights that reach the pixel's tile
+	BlinnPhong,
+	Count
+};
+
+enum class LightType : uint8_t
+{
+	Directional = 0,
+	Point,
+	Spot,
+	Count
+};
+
+// A light in world space, as the shaders see it
+struct LightParameters
+{
+	LightType type;
+	float position[3];
+	// Where it shines towards, normalised
+	float direction[3];
+	// Premultiplied by the intensity
+	float color[3];
+	// Point and spot lights fade out to nothing at their range
+	float invRangeSquared;
+	// Spot lights go from full brightness at the inner cone's cosine to nothing at the outer one's
+	float cosOuter;
+	float invConeWidth;
+};
+
+// The lights of a frame, plus a list per screen tile of the ones that can reach into it
+struct LightingParameters
+{
+	const LightParameters* lights;
+	uint32_t lightCount;
+	float ambient[3];
+	float viewOrigin[3];
+
+	// The lights of tile (x, y) are tileLightIndices[tileLightOffsets[i]] up to tileLightIndices[tileLightOffsets[i + 1]],
+	// with i = y * tilesX + x
+	const uint32_t* tileLightOffsets;
+	const uint32_t* tileLightIndices;
+	uint32_t tilesX;
+};
+
+// Values a vertex shader can pass on to the pixel shader, on top of the position
+constexpr uint32_t MaxVaryings = 8;
+
+// Screen space is split into tiles of this many pixels in each direction
+constexpr uint32_t TileSize = 64;
+// Rows are padded to a multiple of this many pixels, the widest pixel block any of the kernels use
+constexpr uint32_t FramebufferPadding = 8;
+// Samples per pixel when multisampling
+constexpr uint32_t MultisampleCount = 4;
+
+// One mip level of a texture, as the pixel loop samples it
+struct TextureLevel
+{
+	const uint32_t* texels;
+	uint32_t width;
+	uint32_t height;
+};
+
+// A clear that each screen tile only gets once something draws into it, so the cleared pixels are
+// still in the cache then, and tiles that are never drawn into are only written once
+struct ClearParameters
+{
+	uint32_t* colorBuffer;
+	float* depthBuffer;
+	// Null if the framebuffer doesn't have them
+	uint32_t* albedoBuffer;
+	uint32_t* visibilityBuffer;
+	// Including the padding, which gets cleared too
+	uint32_t pitch;
+	uint32_t paddedHeight;
+
+	uint32_t color;
+	// Leave the depth alone when the rasterizer gets to a tile, it's all farther than anything in this frame
+	bool keepDepth;
+
+	// Non-zero for tiles that still have to be cleared, y * tilesX + x
+	uint8_t* pendingTiles;
+	uint32_t tilesX;
+
+	// Null if the framebuffer isn't multisampled, see DrawParameters
+	uint32_t* colorSamples;
+	float* depthSamples;
+	size_t sampleStride;
+};
+
+// Everything a draw needs, as plain arrays
+// The kernels don't see glm or the standard library at all, because their inline functions would get
+// compiled with e.g. AVX2 enabled, and the linker could then use that copy everywhere else too
+struct DrawParameters
+{
+	uint32_t* colorBuffer;
+	float* depthBuffer;
+	// The G-buffer, only for the draws that fill it
+	uint32_t* normalBuffer;
+	uint32_t* albedoBuffer;
+	// Same for the visibility buffer
+	uint32_t* visibilityBuffer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	// Tiles get cleared before the draw first touches them, may be null
+	const ClearParameters* pendingClear;
+	// What the depth gets multiplied with before it's stored, 1 or -1
+	float depthSign;
+	// Only for the permutations that multisample, which leave the colour and depth buffers above alone
+	// Sample i of a pixel is sampleStride * i after sample 0, at the same offset as the pixel in the other buffers
+	uint32_t* colorSamples;
+	float* depthSamples;
+	size_t sampleStride;
+
+	// 3 floats per position and normal, 2 per texcoord, normals and texcoords may be null
+	const float* positions;
+	const float* normals;
+	const float* texCoords;
+	const uint32_t* indices;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	// Room for 4 + MaxVaryings floats per vertex, for what the vertex shader puts out
+	float* vertexOutputs;
+	// Written into the visibility buffer for the mesh's first triangle, the others count up from there
+	uint32_t visibilityId;
+
+	// Column-major, like glm
+	float modelViewProj[16];
+	float model[16];
+	// For the normals, the inverse transpose of the model matrix's upper 3x3
+	float normalMatrix[9];
+	float color[4];
+
+	// Only looked at when resolving the visibility buffer, the draw functions have it baked in
+	Shader shader;
+
+	// Only looked at by the lit shaders
+	const LightingParameters* lighting;
+	float specular;
+	float shininess;
+	// What the G-buffer remembers of the above, 1 and up
+	uint8_t materialId;
+
+	// Only for lines, how much nearer they count as for the depth test, relative to their 1 / w
+	float lineDepthBias;
+
+	// Only looked at by the permutations that sample
+	const Texture* texture;
+	uint32_t textureWidth;
+	uint32_t textureHeight;
+	// The resident level closest to lod, also notes down which level was wanted
+	TextureLevel( *selectTextureLevel )( const Texture* texture, const float& lod );
+};
+
+// The part of a draw that deferred shading needs to know again later
+struct MaterialParameters
+{
+	float specular;
+	float shininess;
+};
+
+// Lights whatever made it into the G-buffer
+struct DeferredParameters
+{
+	uint32_t* colorBuffer;
+	float* depthBuffer;
+	const uint32_t* normalBuffer;
+	const uint32_t* albedoBuffer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+
+	// Tiles that are still waiting for their clear had nothing drawn into them, may be null
+	const ClearParameters* pendingClear;
+	float depthSign;
+	// Puts the depth of the pixels nothing was drawn into back to 0, so the next frame doesn't have to clear it
+	bool clearEmptyDepth;
+
+	// Back from clip space into world space
+	float inverseViewProj[16];
+	// Along any view ray, clip-space z is w * depthToClipZ[0] + depthToClipZ[1], true of all perspective projections
+	float depthToClipZ[2];
+	const LightingParameters* lighting;
+	// Indexed by material ID, ID 0 means nothing was drawn there
+	const MaterialParameters* materials;
+};
+
+// Shades whatever made it into the visibility buffer
+struct VisibilityParameters
+{
+	uint32_t* colorBuffer;
+	float* depthBuffer;
+	const uint32_t* visibilityBuffer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+
+	// Same as for deferred shading
+	const ClearParameters* pendingClear;
+	bool clearEmptyDepth;
+
+	// Sorted by visibility ID, their vertex outputs have to still be there
+	const DrawParameters* draws;
+	uint32_t drawCount;
+};
+
+// Averages the samples of a multisampled framebuffer into its colour buffer
+struct ResolveParameters
+{
+	uint32_t* colorBuffer;
+	const uint32_t* colorSamples;
+	size_t sampleStride;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+
+	// Same as for deferred shading
+	const ClearParameters* pendingClear;
+};
+
+// Anti-aliases the finished colour buffer into another one, see Framebuffer::ApplyFxaa
+struct FxaaParameters
+{
+	// Gets each pixel's luma put into its alpha
+	uint32_t* colorBuffer;
+	uint32_t* outputBuffer;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+};
+
+// Bilinear scaling of a colour buffer to a different size, see Framebuffer::Upscale
+struct UpscaleParameters
+{
+	const uint32_t* sourceBuffer;
+	uint32_t sourceWidth;
+	uint32_t sourceHeight;
+	uint32_t sourcePitch;
+
+	// Padded like a Framebuffer's
+	uint32_t* targetBuffer;
+	uint32_t targetWidth;
+	uint32_t targetHeight;
+	uint32_t targetPitch;
+};
+
+using DrawFunction = void( const DrawParameters& parameters );
+// Between two points in clip space, x, y, z and w each
+using LineFunction = void( const DrawParameters& parameters, const float* from, const float* to );
+
+// Hidden-line draws go in parallel over bands of this many rows, see Rasterizer::DrawHiddenLines
+// They don't have to line up with the tiles, since all of those get cleared first
+constexpr uint32_t HiddenLineBandHeight = 16;
+
+// A triangle of a hidden-line draw, with the bands it reaches into
+struct HiddenLineTriangle
+{
+	uint32_t triangle;
+	uint16_t firstBand;
+	uint16_t lastBand;
+};
+
+// Set on triangles that don't cover any pixel centre, so only their edges get drawn
+constexpr uint32_t HiddenLineEdgesOnly = 0x80000000U;
+
+// Writes the triangles that aren't culled or off screen, returns how many
+using HiddenLineBinFunction = uint32_t( const DrawParameters& parameters, const uint32_t* triangles, const uint32_t& count,
+	HiddenLineTriangle* outTriangles );
+// Only into one band, bands can go in parallel
+using HiddenLineBandFunction = void( const DrawParameters& parameters, const uint32_t* triangles, const uint32_t& count, const uint32_t& band );
+
+// Depth test + depth test count * (depth write | blend << 1 | textured << 2 | multisampled << 3),
+// then that times (shader + shader count * cull mode)
+constexpr uint32_t DrawStatePermutationCount = 16 * uint32_t( DepthTest::Count );
+constexpr uint32_t DrawPermutationCount = DrawStatePermutationCount * uint32_t( Shader::Count ) * uint32_t( CullMode::Count );
+// Cull mode + cull mode count * multisampled
+constexpr uint32_t DepthPermutationCount = 2 * uint32_t( CullMode::Count );
+// Textured | cull mode << 1, depth testing and writing are always on
+constexpr uint32_t GBufferPermutationCount = 2 * uint32_t( CullMode::Count );
+// Textured | shader << 1, then 2 * shader count * cull mode, depth testing and writing are always on
+constexpr uint32_t VisibilityPermutationCount = 2 * uint32_t( Shader::Count ) * uint32_t( CullMode::Count );
+// Depth tested | cull mode << 1
+constexpr uint32_t WireframePermutationCount = 2 * uint32_t( CullMode::Count );
+
+// The hot loops of the renderer, compiled once per instruction set
+struct Kernels
+{
+	SimdLevel level;
+
+	void( *fill )( uint32_t* destination, const uint32_t& value, const size_t& count );
+	// Same, but with streaming stores, for big areas that nothing is going to read soon
+	void( *fillStream )( uint32_t* destination, const uint32_t& value, const size_t& count );
+	// Clears the tiles in one row of tiles that are still pending, with streaming stores, rows can go in parallel
+	void( *clearTileRow )( const ClearParameters& parameters, const uint32_t& tileY );
+	// Runs a whole mesh through the shaders and rasterizes it, one function per pipeline state
+	DrawFunction* const* draw;
+	// Only the depth
+	DrawFunction* const* drawDepth;
+	// Same, but into the G-buffer instead of the colour buffer
+	DrawFunction* const* drawGBuffer;
+	// Lights one screen tile of the G-buffer, tiles can go in parallel
+	void( *shadeDeferredTile )( const DeferredParameters& parameters, const uint32_t& tileX, const uint32_t& tileY );
+	// Only puts down depth and triangle IDs, the vertex outputs are kept for the resolve
+	DrawFunction* const* drawVisibility;
+	// Rebuilds the varyings of every pixel in one screen tile from its triangle, then runs the pixel shader on them
+	void( *resolveVisibilityTile )( const VisibilityParameters& parameters, const uint32_t& tileX, const uint32_t& tileY );
+	// Averages the samples of one row of screen tiles, and clears the ones that are still pending, rows can go in parallel
+	void( *resolveSamplesRow )( const ResolveParameters& parameters, const uint32_t& tileY );
+	// Anti-aliased lines in the draw's colour, straight into the colour buffer, indexed by whether they're depth tested
+	LineFunction* const* drawLine;
+	// The edges of all of a mesh's triangles that aren't culled
+	DrawFunction* const* drawWireframe;
+	// The same, split up so it can go in parallel, see Rasterizer::DrawHiddenLines
+	// First the vertex outputs, a range at a time, then the triangles get sorted into bands, indexed by cull mode
+	void( *shadeHiddenLineVertices )( const DrawParameters& parameters, const uint32_t& first, const uint32_t& count );
+	HiddenLineBinFunction* const* binHiddenLines;
+	// Then per band, their depth, indexed by cull mode, and after the depth of all draws, their edges
+	HiddenLineBandFunction* const* drawHiddenLineDepth;
+	HiddenLineBandFunction* drawHiddenLineEdges;
+	// FXAA in two passes over rows of tiles, all rows of the first have to be done before the second starts, since
+	// that reads the luma the first leaves in the colour buffer's alpha, across the rows
+	void( *fxaaLumaRow )( const FxaaParameters& parameters, const uint32_t& tileY );
+	void( *fxaaRow )( const FxaaParameters& parameters, const uint32_t& tileY );
+	// Over the rows of tiles of the target
+	void( *upscaleRow )( const UpscaleParameters& parameters, const uint32_t& tileY );
+};
+
+// The best level that both the CPU and the OS support
+SimdLevel DetectSimdLevel();
+
+const char* GetSimdLevelName( const SimdLevel& level );
+// False if there's no such level
+bool ParseSimdLevel( const char* name, SimdLevel& outLevel );
+
+// Switches to the kernels for this level, or the best ones below it that this CPU can run
+// Nothing may be rendering while this happens
+void SelectKernels( const SimdLevel& level );
+
+// Until SelectKernels is called, the best ones for this CPU
+const Kernels& GetKernels();
+
+// One per KernelsXXX.cpp, null if the compiler wasn't told to use that instruction set
+const Kernels* GetKernelsSse2();
+const Kernels* GetKernelsAvx2();
+const Kernels* GetKernelsAvx512();
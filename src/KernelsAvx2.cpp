@@ -0,0 +1,18 @@
+
+// Compiled with AVX2 and FMA enabled, see CMakeLists.txt
+// Only picked at runtime if the CPU has them
+#if defined( __AVX2__ )
+#include "KernelsImpl.hpp"
+#else
+#include "Kernels.hpp"
+#endif
+
+const Kernels* GetKernelsAvx2()
+{
+#if defined( __AVX2__ )
+	return &kernels;
+#else
+	// Not an x86 build, or a compiler that wasn't given the flags
+	return nullptr;
+#endif
+}
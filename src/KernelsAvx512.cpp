@@ -0,0 +1,18 @@
+
+// Compiled with AVX-512 F, BW, DQ and VL enabled, see CMakeLists.txt
+// Only picked at runtime if the CPU has them
+#if defined( __AVX512F__ )
+#include "KernelsImpl.hpp"
+#else
+#include "Kernels.hpp"
+#endif
+
+const Kernels* GetKernelsAvx512()
+{
+#if defined( __AVX512F__ )
+	return &kernels;
+#else
+	// Not an x86 build, or a compiler that wasn't given the flags
+	return nullptr;
+#endif
+}
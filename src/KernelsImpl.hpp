@@ -0,0 +1,2116 @@
+
+#pragma once
+
+// Only for the KernelsXXX.cpp files, each of which compiles all of this for its own instruction set
+// No glm and no standard library in here, see Kernels.hpp
+
+#include <math.h>
+#include <string.h>
+
+#include "Kernels.hpp"
+#include "Shaders.hpp"
+#include "Simd.hpp"
+
+namespace THE_SIMD_NAMESPACE
+{
+namespace
+{
+#if THE_AVX512
+	constexpr SimdLevel KernelLevel = SimdLevel::Avx512;
+#elif THE_AVX2
+	constexpr SimdLevel KernelLevel = SimdLevel::Avx2;
+#else
+	constexpr SimdLevel KernelLevel = SimdLevel::Sse2;
+#endif
+
+	static_assert( TileSize % BlockWidth == 0, "Tiles have to be made of whole blocks" );
+	static_assert( FramebufferPadding % BlockWidth == 0, "Blocks at the right edge have to fit into the padding" );
+
+	template<typename T>
+	inline T MinScalar( const T& a, const T& b )
+	{
+		return a < b ? a : b;
+	}
+
+	template<typename T>
+	inline T MaxScalar( const T& a, const T& b )
+	{
+		return a > b ? a : b;
+	}
+
+	template<typename T>
+	inline T ClampScalar( const T& value, const T& minimum, const T& maximum )
+	{
+		return MinScalar( MaxScalar( value, minimum ), maximum );
+	}
+
+	template<bool Stream>
+	void FillPackets( uint32_t* destination, const uint32_t& value, const size_t& count )
+	{
+		size_t i = 0;
+		// Up to the first packet-aligned spot
+		while ( i < count && (reinterpret_cast<uintptr_t>( destination + i ) % sizeof( IntPacket )) != 0 )
+		{
+			destination[i++] = value;
+		}
+
+		const IntPacket packet( value );
+		for ( ; i + PacketWidth <= count; i += PacketWidth )
+		{
+			if ( Stream )
+			{
+				packet.StoreStream( destination + i );
+			}
+			else
+			{
+				packet.Store( destination + i );
+			}
+		}
+
+		for ( ; i < count; i++ )
+		{
+			destination[i] = value;
+		}
+	}
+
+	void Fill( uint32_t* destination, const uint32_t& value, const size_t& count )
+	{
+		FillPackets<false>( destination, value, count );
+	}
+
+	void FillStream( uint32_t* destination, const uint32_t& value, const size_t& count )
+	{
+		FillPackets<true>( destination, value, count );
+		StreamFence();
+	}
+
+	// Row by row, a tile's rows are far apart
+	template<bool Stream>
+	void FillTile( uint32_t* buffer, const uint32_t& value, const uint32_t& pitch, const uint32_t& minX, const uint32_t& minY,
+		const uint32_t& maxX, const uint32_t& maxY )
+	{
+		for ( uint32_t y = minY; y < maxY; y++ )
+		{
+			FillPackets<Stream>( buffer + size_t( y ) * pitch + minX, value, maxX - minX );
+		}
+	}
+
+	constexpr uint32_t MaxClearBuffers = 4 + 2 * MultisampleCount;
+
+	// The buffers the clear goes over and what they get filled with, returns how many
+	uint32_t GetClearBuffers( const ClearParameters& parameters, const bool& depth, uint32_t** outBuffers, uint32_t* outValues )
+	{
+		uint32_t count = 0;
+		const auto add = [&]( uint32_t* buffer, const uint32_t& value )
+		{
+			if ( buffer != nullptr )
+			{
+				outBuffers[count] = buffer;
+				outValues[count++] = value;
+			}
+		};
+
+		add( parameters.colorBuffer, parameters.color );
+		if ( depth )
+		{
+			add( reinterpret_cast<uint32_t*>( parameters.depthBuffer ), 0 );
+		}
+		add( parameters.albedoBuffer, 0 );
+		add( parameters.visibilityBuffer, 0 );
+		// Sample depth is never kept, only the single-sampled paths go over every pixel at the end of a frame
+		if ( parameters.colorSamples != nullptr )
+		{
+			for ( uint32_t sample = 0; sample < MultisampleCount; sample++ )
+			{
+				add( parameters.colorSamples + sample * parameters.sampleStride, parameters.color );
+				add( reinterpret_cast<uint32_t*>( parameters.depthSamples + sample * parameters.sampleStride ), 0 );
+			}
+		}
+		return count;
+	}
+
+	void ClearTile( const ClearParameters& parameters, const uint32_t& tileX, const uint32_t& tileY, const bool& stream )
+	{
+		uint8_t& pending = parameters.pendingTiles[tileY * parameters.tilesX + tileX];
+		if ( !pending )
+		{
+			return;
+		}
+
+		// When it's streaming, nothing will draw into the tile, and its depth has to be cleared for the frames after
+		uint32_t* buffers[MaxClearBuffers];
+		uint32_t values[MaxClearBuffers];
+		const uint32_t bufferCount = GetClearBuffers( parameters, stream || !parameters.keepDepth, buffers, values );
+
+		const uint32_t minX = tileX * TileSize;
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxX = MinScalar( minX + TileSize, parameters.pitch );
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.paddedHeight );
+		const auto fill = stream ? &FillTile<true> : &FillTile<false>;
+		for ( uint32_t i = 0; i < bufferCount; i++ )
+		{
+			fill( buffers[i], values[i], parameters.pitch, minX, minY, maxX, maxY );
+		}
+		if ( stream )
+		{
+			StreamFence();
+		}
+
+		pending = 0;
+	}
+
+	// Pending tiles next to each other make up longer spans, a whole row of them is one block of memory
+	void ClearTileRow( const ClearParameters& parameters, const uint32_t& tileY )
+	{
+		uint8_t* const pending = parameters.pendingTiles + tileY * parameters.tilesX;
+		uint32_t* buffers[MaxClearBuffers];
+		uint32_t values[MaxClearBuffers];
+		const uint32_t bufferCount = GetClearBuffers( parameters, true, buffers, values );
+
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.paddedHeight );
+		const uint32_t pitch = parameters.pitch;
+
+		for ( uint32_t first = 0; first < parameters.tilesX; )
+		{
+			if ( !pending[first] )
+			{
+				first++;
+				continue;
+			}
+
+			uint32_t last = first;
+			while ( last + 1 < parameters.tilesX && pending[last + 1] )
+			{
+				last++;
+			}
+
+			const uint32_t minX = first * TileSize;
+			const uint32_t maxX = MinScalar( (last + 1) * TileSize, pitch );
+			for ( uint32_t i = 0; i < bufferCount; i++ )
+			{
+				if ( minX == 0 && maxX == pitch )
+				{
+					FillPackets<true>( buffers[i] + size_t( minY ) * pitch, values[i], size_t( maxY - minY ) * pitch );
+				}
+				else
+				{
+					FillTile<true>( buffers[i], values[i], pitch, minX, minY, maxX, maxY );
+				}
+			}
+
+			for ( uint32_t tile = first; tile <= last; tile++ )
+			{
+				pending[tile] = 0;
+			}
+			first = last + 1;
+		}
+
+		StreamFence();
+	}
+
+	// Turns count vertices' worth of interleaved attributes into one packet per component
+	// Lanes past count are zeroed
+	template<int Components>
+	void LoadAttribute( const float* attributes, const uint32_t& first, const uint32_t& count, FloatPacket* outPackets )
+	{
+		alignas( 64 ) float lanes[Components][PacketWidth];
+		const float* source = attributes + size_t( first ) * Components;
+		// Whole packets without a branch per lane, that's nearly all of them
+		if ( count == uint32_t( PacketWidth ) )
+		{
+			for ( int lane = 0; lane < PacketWidth; lane++ )
+			{
+				for ( int component = 0; component < Components; component++ )
+				{
+					lanes[component][lane] = source[lane * Components + component];
+				}
+			}
+		}
+		else
+		{
+			for ( uint32_t lane = 0; lane < uint32_t( PacketWidth ); lane++ )
+			{
+				for ( int component = 0; component < Components; component++ )
+				{
+					lanes[component][lane] = lane < count ? source[lane * Components + component] : 0.0f;
+				}
+			}
+		}
+
+		for ( int component = 0; component < Components; component++ )
+		{
+			outPackets[component] = FloatPacket::Load( lanes[component] );
+		}
+	}
+
+	// Runs every vertex through the vertex shader once, no matter how many triangles share it
+	// Each vertex ends up as its clip-space position followed by its varyings
+	// Only the ones from begin up to end, so ranges of them can go in parallel
+	template<typename VertexShader>
+	void ShadeVertices( const DrawParameters& parameters, const uint32_t& begin, const uint32_t& end )
+	{
+		constexpr int Stride = 4 + VertexShader::VaryingCount;
+		const VertexShader shader( parameters );
+
+		for ( uint32_t first = begin; first < end; first += PacketWidth )
+		{
+			const uint32_t count = MinScalar( end - first, uint32_t( PacketWidth ) );
+
+			VertexInput input;
+			LoadAttribute<3>( parameters.positions, first, count, input.position );
+			if ( VertexShader::UsesNormals )
+			{
+				LoadAttribute<3>( parameters.normals, first, count, input.normal );
+			}
+			if ( VertexShader::UsesTexCoords )
+			{
+				LoadAttribute<2>( parameters.texCoords, first, count, input.texCoord );
+			}
+
+			VertexOutput output;
+			shader( input, output );
+
+			alignas( 64 ) float lanes[Stride][PacketWidth];
+			for ( int component = 0; component < 4; component++ )
+			{
+				output.position[component].Store( lanes[component] );
+			}
+			for ( int component = 0; component < VertexShader::VaryingCount; component++ )
+			{
+				output.varyings[component].Store( lanes[4 + component] );
+			}
+
+			float* outputs = parameters.vertexOutputs + size_t( first ) * Stride;
+			for ( uint32_t lane = 0; lane < count; lane++ )
+			{
+				for ( int component = 0; component < Stride; component++ )
+				{
+					outputs[lane * Stride + component] = lanes[component][lane];
+				}
+			}
+		}
+	}
+
+	// A vertex in clip space, with the varyings that get clipped along with it
+	struct ClipVertex
+	{
+		float position[4];
+		float varyings[MaxVaryings];
+	};
+
+	// A vertex after the perspective divide, varyings are pre-divided by w so they can be
+	// interpolated linearly in screen space and then corrected per pixel
+	// 1 / w is linear in screen space too, and it's also what goes into the depth buffer
+	struct ScreenVertex
+	{
+		float x;
+		float y;
+		float invW;
+		float varyings[MaxVaryings];
+	};
+
+	// a*x + b*y + c, positive on the inner side of the edge
+	struct Edge
+	{
+		Edge( const ScreenVertex& from, const ScreenVertex& to )
+			: a( from.y - to.y ), b( to.x - from.x ), c( -(a * from.x + b * from.y) ),
+			// Pixel centres exactly on an edge belong to the triangle only if it's a top or a left edge,
+			// so triangles sharing an edge never both draw the same pixel
+			topLeft( MaskPacket::FromBool( a > 0.0f || (a == 0.0f && b > 0.0f) ) )
+		{
+		}
+
+		float Evaluate( const float& x, const float& y ) const
+		{
+			return a * x + b * y + c;
+		}
+
+		float a;
+		float b;
+		float c;
+		MaskPacket topLeft;
+	};
+
+	constexpr uint32_t MaxClippedVertices = 4;
+
+	// Sutherland-Hodgman against the near plane (z > -w) only
+	// The other planes are left to the screen-space bounding box, so a triangle never turns into more than 2
+	template<int VaryingCount>
+	uint32_t ClipNear( const ClipVertex* in, ClipVertex* out )
+	{
+		uint32_t count = 0;
+		for ( uint32_t i = 0; i < 3; i++ )
+		{
+			const ClipVertex& current = in[i];
+			const ClipVertex& next = in[(i + 1) % 3];
+			const float currentDistance = current.position[2] + current.position[3];
+			const float nextDistance = next.position[2] + next.position[3];
+
+			if ( currentDistance >= 0.0f )
+			{
+				out[count++] = current;
+			}
+
+			if ( (currentDistance >= 0.0f) != (nextDistance >= 0.0f) )
+			{
+				const float t = currentDistance / (currentDistance - nextDistance);
+				ClipVertex& vertex = out[count++];
+				for ( int j = 0; j < 4; j++ )
+				{
+					vertex.position[j] = current.position[j] + (next.position[j] - current.position[j]) * t;
+				}
+				for ( int j = 0; j < VaryingCount; j++ )
+				{
+					vertex.varyings[j] = current.varyings[j] + (next.varyings[j] - current.varyings[j]) * t;
+				}
+			}
+		}
+
+		return count;
+	}
+
+	// Bit per clip plane the point is outside of
+	uint32_t GetOutcode( const float* position )
+	{
+		const float w = position[3];
+		return (position[0] < -w ? 1 : 0) | (position[0] > w ? 2 : 0)
+			| (position[1] < -w ? 4 : 0) | (position[1] > w ? 8 : 0)
+			| (position[2] < -w ? 16 : 0) | (position[2] > w ? 32 : 0);
+	}
+
+	// Where a pixel's samples are, relative to its centre, the usual rotated grid
+	// None of them are further than SampleReach from it on either axis
+	constexpr float SampleOffsets[MultisampleCount][2]{ { -0.125f, -0.375f }, { 0.375f, -0.125f }, { -0.375f, 0.125f }, { 0.125f, 0.375f } };
+	constexpr float SampleReach = 0.375f;
+
+	// Which pixels of a block a triangle covers and passed the depth test, and with which of their samples
+	// Single-sampled, the one sample is the pixel centre
+	template<int SampleCount>
+	struct Coverage
+	{
+		MaskPacket pixels;
+		MaskPacket samples[SampleCount];
+	};
+
+	// Where the pixel shader's results go, for a block of pixels at upper and lower, offsets into the buffers
+	// Pixels and samples outside the coverage must be left alone
+	template<bool Blend>
+	struct ColorOutput
+	{
+		template<typename PixelShader, int SampleCount>
+		static void Write( const DrawParameters& parameters, const PixelShader& shader, const PixelInput& input,
+			const Coverage<SampleCount>& coverage, const size_t& upper, const size_t& lower )
+		{
+			FloatPacket r, g, b, a;
+			shader( input, r, g, b, a );
+
+			// The pixel shader only runs once, every covered sample gets the same colour
+			const IntPacket color = PackColor( r, g, b, a );
+			const auto writeBlock = [&]( uint32_t* colorUpper, uint32_t* colorLower, const MaskPacket& mask )
+			{
+				const IntPacket old = IntPacket::LoadBlock( colorUpper, colorLower );
+				if ( Blend )
+				{
+					const FloatPacket one( 1.0f );
+					FloatPacket oldR, oldG, oldB, oldA;
+					UnpackColor( old, oldR, oldG, oldB, oldA );
+					Select( mask, old, PackColor( oldR + (r - oldR) * a, oldG + (g - oldG) * a, oldB + (b - oldB) * a,
+						a + oldA * (one - a) ) ).StoreBlock( colorUpper, colorLower );
+				}
+				else
+				{
+					Select( mask, old, color ).StoreBlock( colorUpper, colorLower );
+				}
+			};
+
+			if ( SampleCount == 1 )
+			{
+				writeBlock( parameters.colorBuffer + upper, parameters.colorBuffer + lower, coverage.pixels );
+				return;
+			}
+
+			for ( int sample = 0; sample < SampleCount; sample++ )
+			{
+				if ( coverage.samples[sample].Any() )
+				{
+					uint32_t* const samples = parameters.colorSamples + sample * parameters.sampleStride;
+					writeBlock( samples + upper, samples + lower, coverage.samples[sample] );
+				}
+			}
+		}
+	};
+
+	// The normal into one buffer, the surface colour and the material ID in its top byte into the other
+	struct GBufferOutput
+	{
+		template<typename PixelShader>
+		static void Write( const DrawParameters& parameters, const PixelShader& shader, const PixelInput& input,
+			const Coverage<1>& coverage, const size_t& upper, const size_t& lower )
+		{
+			const MaskPacket& mask = coverage.pixels;
+			FloatPacket normal[3];
+			FloatPacket r, g, b;
+			shader( input, normal, r, g, b );
+
+			uint32_t* const normalUpper = parameters.normalBuffer + upper;
+			uint32_t* const normalLower = parameters.normalBuffer + lower;
+			Select( mask, IntPacket::LoadBlock( normalUpper, normalLower ), PackNormal( normal ) ).StoreBlock( normalUpper, normalLower );
+
+			uint32_t* const albedoUpper = parameters.albedoBuffer + upper;
+			uint32_t* const albedoLower = parameters.albedoBuffer + lower;
+			const IntPacket albedo = PackColor( r, g, b, FloatPacket( 0.0f ) ) | IntPacket( uint32_t( parameters.materialId ) << 24 );
+			Select( mask, IntPacket::LoadBlock( albedoUpper, albedoLower ), albedo ).StoreBlock( albedoUpper, albedoLower );
+		}
+	};
+
+	// Nothing at all, the depth has been written already
+	struct DepthOutput
+	{
+		template<typename PixelShader, int SampleCount>
+		static void Write( const DrawParameters&, const PixelShader&, const PixelInput&, const Coverage<SampleCount>&, const size_t&, const size_t& )
+		{
+		}
+	};
+
+	// Just the triangle's ID, the pixel shader doesn't run
+	struct VisibilityOutput
+	{
+		template<typename PixelShader>
+		static void Write( const DrawParameters& parameters, const PixelShader&, const PixelInput& input,
+			const Coverage<1>& coverage, const size_t& upper, const size_t& lower )
+		{
+			const MaskPacket& mask = coverage.pixels;
+			uint32_t* const visibilityUpper = parameters.visibilityBuffer + upper;
+			uint32_t* const visibilityLower = parameters.visibilityBuffer + lower;
+			const IntPacket id( parameters.visibilityId + input.triangle );
+			Select( mask, IntPacket::LoadBlock( visibilityUpper, visibilityLower ), id ).StoreBlock( visibilityUpper, visibilityLower );
+		}
+	};
+
+	// Multisampled, coverage and depth are per sample, but the pixel shader still runs once per pixel,
+	// with the varyings at the pixel centre
+	// Only rows minRow to maxRow get drawn into, minRow has to be even, so bands of rows can go in parallel, as long
+	// as there are no pending clears, which go by whole tiles
+	template<typename PixelShader, typename Output, DepthTest Test, bool DepthWrite, int SampleCount>
+	void RasterizeTriangle( const DrawParameters& parameters, const PixelShader& shader, const uint32_t& triangle,
+		const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, const int& minRow, const int& maxRow )
+	{
+		constexpr int VaryingCount = PixelShader::VaryingCount;
+
+		const Edge edges[3]{ { v1, v2 }, { v2, v0 }, { v0, v1 } };
+		const float area = edges[2].Evaluate( v2.x, v2.y );
+		const float invArea = 1.0f / area;
+
+		// The edge functions are linear, so at each sample they're the pixel centre's plus a constant
+		FloatPacket sampleSteps[3][SampleCount];
+		for ( int i = 0; i < 3; i++ )
+		{
+			for ( int sample = 0; sample < SampleCount; sample++ )
+			{
+				sampleSteps[i][sample] = SampleCount > 1
+					? FloatPacket( edges[i].a * SampleOffsets[sample][0] + edges[i].b * SampleOffsets[sample][1] ) : FloatPacket( 0.0f );
+			}
+		}
+		const float sampleReach = SampleCount > 1 ? SampleReach : 0.0f;
+
+		// Clamped while still floats, since vertices close to the near plane can be very far off screen
+		// Blocks start on multiples of their width
+		const float right = parameters.width - 1.0f;
+		const float bottom = parameters.height - 1.0f;
+		const int minX = int( ClampScalar( MinScalar( v0.x, MinScalar( v1.x, v2.x ) ), 0.0f, right ) ) / BlockWidth * BlockWidth;
+		const int minY = MaxScalar( int( ClampScalar( MinScalar( v0.y, MinScalar( v1.y, v2.y ) ), 0.0f, bottom ) ) & ~1, minRow );
+		const int maxX = int( ClampScalar( MaxScalar( v0.x, MaxScalar( v1.x, v2.x ) ), -1.0f, right ) );
+		const int maxY = MinScalar( int( ClampScalar( MaxScalar( v0.y, MaxScalar( v1.y, v2.y ) ), -1.0f, bottom ) ), maxRow );
+		if ( minX > maxX || minY > maxY )
+		{
+			return;
+		}
+
+		// Everything gets interpolated as base + w1 * delta1 + w2 * delta2, with w1 and w2 the
+		// barycentric weights of v1 and v2
+		const FloatPacket depthSign( parameters.depthSign );
+		const FloatPacket w0( v0.invW ), dw1( v1.invW - v0.invW ), dw2( v2.invW - v0.invW );
+		FloatPacket varying0[MaxVaryings], varyingDelta1[MaxVaryings], varyingDelta2[MaxVaryings];
+		for ( int i = 0; i < VaryingCount; i++ )
+		{
+			varying0[i] = FloatPacket( v0.varyings[i] );
+			varyingDelta1[i] = FloatPacket( v1.varyings[i] - v0.varyings[i] );
+			varyingDelta2[i] = FloatPacket( v2.varyings[i] - v0.varyings[i] );
+		}
+
+		const FloatPacket one( 1.0f );
+		const FloatPacket zero( 0.0f );
+
+		// Pixel centres of a block, relative to its top-left pixel
+		alignas( 64 ) float offsetsX[PacketWidth];
+		alignas( 64 ) float offsetsY[PacketWidth];
+		for ( int lane = 0; lane < PacketWidth; lane++ )
+		{
+			offsetsX[lane] = (lane % BlockWidth) + 0.5f;
+			offsetsY[lane] = (lane / BlockWidth) + 0.5f;
+		}
+		const FloatPacket blockX = FloatPacket::Load( offsetsX );
+		const FloatPacket blockY = FloatPacket::Load( offsetsY );
+
+		const uint32_t pitch = parameters.pitch;
+
+		// Tile by tile, so the pixels being worked on stay in cache and tiles that the triangle
+		// doesn't touch are skipped as a whole
+		const int firstTileX = minX / TileSize;
+		const int firstTileY = minY / TileSize;
+		const int lastTileX = maxX / TileSize;
+		const int lastTileY = maxY / TileSize;
+
+		for ( int tileY = firstTileY; tileY <= lastTileY; tileY++ )
+		{
+			const int tileMinY = MaxScalar( tileY * int( TileSize ), minY );
+			const int tileMaxY = MinScalar( (tileY + 1) * int( TileSize ) - 1, maxY );
+
+			for ( int tileX = firstTileX; tileX <= lastTileX; tileX++ )
+			{
+				const int tileMinX = MaxScalar( tileX * int( TileSize ), minX );
+				const int tileMaxX = MinScalar( (tileX + 1) * int( TileSize ) - 1, maxX );
+
+				// If the tile's most inner sample is outside of any edge, so is the whole tile
+				bool outside = false;
+				for ( const Edge& edge : edges )
+				{
+					const float x = edge.a > 0.0f ? tileMaxX + 0.5f + sampleReach : tileMinX + 0.5f - sampleReach;
+					const float y = edge.b > 0.0f ? tileMaxY + 0.5f + sampleReach : tileMinY + 0.5f - sampleReach;
+					if ( edge.Evaluate( x, y ) < 0.0f )
+					{
+						outside = true;
+						break;
+					}
+				}
+				if ( outside )
+				{
+					continue;
+				}
+
+				if ( parameters.pendingClear != nullptr )
+				{
+					ClearTile( *parameters.pendingClear, tileX, tileY, false );
+				}
+
+				for ( int y = tileMinY; y <= tileMaxY; y += 2 )
+				{
+					const FloatPacket pixelY = FloatPacket( float( y ) ) + blockY;
+					const FloatPacket pixelX = FloatPacket( float( tileMinX ) ) + blockX;
+					FloatPacket e0 = FloatPacket( edges[0].a ) * pixelX + FloatPacket( edges[0].b ) * pixelY + FloatPacket( edges[0].c );
+					FloatPacket e1 = FloatPacket( edges[1].a ) * pixelX + FloatPacket( edges[1].b ) * pixelY + FloatPacket( edges[1].c );
+					FloatPacket e2 = FloatPacket( edges[2].a ) * pixelX + FloatPacket( edges[2].b ) * pixelY + FloatPacket( edges[2].c );
+					const FloatPacket step0( edges[0].a * BlockWidth ), step1( edges[1].a * BlockWidth ), step2( edges[2].a * BlockWidth );
+
+					const size_t upperRow = size_t( y ) * pitch;
+					const size_t lowerRow = upperRow + pitch;
+					float* const depthUpper = parameters.depthBuffer + size_t( y ) * pitch;
+					float* const depthLower = depthUpper + pitch;
+
+					for ( int x = tileMinX; x <= tileMaxX; x += BlockWidth, e0 = e0 + step0, e1 = e1 + step1, e2 = e2 + step2 )
+					{
+						Coverage<SampleCount> coverage;
+						FloatPacket sampleE1[SampleCount], sampleE2[SampleCount];
+						for ( int sample = 0; sample < SampleCount; sample++ )
+						{
+							const FloatPacket s0 = SampleCount > 1 ? e0 + sampleSteps[0][sample] : e0;
+							sampleE1[sample] = SampleCount > 1 ? e1 + sampleSteps[1][sample] : e1;
+							sampleE2[sample] = SampleCount > 1 ? e2 + sampleSteps[2][sample] : e2;
+							const FloatPacket& s1 = sampleE1[sample];
+							const FloatPacket& s2 = sampleE2[sample];
+							coverage.samples[sample] = ((s0 > zero) | ((s0 == zero) & edges[0].topLeft))
+								& ((s1 > zero) | ((s1 == zero) & edges[1].topLeft))
+								& ((s2 > zero) | ((s2 == zero) & edges[2].topLeft));
+							coverage.pixels = sample == 0 ? coverage.samples[0] : coverage.pixels | coverage.samples[sample];
+						}
+						if ( !coverage.pixels.Any() )
+						{
+							continue;
+						}
+
+						const FloatPacket w1 = e1 * FloatPacket( invArea );
+						const FloatPacket w2 = e2 * FloatPacket( invArea );
+						const FloatPacket invW = w0 + w1 * dw1 + w2 * dw2;
+
+						// Depth first, so hidden pixels never get to the pixel shader
+						// With the sign flipped, nearer is smaller, and whatever the last frame left is bigger than anything
+						if ( Test != DepthTest::Off || DepthWrite )
+						{
+							for ( int sample = 0; sample < SampleCount; sample++ )
+							{
+								MaskPacket& mask = coverage.samples[sample];
+								if ( SampleCount > 1 && !mask.Any() )
+								{
+									continue;
+								}
+
+								float* const upper = SampleCount > 1 ? parameters.depthSamples + sample * parameters.sampleStride + upperRow + x : depthUpper + x;
+								float* const lower = SampleCount > 1 ? parameters.depthSamples + sample * parameters.sampleStride + lowerRow + x : depthLower + x;
+								const FloatPacket sampleInvW = SampleCount > 1
+									? w0 + sampleE1[sample] * FloatPacket( invArea ) * dw1 + sampleE2[sample] * FloatPacket( invArea ) * dw2 : invW;
+								const FloatPacket z = sampleInvW * depthSign;
+								const FloatPacket depth = FloatPacket::LoadBlock( upper, lower );
+								if ( Test != DepthTest::Off )
+								{
+									mask = mask & (Test == DepthTest::Equal ? z == depth : sampleInvW > depth * depthSign);
+								}
+								if ( DepthWrite && mask.Any() )
+								{
+									Select( mask, depth, z ).StoreBlock( upper, lower );
+								}
+							}
+
+							if ( Test != DepthTest::Off )
+							{
+								coverage.pixels = coverage.samples[0];
+								for ( int sample = 1; sample < SampleCount; sample++ )
+								{
+									coverage.pixels = coverage.pixels | coverage.samples[sample];
+								}
+								if ( !coverage.pixels.Any() )
+								{
+									continue;
+								}
+							}
+						}
+
+						PixelInput input;
+						input.tileX = tileX;
+						input.tileY = tileY;
+						input.triangle = triangle;
+						if ( VaryingCount > 0 )
+						{
+							// Undo the divide by w
+							const FloatPacket w = one / invW;
+							for ( int i = 0; i < VaryingCount; i++ )
+							{
+								input.varyings[i] = (varying0[i] + w1 * varyingDelta1[i] + w2 * varyingDelta2[i]) * w;
+							}
+						}
+
+						Output::Write( parameters, shader, input, coverage, upperRow + x, lowerRow + x );
+					}
+				}
+			}
+		}
+	}
+
+	// The perspective divide and the viewport transform
+	template<int VaryingCount>
+	inline ScreenVertex ProjectVertex( const ClipVertex& vertex, const float& halfWidth, const float& halfHeight )
+	{
+		ScreenVertex result;
+		result.invW = 1.0f / vertex.position[3];
+		result.x = (vertex.position[0] * result.invW + 1.0f) * halfWidth;
+		result.y = (1.0f - vertex.position[1] * result.invW) * halfHeight;
+		for ( int i = 0; i < VaryingCount; i++ )
+		{
+			result.varyings[i] = vertex.varyings[i] * result.invW;
+		}
+		return result;
+	}
+
+	// Leaves out triangles without any area and the ones the cull mode doesn't want, then rasterizes the
+	// rest with the winding the edge functions want
+	template<typename PixelShader, typename Output, DepthTest Test, bool DepthWrite, CullMode Cull, int SampleCount>
+	inline void CullAndRasterize( const DrawParameters& parameters, const PixelShader& shader, const uint32_t& triangle,
+		const ScreenVertex& first, ScreenVertex second, ScreenVertex third, const int& minRow, const int& maxRow )
+	{
+		// Y points down on screen, which flips the winding
+		const float area = (second.x - first.x) * (third.y - first.y) - (third.x - first.x) * (second.y - first.y);
+		const bool frontFacing = area < 0.0f;
+		if ( area == 0.0f || (Cull == CullMode::Back && !frontFacing) || (Cull == CullMode::Front && frontFacing) )
+		{
+			return;
+		}
+
+		if ( area < 0.0f )
+		{
+			const ScreenVertex swapped = second;
+			second = third;
+			third = swapped;
+		}
+
+		RasterizeTriangle<PixelShader, Output, Test, DepthWrite, SampleCount>( parameters, shader, triangle, first, second, third, minRow, maxRow );
+	}
+
+	// The whole pipeline for one mesh, with the shaders and the pipeline state baked in
+	template<typename VertexShader, typename PixelShader, typename Output, DepthTest Test, bool DepthWrite, CullMode Cull, int SampleCount>
+	void DrawMesh( const DrawParameters& parameters )
+	{
+		// The pixel shader may leave off varyings at the end, those only get written out for later
+		static_assert( PixelShader::VaryingCount <= VertexShader::VaryingCount, "The shaders have to agree on their varyings" );
+		static_assert( VertexShader::VaryingCount <= int( MaxVaryings ), "Too many varyings" );
+		constexpr int VaryingCount = PixelShader::VaryingCount;
+		constexpr int Stride = 4 + VertexShader::VaryingCount;
+
+		ShadeVertices<VertexShader>( parameters, 0, parameters.vertexCount );
+		const PixelShader shader( parameters );
+
+		const float halfWidth = parameters.width * 0.5f;
+		const float halfHeight = parameters.height * 0.5f;
+		const int lastRow = int( parameters.height ) - 1;
+
+		for ( uint32_t triangle = 0; triangle < parameters.triangleCount; triangle++ )
+		{
+			const uint32_t* corners = &parameters.indices[triangle * 3];
+
+			ClipVertex clipVertices[3];
+			uint32_t outcodes[3];
+			for ( int i = 0; i < 3; i++ )
+			{
+				const float* vertex = &parameters.vertexOutputs[size_t( corners[i] ) * Stride];
+				for ( int j = 0; j < 4; j++ )
+				{
+					clipVertices[i].position[j] = vertex[j];
+				}
+				outcodes[i] = GetOutcode( vertex );
+			}
+
+			// All 3 corners are outside of the same plane
+			if ( outcodes[0] & outcodes[1] & outcodes[2] )
+			{
+				continue;
+			}
+
+			for ( int i = 0; i < 3; i++ )
+			{
+				const float* varyings = &parameters.vertexOutputs[size_t( corners[i] ) * Stride + 4];
+				for ( int j = 0; j < VaryingCount; j++ )
+				{
+					clipVertices[i].varyings[j] = varyings[j];
+				}
+			}
+
+			ClipVertex clipped[MaxClippedVertices];
+			uint32_t clippedCount = 3;
+			if ( (outcodes[0] | outcodes[1] | outcodes[2]) & 16 )
+			{
+				clippedCount = ClipNear<VaryingCount>( clipVertices, clipped );
+			}
+			else
+			{
+				clipped[0] = clipVertices[0];
+				clipped[1] = clipVertices[1];
+				clipped[2] = clipVertices[2];
+			}
+
+			// A fan, the clipped polygon is still convex
+			const ScreenVertex first = ProjectVertex<VaryingCount>( clipped[0], halfWidth, halfHeight );
+			for ( uint32_t i = 2; i < clippedCount; i++ )
+			{
+				CullAndRasterize<PixelShader, Output, Test, DepthWrite, Cull, SampleCount>( parameters, shader, triangle, first,
+					ProjectVertex<VaryingCount>( clipped[i - 1], halfWidth, halfHeight ), ProjectVertex<VaryingCount>( clipped[i], halfWidth, halfHeight ),
+					0, lastRow );
+			}
+		}
+	}
+
+	// Spans of fewer steps than this go one pixel at a time, dense meshes have lots of lines that short
+	constexpr int ScalarLineSteps = 8;
+
+	// Same as the spans below, for a single pixel, in 8-bit fixed point, two channels at a time
+	// color is the line's colour with an alpha of 255, blending towards that is also what the spans do with the alpha
+	template<bool DepthTested>
+	inline void BlendLinePixel( const DrawParameters& parameters, const uint32_t& offset, const uint32_t& color, const float& weight, const float& invW )
+	{
+		if ( DepthTested && invW * (1.0f + parameters.lineDepthBias) < parameters.depthBuffer[offset] * parameters.depthSign )
+		{
+			return;
+		}
+
+		const uint32_t amount = uint32_t( weight * 256.0f + 0.5f );
+		const uint32_t old = parameters.colorBuffer[offset];
+		const uint32_t redBlue = ((old & 0xFF00FF) * (256 - amount) + (color & 0xFF00FF) * amount) >> 8;
+		const uint32_t alphaGreen = (((old >> 8) & 0xFF00FF) * (256 - amount) + ((color >> 8) & 0xFF00FF) * amount) >> 8;
+		parameters.colorBuffer[offset] = (redBlue & 0xFF00FF) | ((alphaGreen & 0xFF00FF) << 8);
+	}
+
+	// Xiaolin Wu's anti-aliased lines: each step along the major axis covers the two pixels the line passes
+	// between, weighted by how close it passes to each, and the steps at the ends by how much of them the line covers
+	// The steps go PacketWidth at a time, only the loads and stores of the pixels they land on are one by one
+	// Lines only show where they're no further than the depth buffer, when they're depth tested
+	// Only rows minRow to maxRow get drawn into, same as for RasterizeTriangle
+	template<bool DepthTested>
+	void RasterizeLine( const DrawParameters& parameters, const ScreenVertex& v0, const ScreenVertex& v1, const int& minRow, const int& maxRow )
+	{
+		// A pixel's worth of slack around the screen, the pixels there get masked out below
+		float t0 = 0.0f;
+		float t1 = 1.0f;
+		const float delta[2]{ v1.x - v0.x, v1.y - v0.y };
+		const float start[2]{ v0.x, v0.y };
+		const float limits[2]{ float( parameters.width ) + 1.0f, float( parameters.height ) + 1.0f };
+		const auto inside = [&limits]( const ScreenVertex& vertex )
+		{
+			return vertex.x >= -1.0f && vertex.x <= limits[0] && vertex.y >= -1.0f && vertex.y <= limits[1];
+		};
+		for ( int axis = 0; axis < 2 && !(inside( v0 ) && inside( v1 )); axis++ )
+		{
+			// Liang-Barsky, against -1 and the limit
+			const float p[2]{ -delta[axis], delta[axis] };
+			const float q[2]{ start[axis] + 1.0f, limits[axis] - start[axis] };
+			for ( int side = 0; side < 2; side++ )
+			{
+				if ( p[side] == 0.0f )
+				{
+					if ( q[side] < 0.0f )
+					{
+						return;
+					}
+					continue;
+				}
+
+				const float t = q[side] / p[side];
+				if ( p[side] < 0.0f )
+				{
+					t0 = MaxScalar( t0, t );
+				}
+				else
+				{
+					t1 = MinScalar( t1, t );
+				}
+			}
+		}
+		if ( t0 >= t1 )
+		{
+			return;
+		}
+
+		// Major and minor axis, so steep lines go down the rows the same way flat ones go along the columns
+		const bool steep = fabsf( delta[1] ) > fabsf( delta[0] );
+		const int major = steep ? 1 : 0;
+		const int minor = 1 - major;
+		float from[3]{ v0.x + delta[0] * t0, v0.y + delta[1] * t0, v0.invW + (v1.invW - v0.invW) * t0 };
+		float to[3]{ v0.x + delta[0] * t1, v0.y + delta[1] * t1, v0.invW + (v1.invW - v0.invW) * t1 };
+		if ( from[major] > to[major] )
+		{
+			for ( int i = 0; i < 3; i++ )
+			{
+				const float swapped = from[i];
+				from[i] = to[i];
+				to[i] = swapped;
+			}
+		}
+
+		const float length = to[major] - from[major];
+		if ( length <= 0.0f )
+		{
+			return;
+		}
+
+		// 1 / w is linear in screen space, like for triangles
+		const float invLength = 1.0f / length;
+		const float slope = (to[minor] - from[minor]) * invLength;
+		const float depthSlope = (to[2] - from[2]) * invLength;
+		const int majorCount = int( steep ? parameters.height : parameters.width );
+		const int minorCount = int( steep ? parameters.width : parameters.height );
+		const int first = MaxScalar( int( floorf( from[major] ) ), 0 );
+		const int last = MinScalar( int( floorf( to[major] ) ), majorCount - 1 );
+
+		// The steps that can land in those rows, a step further out either way for rounding
+		// The spans still start where they would for all of the rows, so every pixel comes out the same either way
+		int lowStep = first;
+		int highStep = last;
+		if ( steep )
+		{
+			lowStep = MaxScalar( lowStep, minRow );
+			highStep = MinScalar( highStep, maxRow );
+		}
+		else if ( minRow > 0 || maxRow < minorCount - 1 )
+		{
+			if ( slope == 0.0f )
+			{
+				const int lowerRow = int( floorf( from[minor] - 0.5f ) );
+				if ( lowerRow < minRow - 1 || lowerRow > maxRow )
+				{
+					return;
+				}
+			}
+			else
+			{
+				// Where the line is a row above and below them
+				const float above = (float( minRow ) - 0.5f - from[minor]) / slope;
+				const float below = (float( maxRow ) + 1.5f - from[minor]) / slope;
+				const float low = ClampScalar( from[major] - 0.5f + MinScalar( above, below ), float( first ), float( last ) );
+				const float high = ClampScalar( from[major] - 0.5f + MaxScalar( above, below ), float( first ), float( last ) );
+				lowStep = MaxScalar( lowStep, int( floorf( low ) ) - 1 );
+				highStep = MinScalar( highStep, int( ceilf( high ) ) + 1 );
+			}
+		}
+		const int totalSteps = last - first + 1;
+		const int spanEnd = totalSteps >= ScalarLineSteps ? first + ((totalSteps - ScalarLineSteps) / PacketWidth + 1) * PacketWidth : first;
+
+		const uint32_t pitch = parameters.pitch;
+		const uint32_t opaqueColor = 0xFF000000 | (uint32_t( ClampScalar( parameters.color[0], 0.0f, 1.0f ) * 255.0f + 0.5f ) << 16)
+			| (uint32_t( ClampScalar( parameters.color[1], 0.0f, 1.0f ) * 255.0f + 0.5f ) << 8)
+			| uint32_t( ClampScalar( parameters.color[2], 0.0f, 1.0f ) * 255.0f + 0.5f );
+
+		// Most lines of dense meshes are too short for any spans, those don't set any of this up
+		if ( spanEnd > first )
+		{
+			const FloatPacket zero( 0.0f );
+			const FloatPacket one( 1.0f );
+			const FloatPacket half( 0.5f );
+			const FloatPacket r( parameters.color[0] ), g( parameters.color[1] ), b( parameters.color[2] ), alpha( parameters.color[3] );
+			const FloatPacket depthSign( parameters.depthSign );
+			const FloatPacket depthBias( 1.0f + parameters.lineDepthBias );
+
+			alignas( 64 ) float laneOffsets[PacketWidth];
+			for ( int lane = 0; lane < PacketWidth; lane++ )
+			{
+				laneOffsets[lane] = float( lane );
+			}
+			const FloatPacket laneOffset = FloatPacket::Load( laneOffsets );
+
+			for ( int step = first + MaxScalar( lowStep - first, 0 ) / PacketWidth * PacketWidth; step < spanEnd && step <= highStep; step += PacketWidth )
+			{
+				const FloatPacket centre = FloatPacket( float( step ) + 0.5f ) + laneOffset;
+				const FloatPacket along = centre - FloatPacket( from[major] );
+				// How much of the step the line covers, only less than 1 at its ends
+				const FloatPacket coverage = Max( Min( Min( centre + half, FloatPacket( to[major] ) ) - Max( centre - half, FloatPacket( from[major] ) ), one ), zero ) * alpha;
+				const FloatPacket position = FloatPacket( from[minor] ) + along * FloatPacket( slope ) - half;
+				const FloatPacket lowerPixel = Floor( position );
+				const FloatPacket fraction = position - lowerPixel;
+				const FloatPacket invW = FloatPacket( from[2] ) + along * FloatPacket( depthSlope );
+
+				alignas( 64 ) int32_t pixels[PacketWidth];
+				ToInt( lowerPixel ).Store( reinterpret_cast<uint32_t*>( pixels ) );
+				const int stepCount = MinScalar( last - step + 1, PacketWidth );
+
+				// The tiles the two pixels of every step land in get their pending clear first
+				if ( parameters.pendingClear != nullptr )
+				{
+					int minMinor = pixels[0];
+					int maxMinor = pixels[0];
+					for ( int lane = 1; lane < stepCount; lane++ )
+					{
+						minMinor = MinScalar( minMinor, pixels[lane] );
+						maxMinor = MaxScalar( maxMinor, pixels[lane] );
+					}
+					minMinor = MaxScalar( minMinor, steep ? 0 : minRow );
+					maxMinor = MinScalar( maxMinor + 1, steep ? minorCount - 1 : maxRow );
+					const int minMajor = steep ? MaxScalar( step, minRow ) : step;
+					const int maxMajor = steep ? MinScalar( step + stepCount - 1, maxRow ) : step + stepCount - 1;
+					const int minTile[2]{ minMajor / int( TileSize ), minMinor / int( TileSize ) };
+					const int maxTile[2]{ maxMajor / int( TileSize ), maxMinor / int( TileSize ) };
+					for ( int tileMinor = minTile[1]; tileMinor <= maxTile[1]; tileMinor++ )
+					{
+						for ( int tileMajor = minTile[0]; tileMajor <= maxTile[0]; tileMajor++ )
+						{
+							ClearTile( *parameters.pendingClear, steep ? tileMinor : tileMajor, steep ? tileMajor : tileMinor, false );
+						}
+					}
+				}
+
+				// Each step's two pixels, by hand, they're all over the place
+				for ( int side = 0; side < 2; side++ )
+				{
+					alignas( 64 ) uint32_t offsets[PacketWidth];
+					alignas( 64 ) uint32_t oldColors[PacketWidth];
+					alignas( 64 ) float depths[PacketWidth];
+					alignas( 64 ) float valid[PacketWidth];
+					for ( int lane = 0; lane < PacketWidth; lane++ )
+					{
+						const int minorPixel = pixels[lane] + side;
+						const int row = steep ? step + lane : minorPixel;
+						const bool inside = lane < stepCount && minorPixel >= 0 && minorPixel < minorCount && row >= minRow && row <= maxRow;
+						const uint32_t column = uint32_t( steep ? minorPixel : step + lane );
+						offsets[lane] = inside ? uint32_t( row ) * pitch + column : 0;
+						oldColors[lane] = parameters.colorBuffer[offsets[lane]];
+						depths[lane] = DepthTested ? parameters.depthBuffer[offsets[lane]] : 0.0f;
+						valid[lane] = inside ? 1.0f : 0.0f;
+					}
+
+					MaskPacket mask = FloatPacket::Load( valid ) > zero;
+					if ( DepthTested )
+					{
+						mask = mask & (invW * depthBias >= FloatPacket::Load( depths ) * depthSign);
+					}
+					if ( !mask.Any() )
+					{
+						continue;
+					}
+
+					const FloatPacket weight = side == 0 ? coverage * (one - fraction) : coverage * fraction;
+					const IntPacket old = IntPacket::Load( oldColors );
+					FloatPacket oldR, oldG, oldB, oldA;
+					UnpackColor( old, oldR, oldG, oldB, oldA );
+					const IntPacket blended = PackColor( oldR + (r - oldR) * weight, oldG + (g - oldG) * weight, oldB + (b - oldB) * weight,
+						weight + oldA * (one - weight) );
+					alignas( 64 ) uint32_t colors[PacketWidth];
+					Select( mask, old, blended ).Store( colors );
+
+					const int bits = mask.GetBits();
+					for ( int lane = 0; lane < stepCount; lane++ )
+					{
+						if ( bits & (1 << lane) )
+						{
+							parameters.colorBuffer[offsets[lane]] = colors[lane];
+						}
+					}
+				}
+			}
+		}
+
+		// What's left is too short for a span
+		uint32_t clearedTile = ~0U;
+		for ( int step = MaxScalar( spanEnd, lowStep ); step <= highStep; step++ )
+		{
+			const float centre = float( step ) + 0.5f;
+			const float along = centre - from[major];
+			const float weight = ClampScalar( MinScalar( centre + 0.5f, to[major] ) - MaxScalar( centre - 0.5f, from[major] ), 0.0f, 1.0f )
+				* parameters.color[3];
+			const float position = from[minor] + along * slope - 0.5f;
+			const float lowerPixel = floorf( position );
+			const float fraction = position - lowerPixel;
+			const float invW = from[2] + along * depthSlope;
+			for ( int side = 0; side < 2; side++ )
+			{
+				const int minorPixel = int( lowerPixel ) + side;
+				const uint32_t column = uint32_t( steep ? minorPixel : step );
+				const uint32_t row = uint32_t( steep ? step : minorPixel );
+				if ( minorPixel < 0 || minorPixel >= minorCount || int( row ) < minRow || int( row ) > maxRow )
+				{
+					continue;
+				}
+
+				// Lines mostly stay in the same tile for a while
+				const uint32_t tile = (row / TileSize) << 16 | column / TileSize;
+				if ( parameters.pendingClear != nullptr && tile != clearedTile )
+				{
+					ClearTile( *parameters.pendingClear, column / TileSize, row / TileSize, false );
+					clearedTile = tile;
+				}
+				BlendLinePixel<DepthTested>( parameters, row * pitch + column, opaqueColor, side == 0 ? weight * (1.0f - fraction) : weight * fraction, invW );
+			}
+		}
+	}
+
+	// A line between two points in clip space, clipped against the near plane
+	template<bool DepthTested>
+	void DrawLine( const DrawParameters& parameters, const float* from, const float* to, const int& minRow, const int& maxRow )
+	{
+		if ( GetOutcode( from ) & GetOutcode( to ) )
+		{
+			return;
+		}
+
+		float clipped[2][4];
+		const float fromDistance = from[2] + from[3];
+		const float toDistance = to[2] + to[3];
+		for ( int i = 0; i < 4; i++ )
+		{
+			clipped[0][i] = from[i];
+			clipped[1][i] = to[i];
+		}
+		if ( (fromDistance < 0.0f) != (toDistance < 0.0f) )
+		{
+			const float t = fromDistance / (fromDistance - toDistance);
+			float* const outside = fromDistance < 0.0f ? clipped[0] : clipped[1];
+			for ( int i = 0; i < 4; i++ )
+			{
+				outside[i] = from[i] + (to[i] - from[i]) * t;
+			}
+		}
+
+		ScreenVertex ends[2];
+		for ( int i = 0; i < 2; i++ )
+		{
+			ends[i].invW = 1.0f / clipped[i][3];
+			ends[i].x = (clipped[i][0] * ends[i].invW + 1.0f) * parameters.width * 0.5f;
+			ends[i].y = (1.0f - clipped[i][1] * ends[i].invW) * parameters.height * 0.5f;
+		}
+
+		RasterizeLine<DepthTested>( parameters, ends[0], ends[1], minRow, maxRow );
+	}
+
+	// Every triangle's edges, the ones triangles share get drawn twice
+	// Culled the same way as the triangles would be, which for closed meshes leaves the edges that can be seen
+	template<bool DepthTested, CullMode Cull>
+	void DrawWireframe( const DrawParameters& parameters )
+	{
+		ShadeVertices<WireframeVertexShader>( parameters, 0, parameters.vertexCount );
+
+		constexpr int Stride = 4 + WireframeVertexShader::VaryingCount;
+		const int lastRow = int( parameters.height ) - 1;
+		for ( uint32_t triangle = 0; triangle < parameters.triangleCount; triangle++ )
+		{
+			const uint32_t* corners = &parameters.indices[triangle * 3];
+			const float* vertices[3];
+			uint32_t outcodes[3];
+			for ( int i = 0; i < 3; i++ )
+			{
+				vertices[i] = &parameters.vertexOutputs[size_t( corners[i] ) * Stride];
+				outcodes[i] = uint32_t( vertices[i][7] );
+			}
+			if ( outcodes[0] & outcodes[1] & outcodes[2] )
+			{
+				continue;
+			}
+
+			// Through the near plane, the edges need clipping, and which way it faces is anyone's guess
+			if ( (outcodes[0] | outcodes[1] | outcodes[2]) & 16 )
+			{
+				for ( int i = 0; i < 3; i++ )
+				{
+					DrawLine<DepthTested>( parameters, vertices[i], vertices[(i + 1) % 3], 0, lastRow );
+				}
+				continue;
+			}
+
+			ScreenVertex screen[3];
+			for ( int i = 0; i < 3; i++ )
+			{
+				screen[i].x = vertices[i][4];
+				screen[i].y = vertices[i][5];
+				screen[i].invW = vertices[i][6];
+			}
+
+			const float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+			const bool frontFacing = area < 0.0f;
+			if ( (Cull == CullMode::Back && !frontFacing) || (Cull == CullMode::Front && frontFacing) )
+			{
+				continue;
+			}
+
+			for ( int i = 0; i < 3; i++ )
+			{
+				RasterizeLine<DepthTested>( parameters, screen[i], screen[(i + 1) % 3], 0, lastRow );
+			}
+		}
+	}
+
+	// Hidden-line draws, see Rasterizer::DrawHiddenLines
+	// The same vertex outputs as DrawWireframe's, a range at a time
+	void ShadeHiddenLineVertices( const DrawParameters& parameters, const uint32_t& first, const uint32_t& count )
+	{
+		ShadeVertices<WireframeVertexShader>( parameters, first, first + count );
+	}
+
+	// Leaves out the triangles that DrawWireframe would, and notes down the bands the others reach into
+	// Their edges are anti-aliased, so that's a couple of pixels past their bounds, or all of the rows if they go
+	// through the near plane
+	template<CullMode Cull>
+	uint32_t BinHiddenLines( const DrawParameters& parameters, const uint32_t* triangles, const uint32_t& count, HiddenLineTriangle* outTriangles )
+	{
+		constexpr int Stride = 4 + WireframeVertexShader::VaryingCount;
+		const int lastRow = int( parameters.height ) - 1;
+		const float slack = 8.0f;
+
+		uint32_t binned = 0;
+		for ( uint32_t i = 0; i < count; i++ )
+		{
+			const uint32_t triangle = triangles[i];
+			const uint32_t* corners = &parameters.indices[triangle * 3];
+			const float* vertices[3];
+			uint32_t outcodes[3];
+			for ( int j = 0; j < 3; j++ )
+			{
+				vertices[j] = &parameters.vertexOutputs[size_t( corners[j] ) * Stride];
+				outcodes[j] = uint32_t( vertices[j][7] );
+			}
+			if ( outcodes[0] & outcodes[1] & outcodes[2] )
+			{
+				continue;
+			}
+
+			HiddenLineTriangle& out = outTriangles[binned];
+			if ( (outcodes[0] | outcodes[1] | outcodes[2]) & 16 )
+			{
+				out.triangle = triangle;
+				out.firstBand = 0;
+				out.lastBand = uint16_t( lastRow / int( HiddenLineBandHeight ) );
+				binned++;
+				continue;
+			}
+
+			const float x[3]{ vertices[0][4], vertices[1][4], vertices[2][4] };
+			const float y[3]{ vertices[0][5], vertices[1][5], vertices[2][5] };
+			const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			const bool frontFacing = area < 0.0f;
+			if ( (Cull == CullMode::Back && !frontFacing) || (Cull == CullMode::Front && frontFacing) )
+			{
+				continue;
+			}
+
+			// Clamped while still floats, like RasterizeTriangle does
+			const float minX = MinScalar( x[0], MinScalar( x[1], x[2] ) );
+			const float maxX = MaxScalar( x[0], MaxScalar( x[1], x[2] ) );
+			const float minY = ClampScalar( MinScalar( y[0], MinScalar( y[1], y[2] ) ), -slack, lastRow + slack );
+			const float maxY = ClampScalar( MaxScalar( y[0], MaxScalar( y[1], y[2] ) ), -slack, lastRow + slack );
+			const int firstRow = MaxScalar( int( floorf( minY ) ) - 2, 0 );
+			const int endRow = MinScalar( int( floorf( maxY ) ) + 2, lastRow );
+			if ( firstRow > endRow )
+			{
+				continue;
+			}
+
+			// Without a pixel centre in its bounds, or without any area, it doesn't leave any depth behind
+			const bool edgesOnly = area == 0.0f || ceilf( minX - 0.5f ) > floorf( maxX - 0.5f ) || ceilf( minY - 0.5f ) > floorf( maxY - 0.5f );
+			out.triangle = edgesOnly ? triangle | HiddenLineEdgesOnly : triangle;
+			out.firstBand = uint16_t( firstRow / int( HiddenLineBandHeight ) );
+			out.lastBand = uint16_t( endRow / int( HiddenLineBandHeight ) );
+			binned++;
+		}
+
+		return binned;
+	}
+
+	// The depth of triangles that BinHiddenLines put into this band, without touching any other rows
+	template<CullMode Cull>
+	void DrawHiddenLineDepth( const DrawParameters& parameters, const uint32_t* triangles, const uint32_t& count, const uint32_t& band )
+	{
+		constexpr int Stride = 4 + WireframeVertexShader::VaryingCount;
+		const NullPixelShader shader( parameters );
+		const float halfWidth = parameters.width * 0.5f;
+		const float halfHeight = parameters.height * 0.5f;
+		const int minRow = int( band * HiddenLineBandHeight );
+		const int maxRow = MinScalar( minRow + int( HiddenLineBandHeight ), int( parameters.height ) ) - 1;
+
+		for ( uint32_t i = 0; i < count; i++ )
+		{
+			const uint32_t triangle = triangles[i];
+			if ( triangle & HiddenLineEdgesOnly )
+			{
+				continue;
+			}
+
+			const uint32_t* corners = &parameters.indices[triangle * 3];
+			ClipVertex clipVertices[3];
+			ScreenVertex screen[3];
+			uint32_t outcodes = 0;
+			for ( int j = 0; j < 3; j++ )
+			{
+				const float* vertex = &parameters.vertexOutputs[size_t( corners[j] ) * Stride];
+				for ( int k = 0; k < 4; k++ )
+				{
+					clipVertices[j].position[k] = vertex[k];
+				}
+				screen[j].x = vertex[4];
+				screen[j].y = vertex[5];
+				screen[j].invW = vertex[6];
+				outcodes |= uint32_t( vertex[7] );
+			}
+
+			if ( !(outcodes & 16) )
+			{
+				CullAndRasterize<NullPixelShader, DepthOutput, DepthTest::Nearer, true, Cull, 1>( parameters, shader, triangle,
+					screen[0], screen[1], screen[2], minRow, maxRow );
+				continue;
+			}
+
+			ClipVertex clipped[MaxClippedVertices];
+			const uint32_t clippedCount = ClipNear<0>( clipVertices, clipped );
+			const ScreenVertex first = ProjectVertex<0>( clipped[0], halfWidth, halfHeight );
+			for ( uint32_t j = 2; j < clippedCount; j++ )
+			{
+				CullAndRasterize<NullPixelShader, DepthOutput, DepthTest::Nearer, true, Cull, 1>( parameters, shader, triangle, first,
+					ProjectVertex<0>( clipped[j - 1], halfWidth, halfHeight ), ProjectVertex<0>( clipped[j], halfWidth, halfHeight ), minRow, maxRow );
+			}
+		}
+	}
+
+	// Then their edges, depth tested, also only into this band
+	void DrawHiddenLineEdges( const DrawParameters& parameters, const uint32_t* triangles, const uint32_t& count, const uint32_t& band )
+	{
+		constexpr int Stride = 4 + WireframeVertexShader::VaryingCount;
+		const int minRow = int( band * HiddenLineBandHeight );
+		const int maxRow = MinScalar( minRow + int( HiddenLineBandHeight ), int( parameters.height ) ) - 1;
+
+		for ( uint32_t i = 0; i < count; i++ )
+		{
+			const uint32_t* corners = &parameters.indices[(triangles[i] & ~HiddenLineEdgesOnly) * 3];
+			const float* vertices[3];
+			uint32_t outcodes = 0;
+			for ( int j = 0; j < 3; j++ )
+			{
+				vertices[j] = &parameters.vertexOutputs[size_t( corners[j] ) * Stride];
+				outcodes |= uint32_t( vertices[j][7] );
+			}
+
+			if ( outcodes & 16 )
+			{
+				for ( int j = 0; j < 3; j++ )
+				{
+					DrawLine<true>( parameters, vertices[j], vertices[(j + 1) % 3], minRow, maxRow );
+				}
+				continue;
+			}
+
+			ScreenVertex screen[3];
+			for ( int j = 0; j < 3; j++ )
+			{
+				screen[j].x = vertices[j][4];
+				screen[j].y = vertices[j][5];
+				screen[j].invW = vertices[j][6];
+			}
+			for ( int j = 0; j < 3; j++ )
+			{
+				RasterizeLine<true>( parameters, screen[j], screen[(j + 1) % 3], minRow, maxRow );
+			}
+		}
+	}
+
+	// Lights one tile of the G-buffer, block by block, every pixel that has something in it exactly once
+	void ShadeDeferredTile( const DeferredParameters& parameters, const uint32_t& tileX, const uint32_t& tileY )
+	{
+		// Nothing was drawn here, and nothing will read it before it's shown
+		if ( parameters.pendingClear != nullptr && parameters.pendingClear->pendingTiles[tileY * parameters.pendingClear->tilesX + tileX] )
+		{
+			ClearTile( *parameters.pendingClear, tileX, tileY, true );
+			return;
+		}
+
+		const LightingParameters& lighting = *parameters.lighting;
+		const FloatPacket zero( 0.0f );
+		const FloatPacket one( 1.0f );
+		const PacketMatrix inverseViewProj( parameters.inverseViewProj );
+
+		alignas( 64 ) float offsetsX[PacketWidth];
+		alignas( 64 ) float offsetsY[PacketWidth];
+		for ( int lane = 0; lane < PacketWidth; lane++ )
+		{
+			offsetsX[lane] = (lane % BlockWidth) + 0.5f;
+			offsetsY[lane] = (lane / BlockWidth) + 0.5f;
+		}
+		const FloatPacket blockX = FloatPacket::Load( offsetsX );
+		const FloatPacket blockY = FloatPacket::Load( offsetsY );
+		const FloatPacket toNdcX( 2.0f / parameters.width );
+		const FloatPacket toNdcY( -2.0f / parameters.height );
+		const FloatPacket depthSign( parameters.depthSign );
+		const FloatPacket clipZScale( parameters.depthToClipZ[0] );
+		const FloatPacket clipZOffset( parameters.depthToClipZ[1] );
+		const FloatPacket inverseZ[4]{ FloatPacket( parameters.inverseViewProj[8] ), FloatPacket( parameters.inverseViewProj[9] ),
+			FloatPacket( parameters.inverseViewProj[10] ), FloatPacket( parameters.inverseViewProj[11] ) };
+
+		// The buffers are padded, so whole blocks past the right and bottom edges are fine
+		const uint32_t minX = tileX * TileSize;
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxX = MinScalar( minX + TileSize, parameters.width );
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.height );
+		const uint32_t pitch = parameters.pitch;
+
+		for ( uint32_t y = minY; y < maxY; y += 2 )
+		{
+			const size_t upperRow = size_t( y ) * pitch;
+			const size_t lowerRow = upperRow + pitch;
+			const FloatPacket ndcY = (FloatPacket( float( y ) ) + blockY) * toNdcY + one;
+
+			for ( uint32_t x = minX; x < maxX; x += BlockWidth )
+			{
+				const IntPacket albedo = IntPacket::LoadBlock( parameters.albedoBuffer + upperRow + x, parameters.albedoBuffer + lowerRow + x );
+				const IntPacket materialIds = ShiftRight<24>( albedo );
+				const MaskPacket mask = ToFloat( materialIds ) > zero;
+				float* const depthUpper = parameters.depthBuffer + upperRow + x;
+				float* const depthLower = parameters.depthBuffer + lowerRow + x;
+				if ( !mask.Any() )
+				{
+					if ( parameters.clearEmptyDepth )
+					{
+						zero.StoreBlock( depthUpper, depthLower );
+					}
+					continue;
+				}
+
+				const FloatPacket depth = FloatPacket::LoadBlock( depthUpper, depthLower );
+				if ( parameters.clearEmptyDepth )
+				{
+					Select( mask, zero, depth ).StoreBlock( depthUpper, depthLower );
+				}
+
+				// Back into world space through the inverse of the view-projection, the pixel's clip-space
+				// position is (ndc x * w, ndc y * w, z, w), which is w * (ndc x, ndc y, z scale, 1) + (0, 0, z offset, 0),
+				// and the divide by w comes out the same without the first w
+				const FloatPacket invW = depth * depthSign;
+				FloatPacket ray[3];
+				ray[0] = (FloatPacket( float( x ) ) + blockX) * toNdcX - one;
+				ray[1] = ndcY;
+				ray[2] = clipZScale;
+				FloatPacket position[4];
+				inverseViewProj.TransformPoint( ray, position );
+				const FloatPacket offset = clipZOffset * invW;
+				for ( int i = 0; i < 4; i++ )
+				{
+					position[i] = position[i] + inverseZ[i] * offset;
+				}
+				const FloatPacket invPositionW = one / position[3];
+				for ( int i = 0; i < 3; i++ )
+				{
+					position[i] = position[i] * invPositionW;
+				}
+
+				FloatPacket normal[3];
+				UnpackNormal( IntPacket::LoadBlock( parameters.normalBuffer + upperRow + x, parameters.normalBuffer + lowerRow + x ), normal );
+
+				// Neighbouring pixels mostly share a material, but there's no telling, so look them up lane by lane
+				alignas( 64 ) uint32_t ids[PacketWidth];
+				alignas( 64 ) float speculars[PacketWidth];
+				alignas( 64 ) float shininesses[PacketWidth];
+				materialIds.Store( ids );
+				for ( int lane = 0; lane < PacketWidth; lane++ )
+				{
+					const MaterialParameters& material = parameters.materials[ids[lane]];
+					speculars[lane] = material.specular;
+					shininesses[lane] = material.shininess;
+				}
+				const FloatPacket specular = FloatPacket::Load( speculars );
+				const FloatPacket shininess = FloatPacket::Load( shininesses );
+
+				FloatPacket diffuse[3]{ FloatPacket( lighting.ambient[0] ), FloatPacket( lighting.ambient[1] ), FloatPacket( lighting.ambient[2] ) };
+				FloatPacket highlights[3]{ zero, zero, zero };
+				AccumulateTileLights( lighting, tileX, tileY, position, normal, shininess, diffuse, highlights );
+
+				FloatPacket r, g, b, a;
+				UnpackColor( albedo, r, g, b, a );
+				r = r * diffuse[0] + highlights[0] * specular;
+				g = g * diffuse[1] + highlights[1] * specular;
+				b = b * diffuse[2] + highlights[2] * specular;
+
+				uint32_t* const colorUpper = parameters.colorBuffer + upperRow + x;
+				uint32_t* const colorLower = parameters.colorBuffer + lowerRow + x;
+				const IntPacket old = IntPacket::LoadBlock( colorUpper, colorLower );
+				Select( mask, old, PackColor( r, g, b, one ) ).StoreBlock( colorUpper, colorLower );
+			}
+		}
+	}
+
+	// Shades the lanes in mask of a block, with the pixel shader of one of the draw's triangles
+	// The varyings come from the kept vertex outputs, the clip-space x, y and w of the corners make up a matrix
+	// that takes barycentrics to a pixel's (x, y, 1) in normalised device coordinates times its w, so its
+	// inverse gives back perspective-correct barycentrics up to a scale, and the adjugate is all that's needed
+	template<typename Program>
+	void ResolveTriangle( const DrawParameters& draw, const PixelInput& pixel, const FloatPacket& ndcX, const FloatPacket& ndcY,
+		const MaskPacket& mask, const size_t& upper, const size_t& lower )
+	{
+		using PixelShader = typename Program::Pixel;
+		constexpr int Stride = 4 + Program::Vertex::VaryingCount;
+
+		const uint32_t* corners = &draw.indices[pixel.triangle * 3];
+		const float* vertices[3];
+		for ( int i = 0; i < 3; i++ )
+		{
+			vertices[i] = &draw.vertexOutputs[size_t( corners[i] ) * Stride];
+		}
+
+		// Each row of the adjugate is the cross product of the other two corners' (x, y, w)
+		FloatPacket weights[3];
+		for ( int i = 0; i < 3; i++ )
+		{
+			const float* a = vertices[(i + 1) % 3];
+			const float* b = vertices[(i + 2) % 3];
+			weights[i] = FloatPacket( a[1] * b[3] - a[3] * b[1] ) * ndcX + FloatPacket( a[3] * b[0] - a[0] * b[3] ) * ndcY
+				+ FloatPacket( a[0] * b[1] - a[1] * b[0] );
+		}
+		const FloatPacket scale = FloatPacket( 1.0f ) / (weights[0] + weights[1] + weights[2]);
+		for ( int i = 0; i < 3; i++ )
+		{
+			weights[i] = weights[i] * scale;
+		}
+
+		PixelInput input;
+		input.tileX = pixel.tileX;
+		input.tileY = pixel.tileY;
+		input.triangle = pixel.triangle;
+		for ( int i = 0; i < PixelShader::VaryingCount; i++ )
+		{
+			input.varyings[i] = weights[0] * FloatPacket( vertices[0][4 + i] ) + weights[1] * FloatPacket( vertices[1][4 + i] )
+				+ weights[2] * FloatPacket( vertices[2][4 + i] );
+		}
+
+		const PixelShader shader( draw );
+		Coverage<1> coverage;
+		coverage.pixels = mask;
+		coverage.samples[0] = mask;
+		ColorOutput<false>::Write( draw, shader, input, coverage, upper, lower );
+	}
+
+	template<uint32_t Index>
+	struct ResolvePermutation
+	{
+		using Program = ShaderProgram<Shader( Index >> 1 ), (Index & 1) != 0>;
+
+		static void Run( const DrawParameters& draw, const PixelInput& pixel, const FloatPacket& ndcX, const FloatPacket& ndcY,
+			const MaskPacket& mask, const size_t& upper, const size_t& lower )
+		{
+			ResolveTriangle<Program>( draw, pixel, ndcX, ndcY, mask, upper, lower );
+		}
+	};
+
+	// Textured | shader << 1
+	constexpr uint32_t ResolvePermutationCount = 2 * uint32_t( Shader::Count );
+
+	template<uint32_t Index>
+	struct DrawPermutation
+	{
+		static constexpr uint32_t ShaderCount = uint32_t( Shader::Count );
+		static constexpr uint32_t State = Index % DrawStatePermutationCount;
+		static constexpr uint32_t Program = Index / DrawStatePermutationCount;
+		static constexpr DepthTest Test = DepthTest( State % uint32_t( DepthTest::Count ) );
+		static constexpr uint32_t Flags = State / uint32_t( DepthTest::Count );
+		using Shaders = ShaderProgram<Shader( Program % ShaderCount ), (Flags & 4) != 0>;
+
+		static void Run( const DrawParameters& parameters )
+		{
+			// Writing depth that's already there is pointless, so that's one less permutation to compile
+			DrawMesh<typename Shaders::Vertex, typename Shaders::Pixel, ColorOutput<(Flags & 2) != 0>, Test,
+				(Flags & 1) != 0 && Test != DepthTest::Equal, CullMode( Program / ShaderCount ), (Flags & 8) != 0 ? MultisampleCount : 1>( parameters );
+		}
+	};
+
+	template<uint32_t Index>
+	struct DepthPermutation
+	{
+		static void Run( const DrawParameters& parameters )
+		{
+			constexpr uint32_t CullCount = uint32_t( CullMode::Count );
+			DrawMesh<UnlitVertexShader<false>, NullPixelShader, DepthOutput, DepthTest::Nearer, true, CullMode( Index % CullCount ),
+				Index / CullCount != 0 ? MultisampleCount : 1>( parameters );
+		}
+	};
+
+	template<uint32_t Index>
+	struct GBufferPermutation
+	{
+		static void Run( const DrawParameters& parameters )
+		{
+			constexpr bool Textured = (Index & 1) != 0;
+			DrawMesh<GBufferVertexShader<Textured>, GBufferPixelShader<Textured>, GBufferOutput, DepthTest::Nearer, true, CullMode( Index >> 1 ), 1>( parameters );
+		}
+	};
+
+	template<uint32_t Index>
+	struct VisibilityPermutation
+	{
+		static constexpr uint32_t ShaderCount = uint32_t( Shader::Count );
+		using Program = ShaderProgram<Shader( (Index >> 1) % ShaderCount ), (Index & 1) != 0>;
+
+		static void Run( const DrawParameters& parameters )
+		{
+			DrawMesh<typename Program::Vertex, NullPixelShader, VisibilityOutput, DepthTest::Nearer, true, CullMode( (Index >> 1) / ShaderCount ), 1>( parameters );
+		}
+	};
+
+	template<uint32_t Index>
+	struct LinePermutation
+	{
+		static void Run( const DrawParameters& parameters, const float* from, const float* to )
+		{
+			DrawLine<Index != 0>( parameters, from, to, 0, int( parameters.height ) - 1 );
+		}
+	};
+
+	template<uint32_t Index>
+	struct WireframePermutation
+	{
+		static void Run( const DrawParameters& parameters )
+		{
+			DrawWireframe<Index % 2 != 0, CullMode( Index / 2 )>( parameters );
+		}
+	};
+
+	template<uint32_t Index>
+	struct HiddenLineBinPermutation
+	{
+		static uint32_t Run( const DrawParameters& parameters, const uint32_t* triangles, const uint32_t& count, HiddenLineTriangle* outTriangles )
+		{
+			return BinHiddenLines<CullMode( Index )>( parameters, triangles, count, outTriangles );
+		}
+	};
+
+	template<uint32_t Index>
+	struct HiddenLineDepthPermutation
+	{
+		static void Run( const DrawParameters& parameters, const uint32_t* triangles, const uint32_t& count, const uint32_t& band )
+		{
+			DrawHiddenLineDepth<CullMode( Index )>( parameters, triangles, count, band );
+		}
+	};
+
+	// Index sequence by hand, std::make_integer_sequence is off limits in here
+	template<template<uint32_t> class Permutation, uint32_t... Indices>
+	struct PermutationTable
+	{
+		using Function = decltype( Permutation<0>::Run );
+		static constexpr Function* functions[]{ &Permutation<Indices>::Run... };
+	};
+
+	template<template<uint32_t> class Permutation, uint32_t... Indices>
+	constexpr typename PermutationTable<Permutation, Indices...>::Function* PermutationTable<Permutation, Indices...>::functions[];
+
+	template<template<uint32_t> class Permutation, uint32_t Count, uint32_t... Indices>
+	struct MakePermutationTable : MakePermutationTable<Permutation, Count - 1, Count - 1, Indices...>
+	{
+	};
+
+	template<template<uint32_t> class Permutation, uint32_t... Indices>
+	struct MakePermutationTable<Permutation, 0, Indices...>
+	{
+		using Type = PermutationTable<Permutation, Indices...>;
+	};
+
+	// The draw whose IDs id falls into, starting with the one the previous pixel belonged to
+	uint32_t FindVisibilityDraw( const VisibilityParameters& parameters, const uint32_t& id, const uint32_t& previous )
+	{
+		const DrawParameters& cached = parameters.draws[previous];
+		if ( id >= cached.visibilityId && id - cached.visibilityId < cached.triangleCount )
+		{
+			return previous;
+		}
+
+		// The last one that starts at or before id
+		uint32_t first = 0;
+		uint32_t count = parameters.drawCount;
+		while ( count > 1 )
+		{
+			const uint32_t half = count / 2;
+			if ( parameters.draws[first + half].visibilityId <= id )
+			{
+				first += half;
+				count -= half;
+			}
+			else
+			{
+				count = half;
+			}
+		}
+		return first;
+	}
+
+	void ResolveVisibilityTile( const VisibilityParameters& parameters, const uint32_t& tileX, const uint32_t& tileY )
+	{
+		if ( parameters.pendingClear != nullptr && parameters.pendingClear->pendingTiles[tileY * parameters.pendingClear->tilesX + tileX] )
+		{
+			ClearTile( *parameters.pendingClear, tileX, tileY, true );
+			return;
+		}
+
+		if ( parameters.drawCount == 0 )
+		{
+			return;
+		}
+
+		const auto& resolveFunctions = MakePermutationTable<ResolvePermutation, ResolvePermutationCount>::Type::functions;
+		const FloatPacket one( 1.0f );
+
+		alignas( 64 ) float offsetsX[PacketWidth];
+		alignas( 64 ) float offsetsY[PacketWidth];
+		for ( int lane = 0; lane < PacketWidth; lane++ )
+		{
+			offsetsX[lane] = (lane % BlockWidth) + 0.5f;
+			offsetsY[lane] = (lane / BlockWidth) + 0.5f;
+		}
+		const FloatPacket blockX = FloatPacket::Load( offsetsX );
+		const FloatPacket blockY = FloatPacket::Load( offsetsY );
+		const FloatPacket toNdcX( 2.0f / parameters.width );
+		const FloatPacket toNdcY( -2.0f / parameters.height );
+
+		const uint32_t minX = tileX * TileSize;
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxX = MinScalar( minX + TileSize, parameters.width );
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.height );
+		const uint32_t pitch = parameters.pitch;
+
+		PixelInput pixel;
+		pixel.tileX = tileX;
+		pixel.tileY = tileY;
+		uint32_t drawIndex = 0;
+
+		for ( uint32_t y = minY; y < maxY; y += 2 )
+		{
+			const size_t upperRow = size_t( y ) * pitch;
+			const size_t lowerRow = upperRow + pitch;
+			const FloatPacket ndcY = (FloatPacket( float( y ) ) + blockY) * toNdcY + one;
+
+			for ( uint32_t x = minX; x < maxX; x += BlockWidth )
+			{
+				const IntPacket ids = IntPacket::LoadBlock( parameters.visibilityBuffer + upperRow + x, parameters.visibilityBuffer + lowerRow + x );
+				if ( parameters.clearEmptyDepth )
+				{
+					const MaskPacket empty = ids == IntPacket( 0u );
+					if ( empty.Any() )
+					{
+						float* const depthUpper = parameters.depthBuffer + upperRow + x;
+						float* const depthLower = parameters.depthBuffer + lowerRow + x;
+						Select( empty, FloatPacket::LoadBlock( depthUpper, depthLower ), FloatPacket( 0.0f ) ).StoreBlock( depthUpper, depthLower );
+					}
+				}
+
+				alignas( 64 ) uint32_t idLanes[PacketWidth];
+				ids.Store( idLanes );
+				const FloatPacket ndcX = (FloatPacket( float( x ) ) + blockX) * toNdcX - one;
+
+				// A block mostly covers one or two triangles, so shade the whole block once per triangle in it
+				for ( int lane = 0; lane < PacketWidth; lane++ )
+				{
+					const uint32_t id = idLanes[lane];
+					if ( id == 0 )
+					{
+						continue;
+					}
+
+					for ( int other = lane + 1; other < PacketWidth; other++ )
+					{
+						idLanes[other] = idLanes[other] == id ? 0 : idLanes[other];
+					}
+
+					drawIndex = FindVisibilityDraw( parameters, id, drawIndex );
+					const DrawParameters& draw = parameters.draws[drawIndex];
+					pixel.triangle = id - draw.visibilityId;
+					const uint32_t permutation = uint32_t( draw.texture != nullptr ) | uint32_t( draw.shader ) << 1;
+					resolveFunctions[permutation]( draw, pixel, ndcX, ndcY, ids == IntPacket( id ), upperRow + x, lowerRow + x );
+				}
+			}
+		}
+	}
+
+	// Averages each pixel's samples into the colour buffer, a whole row of tiles at a time, since going
+	// through 5 buffers tile by tile leaves the prefetcher behind
+	void ResolveSamplesRow( const ResolveParameters& parameters, const uint32_t& tileY )
+	{
+		// Nothing was drawn into the tiles that are still pending, they only get their clear, at the end
+		const uint32_t tilesX = (parameters.width + TileSize - 1) / TileSize;
+		const uint8_t* const pending = parameters.pendingClear != nullptr ? parameters.pendingClear->pendingTiles + tileY * parameters.pendingClear->tilesX : nullptr;
+
+		const FloatPacket scale( 1.0f / MultisampleCount );
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.height );
+		const uint32_t pitch = parameters.pitch;
+
+		for ( uint32_t y = minY; y < maxY; y += 2 )
+		{
+			const size_t upperRow = size_t( y ) * pitch;
+			const size_t lowerRow = upperRow + pitch;
+
+			for ( uint32_t tileX = 0; tileX < tilesX; tileX++ )
+			{
+				if ( pending != nullptr && pending[tileX] )
+				{
+					continue;
+				}
+
+				const uint32_t maxX = MinScalar( (tileX + 1) * TileSize, parameters.width );
+				for ( uint32_t x = tileX * TileSize; x < maxX; x += BlockWidth )
+				{
+					IntPacket samples[MultisampleCount];
+					MaskPacket same = MaskPacket::FromBool( true );
+					for ( uint32_t sample = 0; sample < MultisampleCount; sample++ )
+					{
+						const uint32_t* const plane = parameters.colorSamples + sample * parameters.sampleStride;
+						samples[sample] = IntPacket::LoadBlock( plane + upperRow + x, plane + lowerRow + x );
+						same = same & (samples[sample] == samples[0]);
+					}
+
+					// Away from the edges, all samples of a pixel are the same
+					if ( same.GetBits() == (1 << PacketWidth) - 1 )
+					{
+						samples[0].StoreBlock( parameters.colorBuffer + upperRow + x, parameters.colorBuffer + lowerRow + x );
+						continue;
+					}
+
+					FloatPacket r, g, b, a;
+					UnpackColor( samples[0], r, g, b, a );
+					for ( uint32_t sample = 1; sample < MultisampleCount; sample++ )
+					{
+						FloatPacket sampleR, sampleG, sampleB, sampleA;
+						UnpackColor( samples[sample], sampleR, sampleG, sampleB, sampleA );
+						r = r + sampleR;
+						g = g + sampleG;
+						b = b + sampleB;
+						a = a + sampleA;
+					}
+
+					PackColor( r * scale, g * scale, b * scale, a * scale ).StoreBlock( parameters.colorBuffer + upperRow + x, parameters.colorBuffer + lowerRow + x );
+				}
+			}
+		}
+
+		if ( parameters.pendingClear != nullptr )
+		{
+			ClearTileRow( *parameters.pendingClear, tileY );
+		}
+	}
+
+	// Luma for FXAA, perceptual weights on the colour as it's displayed, 0 to 255
+	FloatPacket GetLuma( const IntPacket& color )
+	{
+		const IntPacket mask( 0xFF );
+		return ToFloat( ShiftRight<16>( color ) & mask ) * FloatPacket( 0.299f ) + ToFloat( ShiftRight<8>( color ) & mask ) * FloatPacket( 0.587f )
+			+ ToFloat( color & mask ) * FloatPacket( 0.114f );
+	}
+
+	void FxaaLumaRow( const FxaaParameters& parameters, const uint32_t& tileY )
+	{
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.height );
+		const uint32_t pitch = parameters.pitch;
+		const IntPacket colorMask( 0x00FFFFFF );
+		const FloatPacket half( 0.5f );
+
+		for ( uint32_t y = minY; y < maxY; y += 2 )
+		{
+			uint32_t* const upper = parameters.colorBuffer + size_t( y ) * pitch;
+			uint32_t* const lower = upper + pitch;
+			for ( uint32_t x = 0; x < parameters.width; x += BlockWidth )
+			{
+				const IntPacket color = IntPacket::LoadBlock( upper + x, lower + x );
+				((color & colorMask) | ShiftLeft<24>( ToInt( GetLuma( color ) + half ) )).StoreBlock( upper + x, lower + x );
+			}
+		}
+	}
+
+	// Tuned like FXAA 3.11's quality presets: how much contrast makes an edge, relative to the brightest
+	// neighbour and at the least, in luma from 0 to 255, and how much of the sub-pixel aliasing gets smoothed
+	constexpr float FxaaEdgeThreshold = 0.125f;
+	constexpr float FxaaEdgeThresholdMin = 0.0625f * 255.0f;
+	constexpr float FxaaSubpixelQuality = 0.75f;
+	// How far each step of the search for the ends of an edge goes, in pixels, further the longer it gets
+	constexpr float FxaaSearchSteps[]{ 1.0f, 1.0f, 1.0f, 1.0f, 2.0f, 2.0f, 4.0f, 8.0f };
+
+	// FXAA 3.11 on a block of pixels: where the contrast to the neighbours is high, it finds which way the
+	// edge goes and how far along it the pixel is from where the edge ends, then blends the pixel with its
+	// neighbour across the edge, the more the closer it is to an end
+	// Lanes that aren't on an edge go along with the rest, masked, the search stops once every lane found its ends
+	// The result is opaque, what was in the alpha doesn't survive
+	void FxaaRow( const FxaaParameters& parameters, const uint32_t& tileY )
+	{
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.height );
+		const uint32_t pitch = parameters.pitch;
+		const uint32_t* const source = parameters.colorBuffer;
+
+		const FloatPacket zero( 0.0f );
+		const FloatPacket one( 1.0f );
+		const FloatPacket half( 0.5f );
+		const FloatPacket lastX( float( parameters.width - 1 ) );
+		const FloatPacket lastY( float( parameters.height - 1 ) );
+		const IntPacket opaque( 0xFF000000 );
+
+		alignas( 64 ) float blockX[PacketWidth];
+		alignas( 64 ) float blockY[PacketWidth];
+		for ( int lane = 0; lane < PacketWidth; lane++ )
+		{
+			blockX[lane] = float( lane % BlockWidth );
+			blockY[lane] = float( lane / BlockWidth );
+		}
+
+		const auto absolute = [&zero]( const FloatPacket& value )
+		{
+			return Max( value, zero - value );
+		};
+
+		for ( uint32_t y = minY; y < maxY; y += 2 )
+		{
+			const FloatPacket laneY = FloatPacket( float( y ) ) + FloatPacket::Load( blockY );
+			const size_t upperRow = size_t( y ) * pitch;
+			const size_t lowerRow = upperRow + pitch;
+
+			for ( uint32_t x = 0; x < parameters.width; x += BlockWidth )
+			{
+				const FloatPacket laneX = FloatPacket( float( x ) ) + FloatPacket::Load( blockX );
+
+				// Clamped to the screen, anywhere
+				const auto gather = [&]( const FloatPacket& sampleX, const FloatPacket& sampleY )
+				{
+					return Gather( source, ToInt( Min( Max( sampleX, zero ), lastX ) ), ToInt( Min( Max( sampleY, zero ), lastY ) ), pitch );
+				};
+				// Straight loads for the neighbours, unless the block is at the edge of the screen
+				const bool inside = x > 0 && x + BlockWidth < parameters.width && y > 0 && y + 2 < parameters.height;
+				const auto neighbour = [&]( const int& dx, const int& dy )
+				{
+					if ( inside )
+					{
+						const ptrdiff_t offset = ptrdiff_t( x ) + dx + ptrdiff_t( dy ) * ptrdiff_t( pitch );
+						return IntPacket::LoadBlock( source + upperRow + offset, source + lowerRow + offset );
+					}
+					return gather( laneX + FloatPacket( float( dx ) ), laneY + FloatPacket( float( dy ) ) );
+				};
+				const auto luma = []( const IntPacket& color )
+				{
+					return ToFloat( ShiftRight<24>( color ) );
+				};
+
+				const IntPacket colorM = neighbour( 0, 0 );
+				const IntPacket colorN = neighbour( 0, -1 );
+				const IntPacket colorS = neighbour( 0, 1 );
+				const IntPacket colorW = neighbour( -1, 0 );
+				const IntPacket colorE = neighbour( 1, 0 );
+				const FloatPacket lumaM = luma( colorM );
+				const FloatPacket lumaN = luma( colorN );
+				const FloatPacket lumaS = luma( colorS );
+				const FloatPacket lumaW = luma( colorW );
+				const FloatPacket lumaE = luma( colorE );
+
+				const FloatPacket lumaMax = Max( Max( lumaM, Max( lumaN, lumaS ) ), Max( lumaW, lumaE ) );
+				const FloatPacket range = lumaMax - Min( Min( lumaM, Min( lumaN, lumaS ) ), Min( lumaW, lumaE ) );
+				const MaskPacket edge = range >= Max( FloatPacket( FxaaEdgeThresholdMin ), lumaMax * FloatPacket( FxaaEdgeThreshold ) );
+				if ( !edge.Any() )
+				{
+					(colorM | opaque).StoreBlock( parameters.outputBuffer + upperRow + x, parameters.outputBuffer + lowerRow + x );
+					continue;
+				}
+
+				const FloatPacket lumaNW = luma( neighbour( -1, -1 ) );
+				const FloatPacket lumaNE = luma( neighbour( 1, -1 ) );
+				const FloatPacket lumaSW = luma( neighbour( -1, 1 ) );
+				const FloatPacket lumaSE = luma( neighbour( 1, 1 ) );
+
+				// Which way the edge goes, from the second derivatives across the 3x3 neighbourhood
+				const FloatPacket two( 2.0f );
+				const FloatPacket edgeHorizontal = absolute( lumaNW + lumaSW - two * lumaW ) + two * absolute( lumaN + lumaS - two * lumaM ) + absolute( lumaNE + lumaSE - two * lumaE );
+				const FloatPacket edgeVertical = absolute( lumaNW + lumaNE - two * lumaN ) + two * absolute( lumaW + lumaE - two * lumaM ) + absolute( lumaSW + lumaSE - two * lumaS );
+				const MaskPacket horizontal = edgeHorizontal >= edgeVertical;
+
+				// Sub-pixel aliasing, how much the pixel sticks out from its surroundings
+				const FloatPacket lumaAverage = ((lumaN + lumaS + lumaW + lumaE) * two + lumaNW + lumaNE + lumaSW + lumaSE) * FloatPacket( 1.0f / 12.0f );
+				const FloatPacket subpixel = Min( absolute( lumaAverage - lumaM ) / Max( range, one ), one );
+				const FloatPacket subpixelSmooth = (FloatPacket( 3.0f ) - two * subpixel) * subpixel * subpixel;
+				const FloatPacket subpixelOffset = subpixelSmooth * subpixelSmooth * FloatPacket( FxaaSubpixelQuality );
+
+				// The side of the pixel the edge is on, the one with the bigger gradient
+				const FloatPacket lumaNegative = Select( horizontal, lumaW, lumaN );
+				const FloatPacket lumaPositive = Select( horizontal, lumaE, lumaS );
+				const FloatPacket gradientNegative = absolute( lumaNegative - lumaM );
+				const FloatPacket gradientPositive = absolute( lumaPositive - lumaM );
+				const MaskPacket negativeSide = gradientNegative >= gradientPositive;
+				const FloatPacket gradientScaled = Max( gradientNegative, gradientPositive ) * FloatPacket( 0.25f );
+				const FloatPacket lumaEdge = (Select( negativeSide, lumaPositive, lumaNegative ) + lumaM) * half;
+				const FloatPacket across = Select( negativeSide, one, zero - one );
+
+				// Along the edge, one way and the other, until the luma of the pixel pairs straddling it stops
+				// matching the edge's
+				const FloatPacket alongX = Select( horizontal, zero, one );
+				const FloatPacket alongY = Select( horizontal, one, zero );
+				const FloatPacket acrossX = Select( horizontal, across, zero );
+				const FloatPacket acrossY = Select( horizontal, zero, across );
+				const auto lumaAlong = [&]( const FloatPacket& distance )
+				{
+					const FloatPacket sampleX = laneX + alongX * distance;
+					const FloatPacket sampleY = laneY + alongY * distance;
+					return (luma( gather( sampleX, sampleY ) ) + luma( gather( sampleX + acrossX, sampleY + acrossY ) )) * half - lumaEdge;
+				};
+
+				FloatPacket distanceNegative = zero;
+				FloatPacket distancePositive = zero;
+				FloatPacket lumaEndNegative = zero;
+				FloatPacket lumaEndPositive = zero;
+				MaskPacket doneNegative = MaskPacket::FromBool( true ).AndNot( edge );
+				MaskPacket donePositive = doneNegative;
+				for ( const float& step : FxaaSearchSteps )
+				{
+					const FloatPacket stepPacket( step );
+					distanceNegative = Select( doneNegative, distanceNegative + stepPacket, distanceNegative );
+					distancePositive = Select( donePositive, distancePositive + stepPacket, distancePositive );
+					lumaEndNegative = Select( doneNegative, lumaAlong( zero - distanceNegative ), lumaEndNegative );
+					lumaEndPositive = Select( donePositive, lumaAlong( distancePositive ), lumaEndPositive );
+					doneNegative = doneNegative | (absolute( lumaEndNegative ) >= gradientScaled);
+					donePositive = donePositive | (absolute( lumaEndPositive ) >= gradientScaled);
+					if ( (doneNegative & donePositive).GetBits() == (1 << PacketWidth) - 1 )
+					{
+						break;
+					}
+				}
+
+				// The nearer end decides, but only if the edge's luma changes the right way there
+				const MaskPacket negativeNearer = distanceNegative < distancePositive;
+				const FloatPacket distance = Min( distanceNegative, distancePositive );
+				const FloatPacket lumaEnd = Select( negativeNearer, lumaEndPositive, lumaEndNegative );
+				const MaskPacket goodSpan = lumaEnd * (lumaM - lumaEdge) < zero;
+				const FloatPacket edgeOffset = Select( goodSpan, zero, half - distance / (distanceNegative + distancePositive) );
+				const FloatPacket offset = Select( edge, zero, Max( edgeOffset, subpixelOffset ) );
+
+				const IntPacket colorAcross = Select( horizontal, Select( negativeSide, colorE, colorW ), Select( negativeSide, colorS, colorN ) );
+				FloatPacket r, g, b, a;
+				FloatPacket acrossR, acrossG, acrossB, acrossA;
+				UnpackColor( colorM, r, g, b, a );
+				UnpackColor( colorAcross, acrossR, acrossG, acrossB, acrossA );
+				PackColor( r + (acrossR - r) * offset, g + (acrossG - g) * offset, b + (acrossB - b) * offset, one )
+					.StoreBlock( parameters.outputBuffer + upperRow + x, parameters.outputBuffer + lowerRow + x );
+			}
+		}
+	}
+
+	// Opaque, it's for showing on screen
+	void UpscaleRow( const UpscaleParameters& parameters, const uint32_t& tileY )
+	{
+		const uint32_t minY = tileY * TileSize;
+		const uint32_t maxY = MinScalar( minY + TileSize, parameters.targetHeight );
+		const uint32_t pitch = parameters.targetPitch;
+
+		// Pixel centres onto pixel centres
+		const FloatPacket scaleX( float( parameters.sourceWidth ) / float( parameters.targetWidth ) );
+		const FloatPacket scaleY( float( parameters.sourceHeight ) / float( parameters.targetHeight ) );
+		const FloatPacket zero( 0.0f );
+		const FloatPacket one( 1.0f );
+		const FloatPacket half( 0.5f );
+		const FloatPacket lastX( float( parameters.sourceWidth - 1 ) );
+		const FloatPacket lastY( float( parameters.sourceHeight - 1 ) );
+
+		alignas( 64 ) float blockX[PacketWidth];
+		alignas( 64 ) float blockY[PacketWidth];
+		for ( int lane = 0; lane < PacketWidth; lane++ )
+		{
+			blockX[lane] = float( lane % BlockWidth ) + 0.5f;
+			blockY[lane] = float( lane / BlockWidth ) + 0.5f;
+		}
+
+		for ( uint32_t y = minY; y < maxY; y += 2 )
+		{
+			// Same for every block in the row
+			const FloatPacket sourceY = Min( Max( (FloatPacket( float( y ) ) + FloatPacket::Load( blockY )) * scaleY - half, zero ), lastY );
+			const FloatPacket floorY = Floor( sourceY );
+			const FloatPacket weightY = sourceY - floorY;
+			const IntPacket y0 = ToInt( floorY );
+			const IntPacket y1 = ToInt( Min( floorY + one, lastY ) );
+
+			uint32_t* const upper = parameters.targetBuffer + size_t( y ) * pitch;
+			uint32_t* const lower = upper + pitch;
+			for ( uint32_t x = 0; x < parameters.targetWidth; x += BlockWidth )
+			{
+				const FloatPacket sourceX = Min( Max( (FloatPacket( float( x ) ) + FloatPacket::Load( blockX )) * scaleX - half, zero ), lastX );
+				const FloatPacket floorX = Floor( sourceX );
+				const FloatPacket weightX = sourceX - floorX;
+				const IntPacket x0 = ToInt( floorX );
+				const IntPacket x1 = ToInt( Min( floorX + one, lastX ) );
+
+				FloatPacket r[4], g[4], b[4], a[4];
+				UnpackColor( Gather( parameters.sourceBuffer, x0, y0, parameters.sourcePitch ), r[0], g[0], b[0], a[0] );
+				UnpackColor( Gather( parameters.sourceBuffer, x1, y0, parameters.sourcePitch ), r[1], g[1], b[1], a[1] );
+				UnpackColor( Gather( parameters.sourceBuffer, x0, y1, parameters.sourcePitch ), r[2], g[2], b[2], a[2] );
+				UnpackColor( Gather( parameters.sourceBuffer, x1, y1, parameters.sourcePitch ), r[3], g[3], b[3], a[3] );
+				const auto bilinear = [&weightX, &weightY]( const FloatPacket* channel )
+				{
+					const FloatPacket top = channel[0] + (channel[1] - channel[0]) * weightX;
+					const FloatPacket bottom = channel[2] + (channel[3] - channel[2]) * weightX;
+					return top + (bottom - top) * weightY;
+				};
+				PackColor( bilinear( r ), bilinear( g ), bilinear( b ), one ).StoreBlock( upper + x, lower + x );
+			}
+		}
+	}
+
+	const Kernels kernels
+	{
+		KernelLevel,
+		&Fill,
+		&FillStream,
+		&ClearTileRow,
+		MakePermutationTable<DrawPermutation, DrawPermutationCount>::Type::functions,
+		MakePermutationTable<DepthPermutation, DepthPermutationCount>::Type::functions,
+		MakePermutationTable<GBufferPermutation, GBufferPermutationCount>::Type::functions,
+		&ShadeDeferredTile,
+		MakePermutationTable<VisibilityPermutation, VisibilityPermutationCount>::Type::functions,
+		&ResolveVisibilityTile,
+		&ResolveSamplesRow,
+		MakePermutationTable<LinePermutation, 2>::Type::functions,
+		MakePermutationTable<WireframePermutation, WireframePermutationCount>::Type::functions,
+		&ShadeHiddenLineVertices,
+		MakePermutationTable<HiddenLineBinPermutation, uint32_t( CullMode::Count )>::Type::functions,
+		MakePermutationTable<HiddenLineDepthPermutation, uint32_t( CullMode::Count )>::Type::functions,
+		&DrawHiddenLineEdges,
+		&FxaaLumaRow,
+		&FxaaRow,
+		&UpscaleRow
+	};
+}
+}
@@ -0,0 +1,8 @@
+
+// Compiled with the default flags, so SSE2 on x86-64, or plain C++ elsewhere
+#include "KernelsImpl.hpp"
+
+const Kernels* GetKernelsSse2()
+{
+	return &kernels;
+}
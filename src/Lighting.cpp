@@ -0,0 +1,168 @@
+
+#include <algorithm>
+#include <cmath>
+
+#include "Framebuffer.hpp"
+#include "Lighting.hpp"
+
+void LightGrid::Build( const TrackedVector<Light, MemoryTag::Scene>& sceneLights, const glm::vec3& ambient, const glm::vec3& viewOrigin,
+	const glm::mat4& viewProj, const uint32_t& newWidth, const uint32_t& newHeight )
+{
+	width = newWidth;
+	height = newHeight;
+	tilesX = (width + TileSize - 1) / TileSize;
+	tilesY = (height + TileSize - 1) / TileSize;
+	const uint32_t tileCount = tilesX * tilesY;
+
+	lights.clear();
+	lights.reserve( sceneLights.size() );
+	for ( const Light& light : sceneLights )
+	{
+		LightParameters converted;
+		converted.type = light.type;
+		const glm::vec3 direction = glm::normalize( light.direction );
+		for ( int i = 0; i < 3; i++ )
+		{
+			converted.position[i] = light.position[i];
+			converted.direction[i] = direction[i];
+			converted.color[i] = light.color[i];
+		}
+		converted.invRangeSquared = 1.0f / std::max( light.range * light.range, 1e-6f );
+
+		const float cosInner = std::cos( glm::radians( light.innerAngle ) );
+		converted.cosOuter = std::cos( glm::radians( light.outerAngle ) );
+		converted.invConeWidth = 1.0f / std::max( cosInner - converted.cosOuter, 1e-4f );
+		lights.push_back( converted );
+	}
+
+	// Which tiles each light covers, then a count per tile, then the lists themselves
+	TrackedVector<glm::uvec2, MemoryTag::Frame> firstTiles( sceneLights.size() );
+	TrackedVector<glm::uvec2, MemoryTag::Frame> lastTiles( sceneLights.size() );
+	TrackedVector<bool, MemoryTag::Frame> visible( sceneLights.size() );
+	const Frustum frustum = Frustum::FromMatrix( viewProj );
+	for ( size_t i = 0; i < sceneLights.size(); i++ )
+	{
+		visible[i] = GetTileRange( sceneLights[i], viewProj, frustum, firstTiles[i], lastTiles[i] );
+	}
+
+	tileLightOffsets.assign( tileCount + 1, 0 );
+	for ( size_t i = 0; i < sceneLights.size(); i++ )
+	{
+		if ( !visible[i] )
+		{
+			continue;
+		}
+
+		for ( uint32_t y = firstTiles[i].y; y <= lastTiles[i].y; y++ )
+		{
+			for ( uint32_t x = firstTiles[i].x; x <= lastTiles[i].x; x++ )
+			{
+				tileLightOffsets[y * tilesX + x + 1]++;
+			}
+		}
+	}
+
+	for ( uint32_t tile = 0; tile < tileCount; tile++ )
+	{
+		tileLightOffsets[tile + 1] += tileLightOffsets[tile];
+	}
+
+	// Goes through the lights in order, so every tile's list stays in the same order as the lights
+	tileLightIndices.resize( tileLightOffsets[tileCount] );
+	TrackedVector<uint32_t, MemoryTag::Frame> cursors( tileLightOffsets.begin(), tileLightOffsets.end() - 1 );
+	for ( size_t i = 0; i < sceneLights.size(); i++ )
+	{
+		if ( !visible[i] )
+		{
+			continue;
+		}
+
+		for ( uint32_t y = firstTiles[i].y; y <= lastTiles[i].y; y++ )
+		{
+			for ( uint32_t x = firstTiles[i].x; x <= lastTiles[i].x; x++ )
+			{
+				tileLightIndices[cursors[y * tilesX + x]++] = i;
+			}
+		}
+	}
+
+	parameters.lights = lights.data();
+	parameters.lightCount = lights.size();
+	for ( int i = 0; i < 3; i++ )
+	{
+		parameters.ambient[i] = ambient[i];
+		parameters.viewOrigin[i] = viewOrigin[i];
+	}
+	parameters.tileLightOffsets = tileLightOffsets.data();
+	parameters.tileLightIndices = tileLightIndices.data();
+	parameters.tilesX = tilesX;
+}
+
+float LightGrid::GetAverageLightsPerTile() const
+{
+	const uint32_t tileCount = tilesX * tilesY;
+	return tileCount > 0 ? float( tileLightIndices.size() ) / tileCount : 0.0f;
+}
+
+bool LightGrid::GetTileRange( const Light& light, const glm::mat4& viewProj, const Frustum& frustum,
+	glm::uvec2& outFirst, glm::uvec2& outLast ) const
+{
+	if ( tilesX == 0 || tilesY == 0 )
+	{
+		return false;
+	}
+
+	outFirst = glm::uvec2( 0 );
+	outLast = glm::uvec2( tilesX - 1, tilesY - 1 );
+
+	// Reaches everywhere
+	if ( light.type == LightType::Directional )
+	{
+		return true;
+	}
+
+	// The box around the light's sphere, which is generous for narrow spot lights
+	Aabb bounds;
+	bounds.Add( light.position - glm::vec3( light.range ) );
+	bounds.Add( light.position + glm::vec3( light.range ) );
+	if ( frustum.Classify( bounds ) == Frustum::Outside )
+	{
+		return false;
+	}
+
+	glm::vec2 mins( FLT_MAX );
+	glm::vec2 maxs( -FLT_MAX );
+	for ( int corner = 0; corner < 8; corner++ )
+	{
+		const glm::vec3 position
+		{
+			corner & 1 ? bounds.maxs.x : bounds.mins.x,
+			corner & 2 ? bounds.maxs.y : bounds.mins.y,
+			corner & 4 ? bounds.maxs.z : bounds.mins.z
+		};
+		const glm::vec4 clip = viewProj * glm::vec4( position, 1.0f );
+
+		// Part of the box is behind the camera, its projection could be anywhere on screen
+		if ( clip.w <= 1e-4f )
+		{
+			return true;
+		}
+
+		// Same conventions as the rasterizer, y points down on screen
+		const glm::vec2 screen( (clip.x / clip.w + 1.0f) * 0.5f * width, (1.0f - clip.y / clip.w) * 0.5f * height );
+		mins = glm::min( mins, screen );
+		maxs = glm::max( maxs, screen );
+	}
+
+	if ( maxs.x < 0.0f || maxs.y < 0.0f || mins.x >= width || mins.y >= height )
+	{
+		return false;
+	}
+
+	const glm::vec2 lastPixel( width - 1.0f, height - 1.0f );
+	mins = glm::clamp( mins, glm::vec2( 0.0f ), lastPixel );
+	maxs = glm::clamp( maxs, glm::vec2( 0.0f ), lastPixel );
+	outFirst = glm::uvec2( mins ) / TileSize;
+	outLast = glm::uvec2( maxs ) / TileSize;
+	return true;
+}
@@ -0,0 +1,55 @@
+
+#pragma once
+
+#include "Bvh.hpp"
+#include "Kernels.hpp"
+
+struct Light
+{
+	LightType type{ LightType::Point };
+	glm::vec3 position{ 0.0f };
+	// Where it shines towards, for directional and spot lights
+	glm::vec3 direction{ 0.0f, 0.0f, -1.0f };
+	// Already multiplied by the intensity
+	glm::vec3 color{ 1.0f };
+	// Point and spot lights fade out to nothing at this distance, and don't reach any further
+	float range{ 10.0f };
+	// Half-angles of the spot cone in degrees, full brightness inside the inner one
+	float innerAngle{ 15.0f };
+	float outerAngle{ 25.0f };
+};
+
+// The lights of a frame, sorted into the screen tiles they can reach
+// Per-pixel lighting then only goes through a tile's own list, so lights that cover a small part of
+// the screen cost next to nothing everywhere else
+class LightGrid
+{
+public:
+	// Once per frame, with the same size as the framebuffer that gets drawn into
+	void Build( const TrackedVector<Light, MemoryTag::Scene>& lights, const glm::vec3& ambient, const glm::vec3& viewOrigin,
+		const glm::mat4& viewProj, const uint32_t& width, const uint32_t& height );
+
+	const LightingParameters& GetParameters() const
+	{
+		return parameters;
+	}
+
+	// Averaged over all tiles, to see how well the culling works
+	float GetAverageLightsPerTile() const;
+
+private:
+	// The range of tiles the light's sphere covers on screen, false if it's not on screen at all
+	bool GetTileRange( const Light& light, const glm::mat4& viewProj, const Frustum& frustum,
+		glm::uvec2& outFirst, glm::uvec2& outLast ) const;
+
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	uint32_t tilesX{ 0 };
+	uint32_t tilesY{ 0 };
+
+	TrackedVector<LightParameters, MemoryTag::Frame> lights;
+	// A tile's first index into tileLightIndices, with one extra at the end
+	TrackedVector<uint32_t, MemoryTag::Frame> tileLightOffsets;
+	TrackedVector<uint32_t, MemoryTag::Frame> tileLightIndices;
+	LightingParameters parameters{};
+};
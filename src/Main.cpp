@@ -1,300 +1,420 @@
-
-#include <iostream>
-#include <chrono>
-using namespace std::chrono;
-
-#include "SDL.h"
-#include "glm/glm.hpp"
-#include "glm/gtc/matrix_transform.hpp"
-
-constexpr int CENTER = SDL_WINDOWPOS_CENTERED;
-
-SDL_Window* window = nullptr;
-SDL_Renderer* renderer = nullptr;
-
-float windowWidth = 1024.0f;
-float windowHeight = 1024.0f;
-
-glm::vec3 viewOrigin{ 0.0f, 0.0f, 0.0f };
-glm::vec3 viewAngles{ 0.0f, 0.0f, 0.0f };
-glm::vec3 viewForward{ 1.0f, 0.0f, 0.0f };
-glm::vec3 viewRight{ 0.0f, -1.0f, 0.0f };
-glm::vec3 viewUp{ 0.0f, 0.0f, 1.0f };
-
-float viewSpeed = 10.0f;
-
-glm::mat4 projMatrix;
-glm::mat4 viewMatrix;
-
-// Takes points in [-1, 1] coordinates, will convert them to screen coords properly
-void DrawLine( const float& x1, const float& y1, const float& x2, const float& y2 )
-{
-	const auto ntoz = []( const float& n )
-	{
-		return (n * 0.5f) + 0.5f;
-	};
-
-	// Transformed ones
-	const float tx1 = ntoz( x1 ) * windowWidth;
-	const float tx2 = ntoz( x2 ) * windowWidth;
-	const float ty1 = (1.0f - ntoz( y1 )) * windowHeight;
-	const float ty2 = (1.0f - ntoz( y2 )) * windowHeight;
-
-	SDL_RenderDrawLine( renderer, tx1, ty1, tx2, ty2 );
-}
-
-inline glm::vec4 GetVec4From( const glm::vec3& v )
-{
-	return glm::vec4( v, 1.0f );
-}
-
-struct Triangle
-{
-	void Draw() const
-	{
-		const glm::vec4 transformed[3]
-		{
-			projMatrix * viewMatrix * glm::identity<glm::mat4>() * GetVec4From( verts[0] ),
-			projMatrix * viewMatrix * glm::identity<glm::mat4>() * GetVec4From( verts[1] ),
-			projMatrix * viewMatrix * glm::identity<glm::mat4>() * GetVec4From( verts[2] )
-		};
-		
-		for ( int i = 0; i < 3; i++ )
-		{
-			const int next = (i + 1) % 3;
-			DrawLine( 
-				transformed[i].x / transformed[i].w, 
-				transformed[i].y / transformed[i].w,
-				transformed[next].x / transformed[next].w, 
-				transformed[next].y / transformed[next].w );
-		}
-	}
-
-	glm::vec3 verts[3];
-};
-
-struct UserCommands
-{
-	enum Flags
-	{
-		Quit = 1,
-		SpeedModifier = 2,
-		LeftMouseButton = 4,
-		RightMouseButton = 8
-	};
-
-	int flags{ 0 };
-
-	float forward{ 0.0f };
-	float right{ 0.0f };
-	float up{ 0.0f };
-
-	float mouseX{ 0.0f };
-	float mouseY{ 0.0f };
-};
-
-UserCommands GenerateUserCommands()
-{
-	// Before we do all that, let's also update the window info
-	{
-		int w, h;
-		SDL_GetWindowSize( window, &w, &h );
-		windowWidth = w;
-		windowHeight = h;
-	}
-
-	UserCommands uc;
-
-	SDL_Event e;
-	while ( SDL_PollEvent( &e ) )
-	{
-		if ( e.type == SDL_QUIT )
-		{
-			uc.flags |= UserCommands::Quit;
-		}
-
-		else if ( e.type == SDL_MOUSEBUTTONDOWN )
-		{
-			if ( e.button.button == SDL_BUTTON_LEFT )
-			{
-				uc.flags |= UserCommands::LeftMouseButton;
-			}
-			if ( e.button.button == SDL_BUTTON_RIGHT )
-			{
-				uc.flags |= UserCommands::RightMouseButton;
-			}
-		}
-	}
-
-	const auto* states = SDL_GetKeyboardState( nullptr );
-	if ( states[SDL_SCANCODE_W] )
-	{
-		uc.forward += 1.0f;
-	}
-	if ( states[SDL_SCANCODE_S] )
-	{
-		uc.forward -= 1.0f;
-	}
-	if ( states[SDL_SCANCODE_A] )
-	{
-		uc.right -= 1.0f;
-	}
-	if ( states[SDL_SCANCODE_D] )
-	{
-		uc.right += 1.0f;
-	}
-	if ( states[SDL_SCANCODE_LSHIFT] )
-	{
-		uc.flags |= UserCommands::SpeedModifier;
-	}
-
-	int x, y;
-	SDL_GetRelativeMouseState( &x, &y );
-	uc.mouseX = x;
-	uc.mouseY = y;
-
-	return uc;
-}
-
-void SetupMatrices()
-{
-	using namespace glm;
-
-	projMatrix = perspective( 90.0f, windowWidth / windowHeight, 0.01f, 1000.0f );
-
-	// Spherical coords
-	const vec3 angles = radians( viewAngles );
-
-	const float cosPitch = cos( angles.x );
-	const float sinPitch = sin( angles.x );
-	const float cosYaw = cos( angles.y );
-	const float sinYaw = sin( angles.y );
-	const float cosRoll = cos( angles.z );
-	const float sinRoll = sin( angles.z );
-
-	viewForward = 
-	{
-		cosYaw * cosPitch,
-		-sinYaw * cosPitch,
-		-sinPitch
-	};
-
-	viewUp =
-	{
-		(cosRoll * sinPitch * cosYaw) + (-sinRoll * -sinYaw),
-		(cosRoll * -sinPitch * sinYaw) + (-sinRoll * cosYaw),
-		cosPitch * cosRoll
-	};
-
-	viewRight = cross( viewForward, viewUp );
-
-	viewMatrix = lookAt( viewOrigin, viewOrigin + viewForward, viewUp );
-}
-
-inline float crandom()
-{
-	return rand() / 32768.0f;
-}
-
-inline glm::vec3 randVec()
-{
-	return glm::vec3( crandom(), crandom(), crandom() ) * crandom() * 15.0f;
-}
-
-void RunFrame( const float& deltaTime, const UserCommands& uc )
-{
-	viewAngles.x += uc.mouseY * deltaTime * 80.0f;
-	viewAngles.y += uc.mouseX * deltaTime * 80.0f;
-
-	// Clamp the pitch
-	if ( viewAngles.x > 89.0f )
-		viewAngles.x = 89.0f;
-	if ( viewAngles.x < -89.0f )
-		viewAngles.x = -89.0f;
-
-	// Offset the view position
-	viewOrigin += uc.forward * viewForward * deltaTime * viewSpeed;
-	viewOrigin += uc.right * viewRight * deltaTime * viewSpeed;
-	viewOrigin += uc.up * viewUp * deltaTime * viewSpeed;
-	
-	SetupMatrices();
-
-	// Clear the view
-	SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
-	SDL_RenderClear( renderer );
-	
-	// Draw some triangles
-	SDL_SetRenderDrawColor( renderer, 255, 255, 255, 255 );
-	static const Triangle tris[]
-	{
-		{ { { -1.0f, -1.0f, 0.0f }, { 1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 1.0f } } },
-		{ { randVec(), randVec(), randVec() } },
-		{ { randVec(), randVec(), randVec() } },
-		{ { randVec(), randVec(), randVec() } },
-		{ { randVec(), randVec(), randVec() } },
-		{ { randVec(), randVec(), randVec() } },
-		{ { randVec(), randVec(), randVec() } },
-		{ { randVec(), randVec(), randVec() } },
-		{ { randVec(), randVec(), randVec() } }
-	};
-	for ( const Triangle& tri : tris )
-	{
-		tri.Draw();
-	}
-
-	{
-		// Top view
-		// Forward = red
-		SDL_SetRenderDrawColor( renderer, 255, 100, 100, 255 );
-		DrawLine( 0.0f, 0.0f, viewForward.x * 0.1f, viewForward.y * 0.1f );
-		// Right = green
-		SDL_SetRenderDrawColor( renderer, 100, 255, 100, 255 );
-		DrawLine( 0.0f, 0.0f, viewRight.x * 0.1f, viewRight.y * 0.1f );
-		// Up = blue
-		SDL_SetRenderDrawColor( renderer, 100, 100, 255, 255 );
-		DrawLine( 0.0f, 0.0f, viewUp.x * 0.1f, viewUp.y * 0.1f );
-
-		// Side view
-		// Forward = red
-		SDL_SetRenderDrawColor( renderer, 255, 100, 100, 255 );
-		DrawLine( 0.3f, 0.0f, 0.3f + viewForward.x * 0.1f, viewForward.z * 0.1f );
-		// Right = green
-		SDL_SetRenderDrawColor( renderer, 100, 255, 100, 255 );
-		DrawLine( 0.3f, 0.0f, 0.3f + viewRight.x * 0.1f, viewRight.z * 0.1f );
-		// Up = blue
-		SDL_SetRenderDrawColor( renderer, 100, 100, 255, 255 );
-		DrawLine( 0.3f, 0.0f, 0.3f + viewUp.x * 0.1f, viewUp.z * 0.1f );
-	}
-
-	SDL_RenderPresent( renderer );
-}
-
-int main( int argc, char** argv )
-{
-	SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS );
-
-	window = SDL_CreateWindow( "SoftRenda", CENTER, CENTER, windowWidth, windowHeight, SDL_WINDOW_RESIZABLE );
-	renderer = SDL_CreateRenderer( window, 0, SDL_RENDERER_SOFTWARE );
-	SDL_SetRelativeMouseMode( SDL_TRUE );
-
-	float deltaTime = 0.016f;
-	while ( true )
-	{
-		auto tpStart = system_clock::now();
-
-		auto uc = GenerateUserCommands();
-		if ( uc.flags & UserCommands::Quit )
-		{
-			break;
-		}
-
-		RunFrame( deltaTime, uc );
-
-		auto tpEnd = system_clock::now();
-		deltaTime = duration_cast<microseconds>(tpEnd - tpStart).count() * 0.001f * 0.001f;
-	}
-
-	SDL_Quit();
-
-	return 0;
-}
+
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+using namespace std::chrono;
+
+#include "SDL.h"
+
+#include "src/Frame.hpp"
+#include "src/Input.hpp"
+#include "src/PerfCounters.hpp"
+
+constexpr int CENTER = SDL_WINDOWPOS_CENTERED;
+
+SDL_Window* window = nullptr;
+SDL_Renderer* renderer = nullptr;
+// What the framebuffer gets uploaded into every frame, recreated when the window size changes
+SDL_Texture* frameTexture = nullptr;
+uint32_t frameTextureWidth = 0;
+uint32_t frameTextureHeight = 0;
+
+float windowWidth = 1024.0f;
+float windowHeight = 1024.0f;
+
+// See -record and -replay
+InputRecorder recorder;
+InputReplay replay;
+bool replaying{ false };
+// Replays without opening a window
+bool headless{ false };
+
+UserCommands GenerateUserCommands()
+{
+	UserCommands uc;
+
+	SDL_Event e;
+	while ( SDL_PollEvent( &e ) )
+	{
+		if ( e.type == SDL_QUIT )
+		{
+			uc.flags |= UserCommands::Quit;
+		}
+
+		// The framebuffer follows on the next frame, it only reallocates when the size really changed
+		else if ( e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED )
+		{
+			windowWidth = e.window.data1;
+			windowHeight = e.window.data2;
+		}
+
+		else if ( e.type == SDL_MOUSEBUTTONDOWN )
+		{
+			// The cursor is hidden and stuck wherever it was while the mouse looks around, so clicks go
+			// through the crosshair
+			if ( SDL_GetRelativeMouseMode() )
+			{
+				uc.cursorX = windowWidth * 0.5f;
+				uc.cursorY = windowHeight * 0.5f;
+			}
+			else
+			{
+				uc.cursorX = e.button.x;
+				uc.cursorY = e.button.y;
+			}
+
+			if ( e.button.button == SDL_BUTTON_LEFT )
+			{
+				uc.flags |= UserCommands::LeftMouseButton;
+			}
+			if ( e.button.button == SDL_BUTTON_RIGHT )
+			{
+				uc.flags |= UserCommands::RightMouseButton;
+			}
+		}
+
+		else if ( e.type == SDL_KEYDOWN && !e.key.repeat )
+		{
+			switch ( e.key.keysym.scancode )
+			{
+			case SDL_SCANCODE_1: uc.flags |= UserCommands::CycleRenderMode; break;
+			case SDL_SCANCODE_2: uc.flags |= UserCommands::ToggleTexturing; break;
+			case SDL_SCANCODE_3: uc.flags |= UserCommands::CycleShader; break;
+			case SDL_SCANCODE_4: uc.flags |= UserCommands::ToggleBlending; break;
+			case SDL_SCANCODE_5: uc.flags |= UserCommands::CycleCullMode; break;
+			case SDL_SCANCODE_6: uc.flags |= UserCommands::CycleShadingPath; break;
+			case SDL_SCANCODE_7: uc.flags |= UserCommands::ToggleDepthPrepass; break;
+			case SDL_SCANCODE_8: uc.flags |= UserCommands::ToggleDepthClearElision; break;
+			case SDL_SCANCODE_9: uc.flags |= UserCommands::ToggleMultisampling; break;
+			case SDL_SCANCODE_0: uc.flags |= UserCommands::ToggleFxaa; break;
+			case SDL_SCANCODE_MINUS: uc.flags |= UserCommands::ToggleDynamicResolution; break;
+			case SDL_SCANCODE_M: uc.flags |= UserCommands::PrintMemoryUsage; break;
+			default: break;
+			}
+		}
+	}
+
+	const auto* states = SDL_GetKeyboardState( nullptr );
+	if ( states[SDL_SCANCODE_W] )
+	{
+		uc.forward += 1.0f;
+	}
+	if ( states[SDL_SCANCODE_S] )
+	{
+		uc.forward -= 1.0f;
+	}
+	if ( states[SDL_SCANCODE_A] )
+	{
+		uc.right -= 1.0f;
+	}
+	if ( states[SDL_SCANCODE_D] )
+	{
+		uc.right += 1.0f;
+	}
+	if ( states[SDL_SCANCODE_LSHIFT] )
+	{
+		uc.flags |= UserCommands::SpeedModifier;
+	}
+
+	int x, y;
+	SDL_GetRelativeMouseState( &x, &y );
+	uc.mouseX = x;
+	uc.mouseY = y;
+
+	return uc;
+}
+
+// There's no text on screen, so the instructions per cycle of each stage, and its share of the cycles, go into
+// the window title, then the counts start over
+void ShowPerfCountersInTitle()
+{
+	PerfCounters& perf = GetPerfCounters();
+	uint64_t totalCycles = 0;
+	for ( uint32_t stage = 0; stage < uint32_t( FrameStage::Count ); stage++ )
+	{
+		totalCycles += perf.GetStageCounts( stage )[PerfEvent::Cycles];
+	}
+
+	std::string title = "SoftRenda";
+	char buffer[96];
+	for ( uint32_t stage = 0; stage < uint32_t( FrameStage::Count ); stage++ )
+	{
+		const PerfCounts counts = perf.GetStageCounts( stage );
+		std::snprintf( buffer, sizeof( buffer ), " | %s %.0f%% %.2f IPC", FrameStageNames[stage],
+			counts[PerfEvent::Cycles] * 100.0 / std::max<uint64_t>( totalCycles, 1 ),
+			counts[PerfEvent::Instructions] / std::max( double( counts[PerfEvent::Cycles] ), 1.0 ) );
+		title += buffer;
+	}
+	SDL_SetWindowTitle( window, title.c_str() );
+	perf.ResetCounts();
+}
+
+// Into the window title, like the performance counters, until those come around again
+void ShowPickInTitle()
+{
+	const PickResult& picked = GetPicked();
+	char title[128];
+	if ( picked.object != Bvh::InvalidIndex )
+	{
+		std::snprintf( title, sizeof( title ), "SoftRenda | Picked object %u, triangle %u at distance %.2f (%.3f ms)",
+			picked.object, picked.triangle, picked.distance, GetPickTime() );
+	}
+	else
+	{
+		std::snprintf( title, sizeof( title ), "SoftRenda | Picked nothing (%.3f ms)", GetPickTime() );
+	}
+	SDL_SetWindowTitle( window, title );
+}
+
+// Uploads the framebuffer and puts it on the window
+void PresentFramebuffer()
+{
+	// Stretched to the window if it was rendered smaller
+	const uint32_t width = windowWidth;
+	const uint32_t height = windowHeight;
+	const bool upscale = width != framebuffer.GetWidth() || height != framebuffer.GetHeight();
+	if ( upscale )
+	{
+		framebuffer.Upscale( width, height, threadPool );
+	}
+
+	if ( frameTexture == nullptr || frameTextureWidth != width || frameTextureHeight != height )
+	{
+		if ( frameTexture != nullptr )
+		{
+			SDL_DestroyTexture( frameTexture );
+		}
+
+		frameTexture = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height );
+		frameTextureWidth = width;
+		frameTextureHeight = height;
+	}
+
+	if ( upscale )
+	{
+		SDL_UpdateTexture( frameTexture, nullptr, framebuffer.GetUpscaledColor(), framebuffer.GetUpscaledPitch() * sizeof( uint32_t ) );
+	}
+	else
+	{
+		SDL_UpdateTexture( frameTexture, nullptr, framebuffer.GetColor(), framebuffer.GetPitch() * sizeof( uint32_t ) );
+	}
+	SDL_RenderCopy( renderer, frameTexture, nullptr, nullptr );
+}
+
+int main( int argc, char** argv )
+{
+	// Optionally, OBJ files to look at and BMP textures
+	std::vector<std::string> meshPaths;
+	std::vector<std::string> texturePaths;
+	for ( int i = 1; i < argc; i++ )
+	{
+		const size_t length = std::strlen( argv[i] );
+		if ( !std::strcmp( argv[i], "-texturebudget" ) && i + 1 < argc )
+		{
+			// In megabytes
+			textureCache.SetBudget( size_t( std::atoi( argv[++i] ) ) << 20 );
+		}
+		else if ( !std::strcmp( argv[i], "-simd" ) && i + 1 < argc )
+		{
+			// Caps the instruction set the kernels use, e.g. to compare them
+			SimdLevel level;
+			if ( ParseSimdLevel( argv[++i], level ) )
+			{
+				SelectKernels( level );
+			}
+			else
+			{
+				std::cerr << "Unknown instruction set " << argv[i] << ", expected sse2, avx2 or avx512" << std::endl;
+			}
+		}
+		else if ( !std::strcmp( argv[i], "-targetfps" ) && i + 1 < argc )
+		{
+			// Turns on dynamic resolution, aiming for this frame rate
+			const float framesPerSecond = float( std::atof( argv[++i] ) );
+			if ( framesPerSecond > 0.0f )
+			{
+				dynamicResolution.SetTargetFrameTime( 1.0f / framesPerSecond );
+				dynamicResolution.SetEnabled( true );
+			}
+		}
+		else if ( !std::strcmp( argv[i], "-record" ) && i + 1 < argc )
+		{
+			// The input of every frame, to replay later
+			if ( !recorder.Open( argv[++i] ) )
+			{
+				std::cerr << "Couldn't open " << argv[i] << " to record into" << std::endl;
+			}
+		}
+		else if ( !std::strcmp( argv[i], "-replay" ) && i + 1 < argc )
+		{
+			// Instead of the live input, until the recording runs out
+			replaying = replay.Load( argv[++i] );
+			if ( !replaying )
+			{
+				std::cerr << "Couldn't load the recording " << argv[i] << std::endl;
+			}
+		}
+		else if ( !std::strcmp( argv[i], "-perfcounters" ) )
+		{
+			// Per frame stage, in the window title, or after a replay
+			if ( !GetPerfCounters().Enable() )
+			{
+				std::cerr << "No hardware performance counters, they need Linux, a CPU that exposes them and perf_event_paranoid at 2 or less" << std::endl;
+			}
+		}
+		else if ( !std::strcmp( argv[i], "-headless" ) )
+		{
+			// No window, only goes with -replay
+			headless = true;
+		}
+		else if ( length > 4 && !std::strcmp( argv[i] + length - 4, ".bmp" ) )
+		{
+			texturePaths.push_back( argv[i] );
+		}
+		else
+		{
+			meshPaths.push_back( argv[i] );
+		}
+	}
+
+	if ( headless && !replaying )
+	{
+		std::cerr << "-headless needs a recording to -replay, running with a window" << std::endl;
+		headless = false;
+	}
+
+	if ( replaying && recorder.IsOpen() )
+	{
+		// It would only record the replayed frames again, a copy of the recording at best
+		std::cerr << "-record and -replay don't go together, record the live input on its own" << std::endl;
+		return 1;
+	}
+	if ( replaying && dynamicResolution.IsEnabled() )
+	{
+		std::cout << "The resolution stays at full size during the replay, the recorded frame times are another run's" << std::endl;
+	}
+
+	if ( headless )
+	{
+		SDL_Init( 0 );
+	}
+	else
+	{
+		SDL_Init( SDL_INIT_VIDEO | SDL_INIT_EVENTS );
+
+		window = SDL_CreateWindow( "SoftRenda", CENTER, CENTER, windowWidth, windowHeight, SDL_WINDOW_RESIZABLE );
+		renderer = SDL_CreateRenderer( window, 0, SDL_RENDERER_SOFTWARE );
+		SDL_SetRelativeMouseMode( SDL_TRUE );
+		showCrosshair = true;
+		// Whatever the window manager made of the size asked for, resize events take it from here
+		int w, h;
+		SDL_GetWindowSize( window, &w, &h );
+		windowWidth = w;
+		windowHeight = h;
+	}
+
+	std::cout << "Using " << GetSimdLevelName( GetKernels().level ) << " kernels (the CPU supports "
+		<< GetSimdLevelName( DetectSimdLevel() ) << ")" << std::endl;
+
+	CreateScene( meshPaths, texturePaths );
+	CreateLights();
+
+	float deltaTime = 0.016f;
+	// How long the replayed frames really took, in seconds
+	double replayTime = 0.0;
+	float slowestReplayFrame = 0.0f;
+	uint32_t replayedFrames = 0;
+	// Since the counters went into the window title
+	float perfTitleTime = 0.0f;
+	GetPerfCounters().ResetCounts();
+	while ( true )
+	{
+		auto tpStart = system_clock::now();
+
+		RecordedFrame frame;
+		if ( replaying )
+		{
+			// With a window, it still has to take its events, closing it stops the replay
+			if ( !headless && (GenerateUserCommands().flags & UserCommands::Quit) )
+			{
+				break;
+			}
+			if ( !replay.Next( frame ) )
+			{
+				break;
+			}
+
+			windowWidth = frame.windowWidth;
+			windowHeight = frame.windowHeight;
+		}
+		else
+		{
+			frame.commands = GenerateUserCommands();
+			frame.deltaTime = deltaTime;
+			frame.windowWidth = windowWidth;
+			frame.windowHeight = windowHeight;
+		}
+
+		// The quitting frame too, so the replay ends in the same place, never open while replaying
+		recorder.Write( frame );
+		if ( frame.commands.flags & UserCommands::Quit )
+		{
+			break;
+		}
+
+		// Window-sized, unless the frames are too slow for that, but a replay keeps its scale,
+		// following the recorded frame times would only put another run's slowdowns into it
+		if ( !replaying )
+		{
+			dynamicResolution.Update( frame.deltaTime );
+		}
+		RunFrame( frame.deltaTime, frame.commands, windowWidth, windowHeight );
+		if ( renderer != nullptr )
+		{
+			PresentFramebuffer();
+			SDL_RenderPresent( renderer );
+		}
+		if ( window != nullptr && (frame.commands.flags & UserCommands::LeftMouseButton) )
+		{
+			ShowPickInTitle();
+		}
+
+		auto tpEnd = system_clock::now();
+		deltaTime = duration_cast<microseconds>(tpEnd - tpStart).count() * 0.001f * 0.001f;
+		if ( replaying )
+		{
+			replayTime += deltaTime;
+			slowestReplayFrame = std::max( slowestReplayFrame, deltaTime );
+			replayedFrames++;
+		}
+
+		perfTitleTime += deltaTime;
+		if ( window != nullptr && GetPerfCounters().IsEnabled() && !replaying && perfTitleTime >= 1.0f )
+		{
+			ShowPerfCountersInTitle();
+			perfTitleTime = 0.0f;
+		}
+	}
+
+	if ( replayedFrames > 0 )
+	{
+		std::cout << "Replayed " << replayedFrames << " frames in " << replayTime << " s, "
+			<< replayTime * 1000.0 / replayedFrames << " ms on average, the slowest took " << slowestReplayFrame * 1000.0f << " ms" << std::endl;
+		PrintPerfCounters( "Performance counters of the replay" );
+	}
+
+	// While everything is still around, the peaks are what's interesting anyway
+	PrintMemoryUsage( "Memory at exit" );
+
+	if ( frameTexture != nullptr )
+	{
+		SDL_DestroyTexture( frameTexture );
+	}
+	SDL_Quit();
+
+	return 0;
+}
+
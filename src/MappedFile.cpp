@@ -0,0 +1,195 @@
+
+#include <atomic>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool GetFileStamp( const char* path, uint64_t& outSize, int64_t& outTime )
+{
+	struct stat info;
+	if ( stat( path, &info ) != 0 )
+	{
+		return false;
+	}
+
+	outSize = uint64_t( info.st_size );
+	outTime = int64_t( info.st_mtime );
+	return true;
+}
+
+#ifdef _WIN32
+std::FILE* CreateTemporaryFile( const char* path, std::string& outTemporaryPath )
+{
+	// The process ID tells processes apart, the counter threads
+	static std::atomic<uint32_t> counter{ 0 };
+	outTemporaryPath = std::string( path ) + "." + std::to_string( GetCurrentProcessId() ) + "." + std::to_string( counter++ ) + ".tmp";
+	return std::fopen( outTemporaryPath.c_str(), "wb" );
+}
+
+bool CommitTemporaryFile( const std::string& temporaryPath, const char* path, const bool& ok )
+{
+	// Unlike rename, this replaces a file that's there already, it fails while someone has it mapped though
+	if ( ok && MoveFileExA( temporaryPath.c_str(), path, MOVEFILE_REPLACE_EXISTING ) )
+	{
+		return true;
+	}
+
+	DeleteFileA( temporaryPath.c_str() );
+	return false;
+}
+#else
+std::FILE* CreateTemporaryFile( const char* path, std::string& outTemporaryPath )
+{
+	std::string pattern = std::string( path ) + ".XXXXXX";
+	const int descriptor = mkstemp( &pattern[0] );
+	if ( descriptor < 0 )
+	{
+		return nullptr;
+	}
+
+	// mkstemp only lets the owner read it, unlike what fopen would have created
+	fchmod( descriptor, 0644 );
+	std::FILE* file = fdopen( descriptor, "wb" );
+	if ( file == nullptr )
+	{
+		close( descriptor );
+		unlink( pattern.c_str() );
+		return nullptr;
+	}
+
+	outTemporaryPath = pattern;
+	return file;
+}
+
+bool CommitTemporaryFile( const std::string& temporaryPath, const char* path, const bool& ok )
+{
+	// Readers that already mapped the old file keep it, it only goes away once they unmap it
+	if ( ok && rename( temporaryPath.c_str(), path ) == 0 )
+	{
+		return true;
+	}
+
+	unlink( temporaryPath.c_str() );
+	return false;
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open( const char* path, const bool& sequential )
+{
+	Close();
+
+	HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0), nullptr );
+	if ( file == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if ( mapping == nullptr )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	const void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( view == nullptr )
+	{
+		CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+
+	data = static_cast<const char*>( view );
+	size = size_t( fileSize.QuadPart );
+	fileHandle = file;
+	mappingHandle = mapping;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( data != nullptr )
+	{
+		UnmapViewOfFile( data );
+		CloseHandle( mappingHandle );
+		CloseHandle( fileHandle );
+	}
+
+	data = nullptr;
+	size = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+#else
+bool MappedFile::Open( const char* path, const bool& sequential )
+{
+	Close();
+
+	const int file = open( path, O_RDONLY );
+	if ( file < 0 )
+	{
+		return false;
+	}
+
+	struct stat info;
+	if ( fstat( file, &info ) != 0 || info.st_size == 0 )
+	{
+		close( file );
+		return false;
+	}
+
+	void* view = mmap( nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+	// The mapping keeps its own reference to the file
+	close( file );
+	if ( view == MAP_FAILED )
+	{
+		return false;
+	}
+
+	if ( sequential )
+	{
+		madvise( view, info.st_size, MADV_SEQUENTIAL );
+	}
+
+	data = static_cast<const char*>( view );
+	size = size_t( info.st_size );
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( data != nullptr )
+	{
+		munmap( const_cast<char*>( data ), size );
+	}
+
+	data = nullptr;
+	size = 0;
+}
+#endif
@@ -0,0 +1,55 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Size and last modification time, for checking whether something derived from a file is stale
+bool GetFileStamp( const char* path, uint64_t& outSize, int64_t& outTime );
+
+// For writing a file that others may map at any time: it gets written into a new file next to it, with a name
+// no other writer, in this process or another, is using, and then CommitTemporaryFile moves it into place in one go
+std::FILE* CreateTemporaryFile( const char* path, std::string& outTemporaryPath );
+// Renames the finished temporary file over path, or deletes it if that fails or ok is already false
+bool CommitTemporaryFile( const std::string& temporaryPath, const char* path, const bool& ok );
+
+// A read-only view of a whole file, mapped into memory by the OS
+// Pages get loaded as they're touched, so nothing is copied up-front
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+
+	// Sequential is a hint that the file will be read once, front to back
+	bool Open( const char* path, const bool& sequential = false );
+	void Close();
+
+	bool IsOpen() const
+	{
+		return data != nullptr;
+	}
+
+	const char* GetData() const
+	{
+		return data;
+	}
+
+	size_t GetSize() const
+	{
+		return size;
+	}
+
+private:
+	const char* data{ nullptr };
+	size_t size{ 0 };
+#ifdef _WIN32
+	void* fileHandle{ nullptr };
+	void* mappingHandle{ nullptr };
+#endif
+};
@@ -0,0 +1,132 @@
+
+#include <atomic>
+#include <cstdlib>
+
+#include "Memory.hpp"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+constexpr size_t CacheLineSize = 64;
+
+namespace
+{
+	struct MemoryCounters
+	{
+		std::atomic<size_t> currentBytes{ 0 };
+		std::atomic<size_t> peakBytes{ 0 };
+		std::atomic<size_t> allocationCount{ 0 };
+
+		void Add( const size_t& bytes )
+		{
+			const size_t current = currentBytes += bytes;
+			allocationCount++;
+			size_t peak = peakBytes.load( std::memory_order_relaxed );
+			while ( current > peak && !peakBytes.compare_exchange_weak( peak, current, std::memory_order_relaxed ) )
+			{
+			}
+		}
+
+		void Remove( const size_t& bytes )
+		{
+			currentBytes -= bytes;
+			allocationCount--;
+		}
+
+		MemoryStats GetStats() const
+		{
+			MemoryStats stats;
+			stats.currentBytes = currentBytes;
+			stats.peakBytes = peakBytes;
+			stats.allocationCount = allocationCount;
+			return stats;
+		}
+	};
+
+	// Constant-initialised, so allocations from other static constructors already get counted
+	MemoryCounters tagCounters[uint32_t( MemoryTag::Count )];
+	MemoryCounters totalCounters;
+
+	const char* const MemoryTagNames[] =
+	{
+		"framebuffer",
+		"depth",
+		"meshes",
+		"BVHs",
+		"textures",
+		"scene",
+		"per-frame scratch",
+		"jobs"
+	};
+
+	static_assert( sizeof( MemoryTagNames ) / sizeof( MemoryTagNames[0] ) == uint32_t( MemoryTag::Count ),
+		"Every memory tag needs a name" );
+}
+
+void TrackAllocation( const MemoryTag& tag, const size_t& bytes )
+{
+	tagCounters[uint32_t( tag )].Add( bytes );
+	totalCounters.Add( bytes );
+}
+
+void TrackFree( const MemoryTag& tag, const size_t& bytes )
+{
+	tagCounters[uint32_t( tag )].Remove( bytes );
+	totalCounters.Remove( bytes );
+}
+
+MemoryStats GetMemoryStats( const MemoryTag& tag )
+{
+	return tagCounters[uint32_t( tag )].GetStats();
+}
+
+MemoryStats GetTotalMemoryStats()
+{
+	return totalCounters.GetStats();
+}
+
+const char* GetMemoryTagName( const MemoryTag& tag )
+{
+	return MemoryTagNames[uint32_t( tag )];
+}
+
+void* AllocateAligned( const size_t& bytes, const MemoryTag& tag )
+{
+	if ( bytes == 0 )
+	{
+		return nullptr;
+	}
+
+	// Nothing checks for null, so running out has to be loud, the same as with new
+#ifdef _WIN32
+	void* memory = _aligned_malloc( bytes, CacheLineSize );
+	if ( memory == nullptr )
+	{
+		throw std::bad_alloc();
+	}
+#else
+	void* memory = nullptr;
+	if ( posix_memalign( &memory, CacheLineSize, bytes ) != 0 )
+	{
+		throw std::bad_alloc();
+	}
+#endif
+	TrackAllocation( tag, bytes );
+	return memory;
+}
+
+void FreeAligned( void* memory, const size_t& bytes, const MemoryTag& tag )
+{
+	if ( memory == nullptr )
+	{
+		return;
+	}
+
+	TrackFree( tag, bytes );
+#ifdef _WIN32
+	_aligned_free( memory );
+#else
+	std::free( memory );
+#endif
+}
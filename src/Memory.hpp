@@ -0,0 +1,184 @@
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// What the renderer's memory is for, every allocation it makes is counted under one of these
+enum class MemoryTag : uint32_t
+{
+	// Colour, G-buffer, visibility and post-processing buffers, and the colour samples
+	Framebuffer,
+	// Depth buffer and depth samples
+	Depth,
+	// Vertex and index streams, of the meshes and of the ones that are still being loaded, and what the OBJ
+	// parser needs on the way
+	Mesh,
+	Bvh,
+	// Resident mip levels, and the whole mip chain while a texture file gets built
+	Texture,
+	// The objects, their bounds and the lights
+	Scene,
+	// Scratch that gets reused from one frame to the next, like the vertex outputs and the light grid
+	Frame,
+	// Queued tasks and what ParallelFor shares between threads
+	Jobs,
+	Count
+};
+
+// Mapped files don't count, those pages belong to the OS and it can drop them whenever it likes
+struct MemoryStats
+{
+	size_t currentBytes{ 0 };
+	size_t peakBytes{ 0 };
+	// Live ones, not how many there ever were
+	size_t allocationCount{ 0 };
+};
+
+// Thread-safe, and cheap enough for every allocation
+void TrackAllocation( const MemoryTag& tag, const size_t& bytes );
+void TrackFree( const MemoryTag& tag, const size_t& bytes );
+
+MemoryStats GetMemoryStats( const MemoryTag& tag );
+// Of all of the tags together, the peak is when the total was highest, not the sum of their peaks
+MemoryStats GetTotalMemoryStats();
+const char* GetMemoryTagName( const MemoryTag& tag );
+
+// Cache line aligned, and the size doesn't have to be a multiple of anything
+// Throws std::bad_alloc if there isn't enough memory, only 0 bytes give back null
+void* AllocateAligned( const size_t& bytes, const MemoryTag& tag );
+// With the same size and tag it was allocated with
+void FreeAligned( void* memory, const size_t& bytes, const MemoryTag& tag );
+
+// For standard containers, so their memory gets counted too
+template<typename T, MemoryTag Tag>
+class TrackedAllocator
+{
+public:
+	using value_type = T;
+
+	template<typename U>
+	struct rebind
+	{
+		using other = TrackedAllocator<U, Tag>;
+	};
+
+	TrackedAllocator() = default;
+	template<typename U>
+	TrackedAllocator( const TrackedAllocator<U, Tag>& )
+	{
+	}
+
+	T* allocate( const size_t count )
+	{
+		T* const memory = static_cast<T*>( ::operator new( count * sizeof( T ) ) );
+		TrackAllocation( Tag, count * sizeof( T ) );
+		return memory;
+	}
+
+	void deallocate( T* const memory, const size_t count )
+	{
+		TrackFree( Tag, count * sizeof( T ) );
+		::operator delete( memory );
+	}
+
+	template<typename U>
+	bool operator==( const TrackedAllocator<U, Tag>& ) const
+	{
+		return true;
+	}
+
+	template<typename U>
+	bool operator!=( const TrackedAllocator<U, Tag>& ) const
+	{
+		return false;
+	}
+};
+
+template<typename T, MemoryTag Tag>
+using TrackedVector = std::vector<T, TrackedAllocator<T, Tag>>;
+
+// Heap array aligned to a cache line, so SIMD loads and stores never straddle two lines
+template<typename T>
+class AlignedArray
+{
+public:
+	explicit AlignedArray( const MemoryTag& memoryTag )
+		: tag( memoryTag )
+	{
+	}
+
+	~AlignedArray()
+	{
+		Free();
+	}
+
+	AlignedArray( const AlignedArray& ) = delete;
+	AlignedArray& operator=( const AlignedArray& ) = delete;
+
+	// Throws std::bad_alloc if there isn't enough memory, the array is empty then
+	void Allocate( const size_t& count )
+	{
+		Free();
+		if ( count > SIZE_MAX / sizeof( T ) )
+		{
+			throw std::bad_alloc();
+		}
+		data = static_cast<T*>( AllocateAligned( count * sizeof( T ), tag ) );
+		size = count;
+	}
+
+	void Free()
+	{
+		FreeAligned( data, size * sizeof( T ), tag );
+		data = nullptr;
+		size = 0;
+	}
+
+	// Just the pointers change hands, the tags stay where they are, so if they differ the accounting moves over
+	void Swap( AlignedArray& other )
+	{
+		if ( tag != other.tag )
+		{
+			if ( data != nullptr )
+			{
+				TrackFree( tag, size * sizeof( T ) );
+				TrackAllocation( other.tag, size * sizeof( T ) );
+			}
+			if ( other.data != nullptr )
+			{
+				TrackFree( other.tag, other.size * sizeof( T ) );
+				TrackAllocation( tag, other.size * sizeof( T ) );
+			}
+		}
+
+		T* const otherData = other.data;
+		const size_t otherSize = other.size;
+		other.data = data;
+		other.size = size;
+		data = otherData;
+		size = otherSize;
+	}
+
+	T* Get() const
+	{
+		return data;
+	}
+
+	size_t GetSize() const
+	{
+		return size;
+	}
+
+	T& operator[]( const size_t& index ) const
+	{
+		return data[index];
+	}
+
+private:
+	T* data{ nullptr };
+	size_t size{ 0 };
+	MemoryTag tag;
+};
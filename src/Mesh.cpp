@@ -0,0 +1,86 @@
+
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
+
+// Out of line, so the header doesn't need the full MappedFile
+Mesh::Mesh() = default;
+Mesh::~Mesh() = default;
+Mesh::Mesh( Mesh&& ) = default;
+Mesh& Mesh::operator=( Mesh&& ) = default;
+
+Mesh Mesh::FromTriangles( const std::vector<Triangle>& triangles )
+{
+	// Each triangle gets half of the texture, and its face normal at every corner
+	const glm::vec2 cornerTexCoords[3]{ { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f } };
+
+	MeshStreams streams;
+	streams.positions.reserve( triangles.size() * 3 );
+	streams.normals.reserve( triangles.size() * 3 );
+	streams.texCoords.reserve( triangles.size() * 3 );
+	streams.indices.reserve( triangles.size() * 3 );
+
+	for ( const Triangle& tri : triangles )
+	{
+		const glm::vec3 cross = glm::cross( tri.verts[1] - tri.verts[0], tri.verts[2] - tri.verts[0] );
+		const float length = glm::length( cross );
+		const glm::vec3 normal = length > 0.0f ? cross / length : glm::vec3( 0.0f, 0.0f, 1.0f );
+
+		for ( int corner = 0; corner < 3; corner++ )
+		{
+			streams.indices.push_back( streams.positions.size() );
+			streams.positions.push_back( tri.verts[corner] );
+			streams.normals.push_back( normal );
+			streams.texCoords.push_back( cornerTexCoords[corner] );
+		}
+	}
+
+	Mesh mesh;
+	mesh.Create( std::move( streams ) );
+	return mesh;
+}
+
+void Mesh::Create( MeshStreams&& newStreams )
+{
+	mappedFile.reset();
+	streams = std::move( newStreams );
+
+	positions = streams.positions.data();
+	normals = streams.normals.empty() ? nullptr : streams.normals.data();
+	texCoords = streams.texCoords.empty() ? nullptr : streams.texCoords.data();
+	indices = streams.indices.data();
+	vertexCount = streams.positions.size();
+	indexCount = streams.indices.size();
+
+	const uint32_t triangleCount = GetTriangleCount();
+	TrackedVector<Aabb, MemoryTag::Bvh> triangleBounds( triangleCount );
+
+	bounds = Aabb();
+	for ( uint32_t i = 0; i < triangleCount; i++ )
+	{
+		for ( uint32_t corner = 0; corner < 3; corner++ )
+		{
+			triangleBounds[i].Add( positions[indices[i * 3 + corner]] );
+		}
+		bounds.Add( triangleBounds[i] );
+	}
+
+	bvh.Build( triangleBounds.data(), triangleCount );
+}
+
+void Mesh::CreateMapped( std::unique_ptr<MappedFile> file, const uint32_t& newVertexCount, const uint32_t& newIndexCount,
+	const glm::vec3* newPositions, const glm::vec3* newNormals, const glm::vec2* newTexCoords, const uint32_t* newIndices,
+	const Aabb& newBounds, const BvhNode* nodes, const uint32_t& nodeCount, const uint32_t* primitiveIndices )
+{
+	streams = MeshStreams();
+	mappedFile = std::move( file );
+
+	positions = newPositions;
+	normals = newNormals;
+	texCoords = newTexCoords;
+	indices = newIndices;
+	vertexCount = newVertexCount;
+	indexCount = newIndexCount;
+
+	bounds = newBounds;
+	bvh.SetExternal( nodes, nodeCount, primitiveIndices );
+}
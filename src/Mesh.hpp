@@ -0,0 +1,113 @@
+
+#pragma once
+
+#include <memory>
+
+#include "Bvh.hpp"
+
+class MappedFile;
+
+struct Triangle
+{
+	glm::vec3 verts[3];
+};
+
+// Vertex and index streams, as they get built up by a loader
+struct MeshStreams
+{
+	TrackedVector<glm::vec3, MemoryTag::Mesh> positions;
+	// Either empty or one per vertex
+	TrackedVector<glm::vec3, MemoryTag::Mesh> normals;
+	TrackedVector<glm::vec2, MemoryTag::Mesh> texCoords;
+	// 3 per triangle
+	TrackedVector<uint32_t, MemoryTag::Mesh> indices;
+};
+
+// An indexed triangle mesh, with a separate stream for each vertex attribute
+// The streams either belong to the mesh, or point straight into a mapped cache file
+class Mesh
+{
+public:
+	Mesh();
+	~Mesh();
+	// The views point into the streams' buffers, which survive a move but not a copy
+	Mesh( const Mesh& ) = delete;
+	Mesh& operator=( const Mesh& ) = delete;
+	Mesh( Mesh&& );
+	Mesh& operator=( Mesh&& );
+
+	// Unindexed, every triangle gets its own 3 vertices, with flat normals and made-up texcoords
+	static Mesh FromTriangles( const std::vector<Triangle>& triangles );
+
+	// Takes the streams over, then computes the bounds and builds the triangle BVH
+	void Create( MeshStreams&& streams );
+
+	// Uses data that's already laid out in memory, all of it including the BVH, without copying any of it
+	// The mesh keeps the file open for as long as it lives. Normals and texcoords may be null
+	void CreateMapped( std::unique_ptr<MappedFile> file, const uint32_t& vertexCount, const uint32_t& indexCount,
+		const glm::vec3* positions, const glm::vec3* normals, const glm::vec2* texCoords, const uint32_t* indices,
+		const Aabb& bounds, const BvhNode* nodes, const uint32_t& nodeCount, const uint32_t* primitiveIndices );
+
+	uint32_t GetVertexCount() const
+	{
+		return vertexCount;
+	}
+
+	uint32_t GetTriangleCount() const
+	{
+		return indexCount / 3;
+	}
+
+	Triangle GetTriangle( const uint32_t& index ) const
+	{
+		return Triangle{ { positions[indices[index * 3]], positions[indices[index * 3 + 1]], positions[indices[index * 3 + 2]] } };
+	}
+
+	const glm::vec3* GetPositions() const
+	{
+		return positions;
+	}
+
+	// Null if the mesh has none
+	const glm::vec3* GetNormals() const
+	{
+		return normals;
+	}
+
+	// Null if the mesh has none
+	const glm::vec2* GetTexCoords() const
+	{
+		return texCoords;
+	}
+
+	const uint32_t* GetIndices() const
+	{
+		return indices;
+	}
+
+	// In model space
+	const Aabb& GetBounds() const
+	{
+		return bounds;
+	}
+
+	const Bvh& GetBvh() const
+	{
+		return bvh;
+	}
+
+private:
+	const glm::vec3* positions{ nullptr };
+	const glm::vec3* normals{ nullptr };
+	const glm::vec2* texCoords{ nullptr };
+	const uint32_t* indices{ nullptr };
+	uint32_t vertexCount{ 0 };
+	uint32_t indexCount{ 0 };
+
+	Aabb bounds;
+	Bvh bvh;
+
+	// Whichever one backs the views above
+	MeshStreams streams;
+	std::unique_ptr<MappedFile> mappedFile;
+};
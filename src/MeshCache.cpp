@@ -0,0 +1,193 @@
+
+#include <cstdio>
+#include <string>
+
+#include "MappedFile.hpp"
+#include "MeshCache.hpp"
+#include "ObjLoader.hpp"
+
+constexpr uint32_t MeshCacheHeader::Magic;
+constexpr uint32_t MeshCacheHeader::CurrentVersion;
+
+namespace
+{
+	constexpr uint64_t StreamAlignment = 64;
+
+	uint64_t AlignUp( const uint64_t& offset )
+	{
+		return (offset + StreamAlignment - 1) & ~(StreamAlignment - 1);
+	}
+
+	// Checks that a stream lies within the file and is aligned the way the writer aligns it
+	// Empty ones, of empty meshes, are never read, so they can be anywhere
+	bool IsStreamValid( const uint64_t& offset, const uint64_t& size, const uint64_t& fileSize )
+	{
+		return size == 0 || (offset != 0 && offset % StreamAlignment == 0 && offset <= fileSize && size <= fileSize - offset);
+	}
+}
+
+bool LoadMeshCache( const char* path, const char* sourcePath, Mesh& outMesh )
+{
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if ( !GetFileStamp( sourcePath, sourceSize, sourceTime ) )
+	{
+		return false;
+	}
+
+	std::unique_ptr<MappedFile> file( new MappedFile() );
+	if ( !file->Open( path ) || file->GetSize() < sizeof( MeshCacheHeader ) )
+	{
+		return false;
+	}
+
+	const char* data = file->GetData();
+	const uint64_t fileSize = file->GetSize();
+	const MeshCacheHeader& header = *reinterpret_cast<const MeshCacheHeader*>( data );
+
+	if ( header.magic != MeshCacheHeader::Magic || header.version != MeshCacheHeader::CurrentVersion
+		|| header.sourceSize != sourceSize || header.sourceTime != sourceTime
+		|| header.indexCount % 3 != 0 )
+	{
+		return false;
+	}
+
+	const uint64_t triangleCount = header.indexCount / 3;
+	const uint64_t vertexCount = header.vertexCount;
+	if ( !IsStreamValid( header.positionsOffset, vertexCount * sizeof( glm::vec3 ), fileSize )
+		|| !IsStreamValid( header.indicesOffset, header.indexCount * sizeof( uint32_t ), fileSize )
+		|| !IsStreamValid( header.nodesOffset, header.nodeCount * sizeof( BvhNode ), fileSize )
+		|| !IsStreamValid( header.primitiveIndicesOffset, triangleCount * sizeof( uint32_t ), fileSize ) )
+	{
+		return false;
+	}
+
+	if ( (header.normalsOffset && !IsStreamValid( header.normalsOffset, vertexCount * sizeof( glm::vec3 ), fileSize ))
+		|| (header.texCoordsOffset && !IsStreamValid( header.texCoordsOffset, vertexCount * sizeof( glm::vec2 ), fileSize )) )
+	{
+		return false;
+	}
+
+	const auto stream = [data]( const uint64_t& offset )
+	{
+		return offset ? data + offset : nullptr;
+	};
+
+	const uint32_t* indices = reinterpret_cast<const uint32_t*>( stream( header.indicesOffset ) );
+	const BvhNode* nodes = reinterpret_cast<const BvhNode*>( stream( header.nodesOffset ) );
+	const uint32_t* primitiveIndices = reinterpret_cast<const uint32_t*>( stream( header.primitiveIndicesOffset ) );
+
+	// Nothing downstream checks these, so a cache that got corrupted without its stamp changing has to be
+	// caught here, and then the OBJ gets parsed again
+	for ( uint32_t i = 0; i < header.indexCount; i++ )
+	{
+		if ( indices[i] >= vertexCount )
+		{
+			return false;
+		}
+	}
+	if ( !Bvh::IsValidLayout( nodes, header.nodeCount, primitiveIndices, uint32_t( triangleCount ) ) )
+	{
+		return false;
+	}
+
+	outMesh.CreateMapped( std::move( file ), header.vertexCount, header.indexCount,
+		reinterpret_cast<const glm::vec3*>( stream( header.positionsOffset ) ),
+		reinterpret_cast<const glm::vec3*>( stream( header.normalsOffset ) ),
+		reinterpret_cast<const glm::vec2*>( stream( header.texCoordsOffset ) ),
+		indices, header.bounds, nodes, header.nodeCount, primitiveIndices );
+
+	return true;
+}
+
+bool WriteMeshCache( const char* path, const char* sourcePath, const Mesh& mesh )
+{
+	MeshCacheHeader header{};
+	header.magic = MeshCacheHeader::Magic;
+	header.version = MeshCacheHeader::CurrentVersion;
+	if ( !GetFileStamp( sourcePath, header.sourceSize, header.sourceTime ) )
+	{
+		return false;
+	}
+
+	header.vertexCount = mesh.GetVertexCount();
+	header.indexCount = mesh.GetTriangleCount() * 3;
+	header.nodeCount = mesh.GetBvh().GetNodeCount();
+	header.bounds = mesh.GetBounds();
+
+	struct Stream
+	{
+		const void* data;
+		uint64_t size;
+		uint64_t* offset;
+	};
+
+	const Stream streams[]
+	{
+		{ mesh.GetPositions(), header.vertexCount * sizeof( glm::vec3 ), &header.positionsOffset },
+		{ mesh.GetNormals(), header.vertexCount * sizeof( glm::vec3 ), &header.normalsOffset },
+		{ mesh.GetTexCoords(), header.vertexCount * sizeof( glm::vec2 ), &header.texCoordsOffset },
+		{ mesh.GetIndices(), header.indexCount * sizeof( uint32_t ), &header.indicesOffset },
+		{ mesh.GetBvh().GetNodes(), header.nodeCount * sizeof( BvhNode ), &header.nodesOffset },
+		{ mesh.GetBvh().GetPrimitiveIndices(), mesh.GetTriangleCount() * sizeof( uint32_t ), &header.primitiveIndicesOffset }
+	};
+
+	// Lay everything out first, so the header can go in with the final offsets
+	uint64_t offset = sizeof( MeshCacheHeader );
+	for ( const Stream& stream : streams )
+	{
+		if ( stream.data != nullptr )
+		{
+			offset = AlignUp( offset );
+			*stream.offset = offset;
+			offset += stream.size;
+		}
+	}
+
+	// Into a file of its own first, then renamed over the cache, so a crash or another process loading or
+	// caching the mesh at the same time never sees a half-written cache
+	std::string temporaryPath;
+	std::FILE* file = CreateTemporaryFile( path, temporaryPath );
+	if ( file == nullptr )
+	{
+		return false;
+	}
+
+	static const char zeroes[StreamAlignment]{};
+	bool ok = std::fwrite( &header, sizeof( header ), 1, file ) == 1;
+	offset = sizeof( MeshCacheHeader );
+	for ( const Stream& stream : streams )
+	{
+		if ( stream.data == nullptr || !ok )
+		{
+			continue;
+		}
+
+		const uint64_t padding = *stream.offset - offset;
+		ok = std::fwrite( zeroes, 1, padding, file ) == padding
+			&& std::fwrite( stream.data, 1, stream.size, file ) == stream.size;
+		offset = *stream.offset + stream.size;
+	}
+
+	ok = (std::fclose( file ) == 0) && ok;
+	// Doesn't leave a truncated file behind if anything failed
+	return CommitTemporaryFile( temporaryPath, path, ok );
+}
+
+bool LoadMesh( const char* path, Mesh& outMesh )
+{
+	const std::string cachePath = std::string( path ) + ".srmesh";
+	if ( LoadMeshCache( cachePath.c_str(), path, outMesh ) )
+	{
+		return true;
+	}
+
+	if ( !LoadObj( path, outMesh ) )
+	{
+		return false;
+	}
+
+	// Not being able to write it (e.g. a read-only directory) only costs time on the next load
+	WriteMeshCache( cachePath.c_str(), path, outMesh );
+	return true;
+}
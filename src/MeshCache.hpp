@@ -0,0 +1,53 @@
+
+#pragma once
+
+#include "Mesh.hpp"
+
+// Binary mesh caches are laid out exactly like a Mesh is in memory, so loading one is just
+// mapping the file and pointing the mesh at it. Every stream starts on a 64-byte boundary
+//
+// MeshCacheHeader
+// positions          vec3 x vertexCount
+// normals            vec3 x vertexCount (optional)
+// texCoords          vec2 x vertexCount (optional)
+// indices            uint32 x indexCount
+// BVH nodes          BvhNode x nodeCount
+// BVH primitives     uint32 x indexCount / 3
+struct MeshCacheHeader
+{
+	static constexpr uint32_t Magic = 'S' | ('R' << 8) | ('M' << 16) | ('C' << 24);
+	// Bump this whenever the layout, or any of the types in it, change
+	static constexpr uint32_t CurrentVersion = 1;
+
+	uint32_t magic;
+	uint32_t version;
+
+	// Size and modification time of the file the cache was made from, to detect stale caches
+	uint64_t sourceSize;
+	int64_t sourceTime;
+
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t nodeCount;
+	uint32_t padding;
+
+	Aabb bounds;
+
+	// From the start of the file, 0 when a stream isn't there
+	uint64_t positionsOffset;
+	uint64_t normalsOffset;
+	uint64_t texCoordsOffset;
+	uint64_t indicesOffset;
+	uint64_t nodesOffset;
+	uint64_t primitiveIndicesOffset;
+};
+
+// Maps the cache and points the mesh into it
+// Fails if it's missing, broken, from another version, or older than the file at sourcePath
+bool LoadMeshCache( const char* path, const char* sourcePath, Mesh& outMesh );
+
+bool WriteMeshCache( const char* path, const char* sourcePath, const Mesh& mesh );
+
+// Loads a mesh from its cache next to it (path + ".srmesh") if there's an up-to-date one,
+// otherwise parses the OBJ and writes the cache for next time
+bool LoadMesh( const char* path, Mesh& outMesh );
@@ -0,0 +1,425 @@
+
+#include <cmath>
+
+#include "MappedFile.hpp"
+#include "ObjLoader.hpp"
+
+namespace
+{
+	// The parsers below work directly on the mapped file, which isn't null-terminated,
+	// and they don't allocate or care about the locale, unlike strtof and friends
+
+	inline bool IsDigit( const char& c )
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline void SkipSpaces( const char*& p, const char* end )
+	{
+		while ( p < end && (*p == ' ' || *p == '\t') )
+		{
+			p++;
+		}
+	}
+
+	inline void SkipLine( const char*& p, const char* end )
+	{
+		while ( p < end && *p != '\n' )
+		{
+			p++;
+		}
+	}
+
+	double PowerOf10( const int& exponent )
+	{
+		// These are all exactly representable
+		static const double table[]
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+			1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		if ( exponent >= 0 && exponent <= 22 )
+		{
+			return table[exponent];
+		}
+		if ( exponent < 0 && exponent >= -22 )
+		{
+			return 1.0 / table[-exponent];
+		}
+		return std::pow( 10.0, exponent );
+	}
+
+	bool ParseFloat( const char*& p, const char* end, float& out )
+	{
+		SkipSpaces( p, end );
+
+		bool negative = false;
+		if ( p < end && (*p == '-' || *p == '+') )
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		// Up to 19 significant digits fit into the mantissa, the rest only shift the exponent
+		uint64_t mantissa = 0;
+		int significantDigits = 0;
+		int exponent = 0;
+		bool anyDigits = false;
+
+		while ( p < end && IsDigit( *p ) )
+		{
+			if ( significantDigits < 19 )
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				significantDigits += mantissa != 0;
+			}
+			else
+			{
+				exponent++;
+			}
+			anyDigits = true;
+			p++;
+		}
+
+		if ( p < end && *p == '.' )
+		{
+			p++;
+			while ( p < end && IsDigit( *p ) )
+			{
+				if ( significantDigits < 19 )
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					significantDigits += mantissa != 0;
+					exponent--;
+				}
+				anyDigits = true;
+				p++;
+			}
+		}
+
+		if ( !anyDigits )
+		{
+			return false;
+		}
+
+		if ( p < end && (*p == 'e' || *p == 'E') )
+		{
+			p++;
+			bool negativeExponent = false;
+			if ( p < end && (*p == '-' || *p == '+') )
+			{
+				negativeExponent = *p == '-';
+				p++;
+			}
+
+			int explicitExponent = 0;
+			while ( p < end && IsDigit( *p ) )
+			{
+				if ( explicitExponent < 10000 )
+				{
+					explicitExponent = explicitExponent * 10 + (*p - '0');
+				}
+				p++;
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+		}
+
+		const double value = double( mantissa ) * PowerOf10( exponent );
+		out = float( negative ? -value : value );
+		return true;
+	}
+
+	bool ParseInt( const char*& p, const char* end, int& out )
+	{
+		bool negative = false;
+		if ( p < end && (*p == '-' || *p == '+') )
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		if ( p >= end || !IsDigit( *p ) )
+		{
+			return false;
+		}
+
+		int64_t value = 0;
+		while ( p < end && IsDigit( *p ) )
+		{
+			value = value * 10 + (*p - '0');
+			if ( value > INT32_MAX )
+			{
+				return false;
+			}
+			p++;
+		}
+
+		out = int( negative ? -value : value );
+		return true;
+	}
+
+	// OBJ indices are 1-based, and negative ones are relative to the end of the list so far
+	// Returns -1 if it's out of range
+	int ResolveIndex( const int& index, const size_t& count )
+	{
+		const int64_t resolved = index < 0 ? int64_t( count ) + index : int64_t( index ) - 1;
+		return (resolved >= 0 && resolved < int64_t( count )) ? int( resolved ) : -1;
+	}
+
+	// Maps position/texcoord/normal index triplets to output vertices
+	// Open addressing, since std::unordered_map allocates a node for every single vertex
+	class VertexCache
+	{
+	public:
+		struct Key
+		{
+			bool operator==( const Key& other ) const
+			{
+				return position == other.position && texCoord == other.texCoord && normal == other.normal;
+			}
+
+			int position;
+			int texCoord;
+			int normal;
+		};
+
+		VertexCache()
+		{
+			slots.resize( 1 << 16 );
+		}
+
+		// Returns false if this combination hasn't been seen yet
+		bool Find( const Key& key, uint32_t& outVertex )
+		{
+			const uint32_t mask = slots.size() - 1;
+			uint32_t slot = Hash( key ) & mask;
+			while ( slots[slot].vertex != Empty )
+			{
+				if ( slots[slot].key == key )
+				{
+					outVertex = slots[slot].vertex;
+					return true;
+				}
+				slot = (slot + 1) & mask;
+			}
+			return false;
+		}
+
+		void Insert( const Key& key, const uint32_t& vertex )
+		{
+			// Keep it at most half full, so probe chains stay short
+			if ( (count + 1) * 2 > slots.size() )
+			{
+				Grow();
+			}
+
+			Place( key, vertex );
+			count++;
+		}
+
+	private:
+		static constexpr uint32_t Empty = ~0U;
+
+		struct Slot
+		{
+			Key key{ 0, 0, 0 };
+			uint32_t vertex{ Empty };
+		};
+
+		static uint32_t Hash( const Key& key )
+		{
+			uint32_t hash = uint32_t( key.position ) * 0x9E3779B1U;
+			hash ^= uint32_t( key.texCoord ) * 0x85EBCA77U;
+			hash ^= uint32_t( key.normal ) * 0xC2B2AE3DU;
+			return hash ^ (hash >> 15);
+		}
+
+		void Place( const Key& key, const uint32_t& vertex )
+		{
+			const uint32_t mask = slots.size() - 1;
+			uint32_t slot = Hash( key ) & mask;
+			while ( slots[slot].vertex != Empty )
+			{
+				slot = (slot + 1) & mask;
+			}
+			slots[slot].key = key;
+			slots[slot].vertex = vertex;
+		}
+
+		void Grow()
+		{
+			TrackedVector<Slot, MemoryTag::Mesh> oldSlots( slots.size() * 2 );
+			oldSlots.swap( slots );
+			for ( const Slot& slot : oldSlots )
+			{
+				if ( slot.vertex != Empty )
+				{
+					Place( slot.key, slot.vertex );
+				}
+			}
+		}
+
+		TrackedVector<Slot, MemoryTag::Mesh> slots;
+		size_t count{ 0 };
+	};
+}
+
+bool LoadObj( const char* path, Mesh& outMesh )
+{
+	MappedFile file;
+	if ( !file.Open( path, true ) )
+	{
+		return false;
+	}
+
+	const char* p = file.GetData();
+	const char* end = p + file.GetSize();
+
+	// As they appear in the file, before deduplication
+	TrackedVector<glm::vec3, MemoryTag::Mesh> positions;
+	TrackedVector<glm::vec2, MemoryTag::Mesh> texCoords;
+	TrackedVector<glm::vec3, MemoryTag::Mesh> normals;
+
+	MeshStreams mesh;
+	VertexCache cache;
+	// Output vertices of the face currently being parsed, reused between faces
+	TrackedVector<uint32_t, MemoryTag::Mesh> polygon;
+
+	while ( p < end )
+	{
+		SkipSpaces( p, end );
+		if ( p >= end )
+		{
+			break;
+		}
+
+		const char first = *p;
+		const char second = p + 1 < end ? p[1] : '\n';
+
+		if ( first == 'v' && (second == ' ' || second == '\t') )
+		{
+			p += 2;
+			glm::vec3 position;
+			if ( !ParseFloat( p, end, position.x ) || !ParseFloat( p, end, position.y ) || !ParseFloat( p, end, position.z ) )
+			{
+				return false;
+			}
+			positions.push_back( position );
+		}
+		else if ( first == 'v' && second == 't' )
+		{
+			p += 2;
+			glm::vec2 texCoord;
+			if ( !ParseFloat( p, end, texCoord.x ) )
+			{
+				return false;
+			}
+			// The V coordinate is optional
+			const char* before = p;
+			if ( !ParseFloat( p, end, texCoord.y ) )
+			{
+				p = before;
+				texCoord.y = 0.0f;
+			}
+			texCoords.push_back( texCoord );
+		}
+		else if ( first == 'v' && second == 'n' )
+		{
+			p += 2;
+			glm::vec3 normal;
+			if ( !ParseFloat( p, end, normal.x ) || !ParseFloat( p, end, normal.y ) || !ParseFloat( p, end, normal.z ) )
+			{
+				return false;
+			}
+			normals.push_back( normal );
+		}
+		else if ( first == 'f' && (second == ' ' || second == '\t') )
+		{
+			p += 2;
+			polygon.clear();
+
+			while ( true )
+			{
+				SkipSpaces( p, end );
+				if ( p >= end || *p == '\n' || *p == '\r' || *p == '#' )
+				{
+					break;
+				}
+
+				// v, v/vt, v//vn or v/vt/vn
+				VertexCache::Key key{ -1, -1, -1 };
+				int index;
+				if ( !ParseInt( p, end, index ) || (key.position = ResolveIndex( index, positions.size() )) < 0 )
+				{
+					return false;
+				}
+
+				if ( p < end && *p == '/' )
+				{
+					p++;
+					if ( p < end && *p != '/' )
+					{
+						if ( !ParseInt( p, end, index ) || (key.texCoord = ResolveIndex( index, texCoords.size() )) < 0 )
+						{
+							return false;
+						}
+					}
+
+					if ( p < end && *p == '/' )
+					{
+						p++;
+						if ( !ParseInt( p, end, index ) || (key.normal = ResolveIndex( index, normals.size() )) < 0 )
+						{
+							return false;
+						}
+					}
+				}
+
+				uint32_t vertex;
+				if ( !cache.Find( key, vertex ) )
+				{
+					vertex = mesh.positions.size();
+					cache.Insert( key, vertex );
+
+					mesh.positions.push_back( positions[key.position] );
+					if ( !texCoords.empty() )
+					{
+						mesh.texCoords.push_back( key.texCoord >= 0 ? texCoords[key.texCoord] : glm::vec2( 0.0f ) );
+					}
+					if ( !normals.empty() )
+					{
+						mesh.normals.push_back( key.normal >= 0 ? normals[key.normal] : glm::vec3( 0.0f ) );
+					}
+				}
+
+				polygon.push_back( vertex );
+			}
+
+			// Fan it out
+			for ( size_t i = 2; i < polygon.size(); i++ )
+			{
+				mesh.indices.push_back( polygon[0] );
+				mesh.indices.push_back( polygon[i - 1] );
+				mesh.indices.push_back( polygon[i] );
+			}
+		}
+
+		SkipLine( p, end );
+		p++;
+	}
+
+	// Texcoords or normals that only showed up after some faces were already read leave
+	// the streams incomplete, in which case they're better off gone entirely
+	if ( mesh.texCoords.size() != mesh.positions.size() )
+	{
+		mesh.texCoords.clear();
+	}
+	if ( mesh.normals.size() != mesh.positions.size() )
+	{
+		mesh.normals.clear();
+	}
+
+	outMesh.Create( std::move( mesh ) );
+	return true;
+}
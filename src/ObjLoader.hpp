@@ -0,0 +1,9 @@
+
+#pragma once
+
+#include "Mesh.hpp"
+
+// Loads a Wavefront OBJ file into an indexed mesh
+// Vertices sharing the same position/texcoord/normal indices are merged, polygons are fanned into triangles
+// Everything other than v, vt, vn and f is ignored
+bool LoadObj( const char* path, Mesh& outMesh );
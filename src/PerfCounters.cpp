@@ -0,0 +1,217 @@
+
+#include <algorithm>
+
+#include "PerfCounters.hpp"
+
+#if defined( __linux__ )
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define THE_PERF_EVENTS 1
+#else
+#define THE_PERF_EVENTS 0
+#endif
+
+constexpr uint32_t PerfCounters::MaxStages;
+constexpr uint32_t PerfCounters::MaxThreads;
+
+namespace
+{
+#if THE_PERF_EVENTS
+	const uint64_t EventConfigs[PerfEventCount]
+	{
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	// One group per thread, so all of its counters get read at once and count over the same time
+	struct ThreadCounters
+	{
+		bool opened{ false };
+		int groupFd{ -1 };
+		int fds[PerfEventCount];
+		// Which event each value of a group read is, the ones that couldn't be opened are left out
+		uint32_t events[PerfEventCount];
+		uint32_t eventCount{ 0 };
+		uint64_t last[PerfEventCount]{};
+		uint32_t thread{ 0 };
+
+		~ThreadCounters()
+		{
+			for ( uint32_t i = 0; i < eventCount; i++ )
+			{
+				close( fds[i] );
+			}
+		}
+
+		void Open( const bool* wanted )
+		{
+			opened = true;
+			for ( uint32_t event = 0; event < PerfEventCount; event++ )
+			{
+				if ( !wanted[event] )
+				{
+					continue;
+				}
+
+				perf_event_attr attributes{};
+				attributes.size = sizeof( attributes );
+				attributes.type = PERF_TYPE_HARDWARE;
+				attributes.config = EventConfigs[event];
+				attributes.exclude_kernel = 1;
+				attributes.exclude_hv = 1;
+				attributes.read_format = PERF_FORMAT_GROUP;
+				// This thread, on whichever CPU it runs
+				const int fd = int( syscall( __NR_perf_event_open, &attributes, 0, -1, groupFd, 0 ) );
+				if ( fd < 0 )
+				{
+					continue;
+				}
+
+				if ( groupFd < 0 )
+				{
+					groupFd = fd;
+				}
+				fds[eventCount] = fd;
+				events[eventCount] = event;
+				eventCount++;
+			}
+		}
+
+		// The counts since the last read
+		PerfCounts Read()
+		{
+			PerfCounts delta;
+			uint64_t buffer[1 + PerfEventCount];
+			if ( groupFd < 0 || read( groupFd, buffer, sizeof( buffer ) ) < ssize_t( sizeof( uint64_t ) * (1 + eventCount) ) )
+			{
+				return delta;
+			}
+
+			for ( uint32_t i = 0; i < eventCount && i < buffer[0]; i++ )
+			{
+				const uint32_t event = events[i];
+				delta.values[event] = buffer[1 + i] - last[event];
+				last[event] = buffer[1 + i];
+			}
+			return delta;
+		}
+	};
+
+	thread_local ThreadCounters threadCounters;
+#endif
+}
+
+PerfCounters::PerfCounters()
+{
+	ResetCounts();
+}
+
+bool PerfCounters::Enable()
+{
+#if THE_PERF_EVENTS
+	if ( IsEnabled() )
+	{
+		return true;
+	}
+
+	const bool all[PerfEventCount]{ true, true, true, true };
+	threadCounters.Open( all );
+	threadCounters.thread = threadCount++;
+	for ( uint32_t i = 0; i < threadCounters.eventCount; i++ )
+	{
+		eventAvailable[threadCounters.events[i]] = true;
+	}
+	if ( threadCounters.eventCount == 0 )
+	{
+		return false;
+	}
+
+	threadCounters.Read();
+	enabled.store( true, std::memory_order_release );
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PerfCounters::BeginStage( const uint32_t& stage )
+{
+	Sample();
+	currentStage.store( std::min( stage, MaxStages - 1 ), std::memory_order_relaxed );
+}
+
+void PerfCounters::Sample()
+{
+#if THE_PERF_EVENTS
+	if ( !enabled.load( std::memory_order_acquire ) )
+	{
+		return;
+	}
+
+	if ( !threadCounters.opened )
+	{
+		threadCounters.Open( eventAvailable );
+		threadCounters.thread = threadCount++;
+		threadCounters.Read();
+		return;
+	}
+
+	const PerfCounts delta = threadCounters.Read();
+	const uint32_t stage = currentStage.load( std::memory_order_relaxed );
+	for ( uint32_t event = 0; event < PerfEventCount; event++ )
+	{
+		stageCounts[stage][event].fetch_add( delta.values[event], std::memory_order_relaxed );
+		if ( threadCounters.thread < MaxThreads )
+		{
+			threadCounts[threadCounters.thread][event].fetch_add( delta.values[event], std::memory_order_relaxed );
+		}
+	}
+#endif
+}
+
+PerfCounts PerfCounters::GetStageCounts( const uint32_t& stage ) const
+{
+	PerfCounts counts;
+	for ( uint32_t event = 0; event < PerfEventCount; event++ )
+	{
+		counts.values[event] = stageCounts[stage][event].load( std::memory_order_relaxed );
+	}
+	return counts;
+}
+
+PerfCounts PerfCounters::GetThreadCounts( const uint32_t& thread ) const
+{
+	PerfCounts counts;
+	for ( uint32_t event = 0; event < PerfEventCount; event++ )
+	{
+		counts.values[event] = threadCounts[thread][event].load( std::memory_order_relaxed );
+	}
+	return counts;
+}
+
+void PerfCounters::ResetCounts()
+{
+	for ( auto& stage : stageCounts )
+	{
+		for ( auto& count : stage )
+		{
+			count.store( 0, std::memory_order_relaxed );
+		}
+	}
+	for ( auto& thread : threadCounts )
+	{
+		for ( auto& count : thread )
+		{
+			count.store( 0, std::memory_order_relaxed );
+		}
+	}
+}
+
+PerfCounters& GetPerfCounters()
+{
+	static PerfCounters perfCounters;
+	return perfCounters;
+}
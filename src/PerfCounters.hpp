@@ -0,0 +1,87 @@
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// Hardware performance counters, through perf_event_open, so only on Linux, on machines with a PMU that
+// the kernel lets user space at (a perf_event_paranoid of 2 is enough, only user space gets counted)
+enum class PerfEvent : uint32_t
+{
+	Cycles = 0,
+	Instructions,
+	// Of the last-level cache
+	CacheMisses,
+	BranchMisses,
+	Count
+};
+
+constexpr uint32_t PerfEventCount = uint32_t( PerfEvent::Count );
+
+struct PerfCounts
+{
+	uint64_t values[PerfEventCount]{};
+
+	uint64_t operator[]( const PerfEvent& event ) const
+	{
+		return values[uint32_t( event )];
+	}
+};
+
+// Every thread counts for itself, and whenever it samples, what it did since its last sample goes to the
+// stage that was begun last, and to the thread
+// ThreadPool samples after every task, so what the workers do counts towards the stage they do it for
+class PerfCounters
+{
+public:
+	static constexpr uint32_t MaxStages = 16;
+	static constexpr uint32_t MaxThreads = 64;
+
+	PerfCounters();
+
+	// Opens the calling thread's counters, false if none of them could be, the other threads open theirs the
+	// first time they sample, the calling thread is thread 0
+	bool Enable();
+
+	bool IsEnabled() const
+	{
+		return enabled.load( std::memory_order_relaxed );
+	}
+
+	// Some machines, VMs especially, only have some of them
+	bool IsEventAvailable( const PerfEvent& event ) const
+	{
+		return eventAvailable[uint32_t( event )];
+	}
+
+	// Samples the calling thread, then everything counts towards this stage until the next one begins
+	void BeginStage( const uint32_t& stage );
+
+	// What the calling thread did since its last sample goes towards the current stage and the thread
+	void Sample();
+
+	PerfCounts GetStageCounts( const uint32_t& stage ) const;
+	PerfCounts GetThreadCounts( const uint32_t& thread ) const;
+
+	// That have sampled, up to MaxThreads, the ones after that only count towards the stages
+	uint32_t GetThreadCount() const
+	{
+		return std::min( threadCount.load( std::memory_order_relaxed ), MaxThreads );
+	}
+
+	// Of the stages and threads, e.g. between benchmark runs, the threads keep their numbers
+	void ResetCounts();
+
+private:
+	std::atomic<bool> enabled{ false };
+	bool eventAvailable[PerfEventCount]{};
+	std::atomic<uint32_t> currentStage{ 0 };
+	std::atomic<uint32_t> threadCount{ 0 };
+
+	std::atomic<uint64_t> stageCounts[MaxStages][PerfEventCount];
+	std::atomic<uint64_t> threadCounts[MaxThreads][PerfEventCount];
+};
+
+// The one for the whole process
+PerfCounters& GetPerfCounters();
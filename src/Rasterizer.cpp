@@ -0,0 +1,431 @@
+
+#include <algorithm>
+#include <cstring>
+
+#include "Rasterizer.hpp"
+#include "Texture.hpp"
+
+namespace
+{
+	// Hidden-line draws go over the pool this many vertices at a time, a multiple of the widest packets
+	constexpr uint32_t HiddenLineVertexBatch = 16384;
+	// And this many triangles, few enough to spread over the threads, but not so few that the bins get too many
+	constexpr uint32_t HiddenLineChunkSize = 32768;
+	// How many triangles get binned before they're sorted into rows of tiles
+	constexpr uint32_t HiddenLineBinBatch = 1024;
+
+	TextureLevel SelectTextureLevel( const Texture* texture, const float& lod )
+	{
+		const uint32_t level = texture->SelectLevel( lod );
+		return TextureLevel{ texture->GetLevelTexels( level ), texture->GetWidth( level ), texture->GetHeight( level ) };
+	}
+}
+
+void Rasterizer::Draw( Framebuffer& target, const DrawCall& call )
+{
+	DrawParameters parameters;
+	if ( !SetupDraw( target, call, parameters ) )
+	{
+		return;
+	}
+
+	vertexOutputs.resize( size_t( parameters.vertexCount ) * (4 + MaxVaryings) );
+	parameters.vertexOutputs = vertexOutputs.data();
+
+	const PipelineState& state = call.state;
+	const uint32_t flags = uint32_t( state.depthWrite ) | uint32_t( state.blend ) << 1 | uint32_t( parameters.texture != nullptr ) << 2
+		| uint32_t( target.IsMultisampleEnabled() ) << 3;
+	const uint32_t permutation = uint32_t( state.depthTest ) + uint32_t( DepthTest::Count ) * flags
+		+ DrawStatePermutationCount * (uint32_t( parameters.shader ) + uint32_t( Shader::Count ) * uint32_t( state.cullMode ));
+	GetKernels().draw[permutation]( parameters );
+}
+
+void Rasterizer::DrawDepth( Framebuffer& target, const DrawCall& call )
+{
+	DrawParameters parameters;
+	if ( !SetupDraw( target, call, parameters ) )
+	{
+		return;
+	}
+
+	vertexOutputs.resize( size_t( parameters.vertexCount ) * 4 );
+	parameters.vertexOutputs = vertexOutputs.data();
+	const uint32_t permutation = uint32_t( call.state.cullMode ) + uint32_t( CullMode::Count ) * uint32_t( target.IsMultisampleEnabled() );
+	GetKernels().drawDepth[permutation]( parameters );
+}
+
+void Rasterizer::DrawGBuffer( Framebuffer& target, const DrawCall& call )
+{
+	DrawParameters parameters;
+	if ( !target.IsGBufferEnabled() || !SetupDraw( target, call, parameters ) )
+	{
+		return;
+	}
+
+	if ( parameters.normals == nullptr )
+	{
+		defaultNormals.resize( call.mesh->GetVertexCount(), glm::vec3( 0.0f, 0.0f, 1.0f ) );
+		parameters.normals = &defaultNormals[0].x;
+	}
+
+	vertexOutputs.resize( size_t( parameters.vertexCount ) * (4 + MaxVaryings) );
+	parameters.vertexOutputs = vertexOutputs.data();
+	parameters.normalBuffer = target.GetNormals();
+	parameters.albedoBuffer = target.GetAlbedo();
+	parameters.materialId = GetMaterialId( call.specular, call.shininess );
+
+	const uint32_t permutation = uint32_t( parameters.texture != nullptr ) | uint32_t( call.state.cullMode ) << 1;
+	GetKernels().drawGBuffer[permutation]( parameters );
+}
+
+void Rasterizer::ShadeDeferred( Framebuffer& target, const LightGrid& lights, const glm::mat4& viewProj, ThreadPool& pool )
+{
+	if ( !target.IsGBufferEnabled() || target.GetWidth() == 0 || target.GetHeight() == 0 )
+	{
+		return;
+	}
+
+	DeferredParameters parameters;
+	parameters.colorBuffer = target.GetColor();
+	parameters.depthBuffer = target.GetDepth();
+	parameters.normalBuffer = target.GetNormals();
+	parameters.albedoBuffer = target.GetAlbedo();
+	parameters.width = target.GetWidth();
+	parameters.height = target.GetHeight();
+	parameters.pitch = target.GetPitch();
+	parameters.pendingClear = target.GetPendingClear();
+	parameters.depthSign = target.GetDepthSign();
+	parameters.clearEmptyDepth = target.HasStaleDepth();
+
+	const glm::mat4 inverseViewProj = glm::inverse( viewProj );
+	std::memcpy( parameters.inverseViewProj, &inverseViewProj[0][0], sizeof( parameters.inverseViewProj ) );
+	// The depth buffer only has 1 / w, clip-space z comes back from how it depends on w, which only works
+	// for perspective projections
+	const glm::vec3 zRow( viewProj[0][2], viewProj[1][2], viewProj[2][2] );
+	const glm::vec3 wRow( viewProj[0][3], viewProj[1][3], viewProj[2][3] );
+	const float zScale = glm::dot( zRow, wRow ) / glm::dot( wRow, wRow );
+	parameters.depthToClipZ[0] = zScale;
+	parameters.depthToClipZ[1] = viewProj[3][2] - zScale * viewProj[3][3];
+	parameters.lighting = &lights.GetParameters();
+	parameters.materials = materials.data();
+
+	const uint32_t tilesX = target.GetTilesX();
+	const auto shadeTile = GetKernels().shadeDeferredTile;
+	pool.ParallelFor( tilesX * target.GetTilesY(), [&]( uint32_t tile )
+	{
+		shadeTile( parameters, tile % tilesX, tile / tilesX );
+	} );
+
+	materials.resize( 1 );
+}
+
+void Rasterizer::DrawVisibility( Framebuffer& target, const DrawCall& call )
+{
+	DrawParameters parameters;
+	if ( !target.IsVisibilityEnabled() || !SetupDraw( target, call, parameters ) )
+	{
+		return;
+	}
+
+	// Out of IDs, which takes billions of triangles in one frame
+	if ( parameters.triangleCount > UINT32_MAX - nextVisibilityId )
+	{
+		return;
+	}
+
+	const size_t offset = visibilityVertices.size();
+	visibilityVertices.resize( offset + size_t( parameters.vertexCount ) * (4 + MaxVaryings) );
+	parameters.vertexOutputs = visibilityVertices.data() + offset;
+	parameters.visibilityBuffer = target.GetVisibility();
+	parameters.visibilityId = nextVisibilityId;
+	nextVisibilityId += parameters.triangleCount;
+
+	const uint32_t permutation = uint32_t( parameters.texture != nullptr ) | uint32_t( parameters.shader ) << 1
+		| 2 * uint32_t( Shader::Count ) * uint32_t( call.state.cullMode );
+	GetKernels().drawVisibility[permutation]( parameters );
+
+	visibilityDraws.push_back( parameters );
+	visibilityVertexOffsets.push_back( offset );
+}
+
+void Rasterizer::ResolveVisibility( Framebuffer& target, ThreadPool& pool )
+{
+	if ( target.IsVisibilityEnabled() && target.GetWidth() > 0 && target.GetHeight() > 0 && !visibilityDraws.empty() )
+	{
+		for ( size_t i = 0; i < visibilityDraws.size(); i++ )
+		{
+			visibilityDraws[i].vertexOutputs = visibilityVertices.data() + visibilityVertexOffsets[i];
+		}
+
+		VisibilityParameters parameters;
+		parameters.colorBuffer = target.GetColor();
+		parameters.depthBuffer = target.GetDepth();
+		parameters.visibilityBuffer = target.GetVisibility();
+		parameters.width = target.GetWidth();
+		parameters.height = target.GetHeight();
+		parameters.pitch = target.GetPitch();
+		parameters.pendingClear = target.GetPendingClear();
+		parameters.clearEmptyDepth = target.HasStaleDepth();
+		parameters.draws = visibilityDraws.data();
+		parameters.drawCount = uint32_t( visibilityDraws.size() );
+
+		const uint32_t tilesX = target.GetTilesX();
+		const auto resolveTile = GetKernels().resolveVisibilityTile;
+		pool.ParallelFor( tilesX * target.GetTilesY(), [&]( uint32_t tile )
+		{
+			resolveTile( parameters, tile % tilesX, tile / tilesX );
+		} );
+	}
+
+	visibilityDraws.clear();
+	visibilityVertexOffsets.clear();
+	visibilityVertices.clear();
+	nextVisibilityId = 1;
+}
+
+void Rasterizer::DrawWireframe( Framebuffer& target, const DrawCall& call )
+{
+	DrawParameters parameters;
+	if ( !SetupDraw( target, call, parameters ) )
+	{
+		return;
+	}
+
+	// With where they are on the screen
+	vertexOutputs.resize( size_t( parameters.vertexCount ) * 8 );
+	parameters.vertexOutputs = vertexOutputs.data();
+	parameters.lineDepthBias = call.state.lineDepthBias;
+	// Multisampled, the first sample is as good a depth as any
+	if ( target.IsMultisampleEnabled() )
+	{
+		parameters.depthBuffer = target.GetDepthSamples();
+	}
+	const uint32_t permutation = uint32_t( call.state.depthTest != DepthTest::Off ) | uint32_t( call.state.cullMode ) << 1;
+	GetKernels().drawWireframe[permutation]( parameters );
+}
+
+void Rasterizer::DrawLine( Framebuffer& target, const glm::vec4& from, const glm::vec4& to, const glm::vec4& color )
+{
+	DrawParameters parameters{};
+	if ( !SetupTarget( target, parameters ) )
+	{
+		return;
+	}
+
+	std::memcpy( parameters.color, &color[0], sizeof( parameters.color ) );
+	GetKernels().drawLine[0]( parameters, &from[0], &to[0] );
+}
+
+void Rasterizer::DrawHiddenLines( Framebuffer& target, const DrawCall& call, ThreadPool& pool )
+{
+	DrawParameters parameters;
+	if ( target.IsMultisampleEnabled() || !SetupDraw( target, call, parameters ) )
+	{
+		return;
+	}
+
+	// With where they are on the screen, like for DrawWireframe
+	const size_t offset = hiddenLineVertices.size();
+	hiddenLineVertices.resize( offset + size_t( parameters.vertexCount ) * 8 );
+	parameters.vertexOutputs = hiddenLineVertices.data() + offset;
+	parameters.lineDepthBias = call.state.lineDepthBias;
+
+	const Kernels& kernels = GetKernels();
+	pool.ParallelFor( (parameters.vertexCount + HiddenLineVertexBatch - 1) / HiddenLineVertexBatch, [&]( uint32_t batch )
+	{
+		const uint32_t first = batch * HiddenLineVertexBatch;
+		kernels.shadeHiddenLineVertices( parameters, first, std::min( parameters.vertexCount - first, HiddenLineVertexBatch ) );
+	} );
+
+	// Neighbouring subtrees mostly end up in the same chunk
+	const uint32_t draw = uint32_t( hiddenLineDraws.size() );
+	const size_t firstChunk = hiddenLineChunks.size();
+	const CullMode cullMode = call.state.cullMode;
+	const Bvh& bvh = call.mesh->GetBvh();
+	bvh.CullFrustumRanges( Frustum::FromMatrix( call.modelViewProj ), [&]( uint32_t first, uint32_t count )
+	{
+		if ( hiddenLineChunks.size() > firstChunk )
+		{
+			HiddenLineChunk& last = hiddenLineChunks.back();
+			if ( last.first + last.count == first )
+			{
+				const uint32_t added = std::min( count, HiddenLineChunkSize - last.count );
+				last.count += added;
+				first += added;
+				count -= added;
+			}
+		}
+
+		while ( count > 0 )
+		{
+			const uint32_t added = std::min( count, HiddenLineChunkSize );
+			hiddenLineChunks.push_back( HiddenLineChunk{ draw, first, added, cullMode } );
+			first += added;
+			count -= added;
+		}
+	} );
+
+	const uint32_t bands = (target.GetHeight() + HiddenLineBandHeight - 1) / HiddenLineBandHeight;
+	if ( hiddenLineBins.size() < hiddenLineChunks.size() * bands )
+	{
+		hiddenLineBins.resize( hiddenLineChunks.size() * bands );
+	}
+
+	// Each chunk has its own bins, so they can go in parallel
+	const uint32_t* primitives = bvh.GetPrimitiveIndices();
+	const auto bin = kernels.binHiddenLines[uint32_t( cullMode )];
+	pool.ParallelFor( uint32_t( hiddenLineChunks.size() - firstChunk ), [&]( uint32_t job )
+	{
+		const size_t chunkIndex = firstChunk + job;
+		const HiddenLineChunk& chunk = hiddenLineChunks[chunkIndex];
+		TrackedVector<uint32_t, MemoryTag::Frame>* bins = &hiddenLineBins[chunkIndex * bands];
+
+		HiddenLineTriangle binned[HiddenLineBinBatch];
+		for ( uint32_t done = 0; done < chunk.count; done += HiddenLineBinBatch )
+		{
+			const uint32_t count = bin( parameters, primitives + chunk.first + done, std::min( chunk.count - done, HiddenLineBinBatch ), binned );
+			for ( uint32_t i = 0; i < count; i++ )
+			{
+				for ( uint32_t band = binned[i].firstBand; band <= binned[i].lastBand; band++ )
+				{
+					bins[band].push_back( binned[i].triangle );
+				}
+			}
+		}
+	} );
+
+	hiddenLineDraws.push_back( parameters );
+	hiddenLineVertexOffsets.push_back( offset );
+}
+
+void Rasterizer::ResolveHiddenLines( Framebuffer& target, ThreadPool& pool )
+{
+	const uint32_t bands = (target.GetHeight() + HiddenLineBandHeight - 1) / HiddenLineBandHeight;
+	if ( target.GetWidth() > 0 && bands > 0 && !hiddenLineChunks.empty() )
+	{
+		// The bands don't line up with the tiles, so none of them can be left to clear on the way
+		target.FinishClears( pool );
+		for ( size_t i = 0; i < hiddenLineDraws.size(); i++ )
+		{
+			hiddenLineDraws[i].vertexOutputs = hiddenLineVertices.data() + hiddenLineVertexOffsets[i];
+			hiddenLineDraws[i].pendingClear = nullptr;
+		}
+
+		const Kernels& kernels = GetKernels();
+		pool.ParallelFor( bands, [&]( uint32_t band )
+		{
+			// The depth of all draws first, since any of them can hide the edges of any other
+			for ( size_t i = 0; i < hiddenLineChunks.size(); i++ )
+			{
+				const TrackedVector<uint32_t, MemoryTag::Frame>& triangles = hiddenLineBins[i * bands + band];
+				if ( !triangles.empty() )
+				{
+					kernels.drawHiddenLineDepth[uint32_t( hiddenLineChunks[i].cullMode )]( hiddenLineDraws[hiddenLineChunks[i].draw],
+						triangles.data(), uint32_t( triangles.size() ), band );
+				}
+			}
+			for ( size_t i = 0; i < hiddenLineChunks.size(); i++ )
+			{
+				const TrackedVector<uint32_t, MemoryTag::Frame>& triangles = hiddenLineBins[i * bands + band];
+				if ( !triangles.empty() )
+				{
+					kernels.drawHiddenLineEdges( hiddenLineDraws[hiddenLineChunks[i].draw], triangles.data(), uint32_t( triangles.size() ), band );
+				}
+			}
+		} );
+	}
+
+	for ( size_t i = 0; i < std::min( hiddenLineBins.size(), hiddenLineChunks.size() * bands ); i++ )
+	{
+		hiddenLineBins[i].clear();
+	}
+	hiddenLineDraws.clear();
+	hiddenLineVertexOffsets.clear();
+	hiddenLineVertices.clear();
+	hiddenLineChunks.clear();
+}
+
+bool Rasterizer::SetupTarget( const Framebuffer& target, DrawParameters& parameters )
+{
+	if ( target.GetWidth() == 0 || target.GetHeight() == 0 )
+	{
+		return false;
+	}
+
+	parameters.colorBuffer = target.GetColor();
+	parameters.depthBuffer = target.GetDepth();
+	parameters.normalBuffer = nullptr;
+	parameters.albedoBuffer = nullptr;
+	parameters.visibilityBuffer = nullptr;
+	parameters.width = target.GetWidth();
+	parameters.height = target.GetHeight();
+	parameters.pitch = target.GetPitch();
+	parameters.pendingClear = target.GetPendingClear();
+	parameters.depthSign = target.GetDepthSign();
+	parameters.colorSamples = target.GetColorSamples();
+	parameters.depthSamples = target.GetDepthSamples();
+	parameters.sampleStride = target.GetSampleStride();
+	parameters.lineDepthBias = 0.0f;
+	return true;
+}
+
+bool Rasterizer::SetupDraw( const Framebuffer& target, const DrawCall& call, DrawParameters& parameters )
+{
+	const Mesh* mesh = call.mesh;
+	if ( mesh == nullptr || mesh->GetTriangleCount() == 0 || !SetupTarget( target, parameters ) )
+	{
+		return false;
+	}
+
+	// Attributes the mesh doesn't have are simply not interpolated
+	const PipelineState& state = call.state;
+	const bool textured = state.textured && call.texture != nullptr && call.texture->GetLevelCount() > 0 && mesh->GetTexCoords() != nullptr;
+	const bool lit = state.shader == Shader::Gouraud || state.shader == Shader::BlinnPhong;
+	const bool unlit = mesh->GetNormals() == nullptr || (lit && call.lights == nullptr);
+
+	parameters.positions = &mesh->GetPositions()[0].x;
+	parameters.normals = mesh->GetNormals() != nullptr ? &mesh->GetNormals()[0].x : nullptr;
+	parameters.texCoords = textured ? &mesh->GetTexCoords()[0].x : nullptr;
+	parameters.indices = mesh->GetIndices();
+	parameters.vertexCount = mesh->GetVertexCount();
+	parameters.triangleCount = mesh->GetTriangleCount();
+	parameters.vertexOutputs = nullptr;
+	parameters.visibilityId = 0;
+
+	std::memcpy( parameters.modelViewProj, &call.modelViewProj[0][0], sizeof( parameters.modelViewProj ) );
+	std::memcpy( parameters.model, &call.model[0][0], sizeof( parameters.model ) );
+	const glm::mat3 normalMatrix = glm::transpose( glm::inverse( glm::mat3( call.model ) ) );
+	std::memcpy( parameters.normalMatrix, &normalMatrix[0][0], sizeof( parameters.normalMatrix ) );
+	std::memcpy( parameters.color, &call.color[0], sizeof( parameters.color ) );
+
+	parameters.shader = unlit ? Shader::Unlit : state.shader;
+	parameters.lighting = call.lights != nullptr ? &call.lights->GetParameters() : nullptr;
+	parameters.specular = call.specular;
+	parameters.shininess = call.shininess;
+	parameters.materialId = 0;
+
+	parameters.texture = textured ? call.texture : nullptr;
+	parameters.textureWidth = textured ? call.texture->GetWidth() : 0;
+	parameters.textureHeight = textured ? call.texture->GetHeight() : 0;
+	parameters.selectTextureLevel = &SelectTextureLevel;
+	return true;
+}
+
+uint8_t Rasterizer::GetMaterialId( const float& specular, const float& shininess )
+{
+	for ( size_t i = 1; i < materials.size(); i++ )
+	{
+		if ( materials[i].specular == specular && materials[i].shininess == shininess )
+		{
+			return uint8_t( i );
+		}
+	}
+
+	if ( materials.size() > 255 )
+	{
+		return 255;
+	}
+
+	materials.push_back( MaterialParameters{ specular, shininess } );
+	return uint8_t( materials.size() - 1 );
+}
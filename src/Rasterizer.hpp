@@ -0,0 +1,144 @@
+
+#pragma once
+
+#include "Framebuffer.hpp"
+#include "Kernels.hpp"
+#include "Lighting.hpp"
+#include "Mesh.hpp"
+#include "ThreadPool.hpp"
+
+// Everything that changes what happens per pixel
+// Every combination gets its own specialised loop, so none of these cost a branch in there
+struct PipelineState
+{
+	DepthTest depthTest{ DepthTest::Nearer };
+	bool depthWrite{ true };
+	// Alpha blending over whatever is in the framebuffer already
+	bool blend{ false };
+	// Modulates the colour with the texture, if there is one and the mesh has texcoords
+	bool textured{ false };
+	// Shaders that need normals fall back to unlit on meshes without any, lit ones also without lights
+	Shader shader{ Shader::Unlit };
+	// Triangles that are counter-clockwise on screen are the front faces
+	CullMode cullMode{ CullMode::Back };
+	// Only for DrawWireframe, how much nearer the lines count as than the triangles they're the edges of,
+	// relative to their depth, so they don't disappear into them
+	float lineDepthBias{ 0.0f };
+};
+
+struct DrawCall
+{
+	const Mesh* mesh{ nullptr };
+	glm::mat4 modelViewProj{ 1.0f };
+	// Into world space, which is where the lighting happens
+	glm::mat4 model{ 1.0f };
+	const Texture* texture{ nullptr };
+	// Flat colour, everything else gets multiplied onto it
+	glm::vec4 color{ 1.0f };
+	// Built for the same framebuffer size as the draw goes into
+	const LightGrid* lights{ nullptr };
+	// How bright and how tight the highlights are
+	float specular{ 0.5f };
+	float shininess{ 32.0f };
+	PipelineState state;
+};
+
+// Fills triangles into a Framebuffer, going through the screen tile by tile
+// The actual work happens in the kernels for the best instruction set the CPU has, see Kernels.hpp
+class Rasterizer
+{
+public:
+	// Picks the specialised loop for the draw's pipeline state, then runs the whole mesh through it
+	// Pixels that fail the depth test never get to the pixel shader
+	// Into the target's samples if it's multisampled, the pixel shader still runs once per pixel
+	void Draw( Framebuffer& target, const DrawCall& call );
+
+	// Depth pre-pass: only the depth, which is as cheap as rasterizing gets, ignoring the pipeline state but
+	// for the cull mode
+	// Drawing the same things again with DepthTest::Equal then runs the pixel shader only on what's visible
+	void DrawDepth( Framebuffer& target, const DrawCall& call );
+
+	// Deferred shading: the draws only leave their depth, normals, colour and material in the
+	// G-buffer, then ShadeDeferred lights each visible pixel once, no matter how much overdraw there was
+	// Always lit with Blinn-Phong, the draw's shader, blending and depth settings are ignored, so
+	// see-through things have to go through Draw after the shading
+	// The target needs its G-buffer enabled
+	void DrawGBuffer( Framebuffer& target, const DrawCall& call );
+	// Tile by tile, spread over the pool, done when this returns
+	// The materials of the G-buffer draws are forgotten afterwards
+	void ShadeDeferred( Framebuffer& target, const LightGrid& lights, const glm::mat4& viewProj, ThreadPool& pool );
+
+	// Visibility buffer: the draws only leave their depth and a 32-bit triangle ID behind, which is as
+	// little memory traffic as rasterizing gets, then ResolveVisibility runs each visible pixel's
+	// pixel shader once, with the varyings rebuilt from its triangle
+	// Same shaders as Draw, but blending and the depth settings are ignored, so see-through things
+	// have to go through Draw after the resolve
+	// The target needs its visibility buffer enabled, and the meshes, textures and lights have to stay
+	// around until the resolve
+	void DrawVisibility( Framebuffer& target, const DrawCall& call );
+	// Tile by tile, spread over the pool, done when this returns
+	void ResolveVisibility( Framebuffer& target, ThreadPool& pool );
+
+	// Anti-aliased lines along the edges of all of the mesh's triangles, in the draw's colour, with its alpha
+	// for how opaque they are, edges shared by two triangles are drawn twice
+	// Only the depth test, the cull mode and the line depth bias of the pipeline state count, with any depth test
+	// it's just whether the lines are no further than what's in the depth buffer, they never write it
+	// Hidden-line wireframe is DrawDepth first, then this with the same cull mode, a depth test and a small bias,
+	// or DrawHiddenLines, which does the same over a thread pool
+	// Straight into the colour buffer, so if the target is multisampled that has to come after ResolveSamples
+	void DrawWireframe( Framebuffer& target, const DrawCall& call );
+	// One of the same, between two points in clip space, never depth tested
+	void DrawLine( Framebuffer& target, const glm::vec4& from, const glm::vec4& to, const glm::vec4& color );
+
+	// Hidden-line wireframe in parallel: the draws are the depth of the mesh's triangles and then their edges,
+	// like DrawDepth and DrawWireframe with a depth test, but they only get sorted into bands of rows here, after
+	// going through the mesh's BVH for the parts that are in view
+	// ResolveHiddenLines then finishes the target's clears and draws the depth of all of them, then all of their
+	// edges, band by band over the pool
+	// The meshes have to stay around and the target can't change size until the resolve
+	// Not for multisampled targets, whose depth is in the samples
+	void DrawHiddenLines( Framebuffer& target, const DrawCall& call, ThreadPool& pool );
+	// Done when this returns
+	void ResolveHiddenLines( Framebuffer& target, ThreadPool& pool );
+
+private:
+	// Everything but the vertex outputs, false if there's nothing to draw
+	bool SetupDraw( const Framebuffer& target, const DrawCall& call, DrawParameters& outParameters );
+	// Just the buffers to draw into, false if there's nothing to draw into
+	bool SetupTarget( const Framebuffer& target, DrawParameters& outParameters );
+	// The G-buffer only has room for 255 of them, after that they all share the last one
+	uint8_t GetMaterialId( const float& specular, const float& shininess );
+
+	// What the vertex shader put out, reused between draws
+	TrackedVector<float, MemoryTag::Frame> vertexOutputs;
+	// For G-buffer draws of meshes without normals, they all face straight up
+	TrackedVector<glm::vec3, MemoryTag::Frame> defaultNormals;
+	// Of the G-buffer draws since the last ShadeDeferred, the first one stands in for "nothing drawn"
+	TrackedVector<MaterialParameters, MemoryTag::Frame> materials{ MaterialParameters{ 0.0f, 1.0f } };
+
+	// The visibility buffer draws since the last resolve, their vertex outputs are at the offsets into
+	// visibilityVertices, which can still move around until then
+	TrackedVector<DrawParameters, MemoryTag::Frame> visibilityDraws;
+	TrackedVector<size_t, MemoryTag::Frame> visibilityVertexOffsets;
+	TrackedVector<float, MemoryTag::Frame> visibilityVertices;
+	// 0 is for pixels nothing was drawn into
+	uint32_t nextVisibilityId{ 1 };
+
+	// A run of a hidden-line draw's triangles, from its BVH's primitive list, that gets binned in one go
+	struct HiddenLineChunk
+	{
+		uint32_t draw;
+		uint32_t first;
+		uint32_t count;
+		CullMode cullMode;
+	};
+
+	// Same as for the visibility buffer, the hidden-line draws since the last resolve, with their vertex outputs
+	// The triangles of chunk c that reach into band b are in hiddenLineBins[c * bands + b], the bins keep their
+	// memory between frames
+	TrackedVector<DrawParameters, MemoryTag::Frame> hiddenLineDraws;
+	TrackedVector<size_t, MemoryTag::Frame> hiddenLineVertexOffsets;
+	TrackedVector<float, MemoryTag::Frame> hiddenLineVertices;
+	TrackedVector<HiddenLineChunk, MemoryTag::Frame> hiddenLineChunks;
+	TrackedVector<TrackedVector<uint32_t, MemoryTag::Frame>, MemoryTag::Frame> hiddenLineBins;
+};
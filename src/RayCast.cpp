@@ -0,0 +1,120 @@
+
+#include "RayCast.hpp"
+#include "Simd.hpp"
+
+// Anything thinner than this is considered parallel to the ray
+constexpr float Epsilon = 1e-8f;
+
+#if THE_SSE
+int IntersectTriangles( const Ray& ray, const TrianglePacket4& packet, float& inOutDistance )
+{
+	struct Vec3x4
+	{
+		__m128 x, y, z;
+	};
+
+	const auto load = []( const float lanes[3][4] )
+	{
+		return Vec3x4{ _mm_load_ps( lanes[0] ), _mm_load_ps( lanes[1] ), _mm_load_ps( lanes[2] ) };
+	};
+	const auto splat = []( const glm::vec3& v )
+	{
+		return Vec3x4{ _mm_set1_ps( v.x ), _mm_set1_ps( v.y ), _mm_set1_ps( v.z ) };
+	};
+	const auto sub = []( const Vec3x4& a, const Vec3x4& b )
+	{
+		return Vec3x4{ _mm_sub_ps( a.x, b.x ), _mm_sub_ps( a.y, b.y ), _mm_sub_ps( a.z, b.z ) };
+	};
+	const auto dot = []( const Vec3x4& a, const Vec3x4& b )
+	{
+		return _mm_add_ps( _mm_add_ps( _mm_mul_ps( a.x, b.x ), _mm_mul_ps( a.y, b.y ) ), _mm_mul_ps( a.z, b.z ) );
+	};
+	const auto cross = []( const Vec3x4& a, const Vec3x4& b )
+	{
+		return Vec3x4
+		{
+			_mm_sub_ps( _mm_mul_ps( a.y, b.z ), _mm_mul_ps( a.z, b.y ) ),
+			_mm_sub_ps( _mm_mul_ps( a.z, b.x ), _mm_mul_ps( a.x, b.z ) ),
+			_mm_sub_ps( _mm_mul_ps( a.x, b.y ), _mm_mul_ps( a.y, b.x ) )
+		};
+	};
+
+	const Vec3x4 v0 = load( packet.v0 );
+	const Vec3x4 edge1 = sub( load( packet.v1 ), v0 );
+	const Vec3x4 edge2 = sub( load( packet.v2 ), v0 );
+	const Vec3x4 direction = splat( ray.direction );
+
+	const Vec3x4 pvec = cross( direction, edge2 );
+	const __m128 det = dot( edge1, pvec );
+	const __m128 invDet = _mm_div_ps( _mm_set1_ps( 1.0f ), det );
+
+	const Vec3x4 tvec = sub( splat( ray.origin ), v0 );
+	const __m128 u = _mm_mul_ps( dot( tvec, pvec ), invDet );
+	const Vec3x4 qvec = cross( tvec, edge1 );
+	const __m128 v = _mm_mul_ps( dot( direction, qvec ), invDet );
+	const __m128 t = _mm_mul_ps( dot( edge2, qvec ), invDet );
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 absDet = _mm_andnot_ps( _mm_set1_ps( -0.0f ), det );
+	__m128 hit = _mm_cmpgt_ps( absDet, _mm_set1_ps( Epsilon ) );
+	hit = _mm_and_ps( hit, _mm_cmpge_ps( u, zero ) );
+	hit = _mm_and_ps( hit, _mm_cmpge_ps( v, zero ) );
+	hit = _mm_and_ps( hit, _mm_cmple_ps( _mm_add_ps( u, v ), _mm_set1_ps( 1.0f ) ) );
+	hit = _mm_and_ps( hit, _mm_cmpgt_ps( t, zero ) );
+	hit = _mm_and_ps( hit, _mm_cmplt_ps( t, _mm_set1_ps( inOutDistance ) ) );
+
+	int mask = _mm_movemask_ps( hit );
+	if ( !mask )
+	{
+		return -1;
+	}
+
+	alignas( 16 ) float distances[4];
+	_mm_store_ps( distances, t );
+
+	int closest = -1;
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		if ( (mask & (1 << lane)) && distances[lane] < inOutDistance )
+		{
+			inOutDistance = distances[lane];
+			closest = lane;
+		}
+	}
+
+	return closest;
+}
+#else
+int IntersectTriangles( const Ray& ray, const TrianglePacket4& packet, float& inOutDistance )
+{
+	int closest = -1;
+	for ( int lane = 0; lane < 4; lane++ )
+	{
+		const glm::vec3 v0{ packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane] };
+		const glm::vec3 edge1 = glm::vec3( packet.v1[0][lane], packet.v1[1][lane], packet.v1[2][lane] ) - v0;
+		const glm::vec3 edge2 = glm::vec3( packet.v2[0][lane], packet.v2[1][lane], packet.v2[2][lane] ) - v0;
+
+		const glm::vec3 pvec = glm::cross( ray.direction, edge2 );
+		const float det = glm::dot( edge1, pvec );
+		if ( glm::abs( det ) <= Epsilon )
+		{
+			continue;
+		}
+
+		const float invDet = 1.0f / det;
+		const glm::vec3 tvec = ray.origin - v0;
+		const float u = glm::dot( tvec, pvec ) * invDet;
+		const glm::vec3 qvec = glm::cross( tvec, edge1 );
+		const float v = glm::dot( ray.direction, qvec ) * invDet;
+		const float t = glm::dot( edge2, qvec ) * invDet;
+
+		if ( u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < inOutDistance )
+		{
+			inOutDistance = t;
+			closest = lane;
+		}
+	}
+
+	return closest;
+}
+#endif
@@ -0,0 +1,27 @@
+
+#pragma once
+
+#include "Bvh.hpp"
+
+// Up to 4 triangles in SoA form, so that they can be tested against a ray all at once
+// Unused lanes are left degenerate, which never registers a hit
+struct alignas( 16 ) TrianglePacket4
+{
+	void Set( const int& lane, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c )
+	{
+		for ( int axis = 0; axis < 3; axis++ )
+		{
+			v0[axis][lane] = a[axis];
+			v1[axis][lane] = b[axis];
+			v2[axis][lane] = c[axis];
+		}
+	}
+
+	float v0[3][4]{};
+	float v1[3][4]{};
+	float v2[3][4]{};
+};
+
+// Moller-Trumbore against all 4 triangles, double-sided
+// Returns the lane of the closest hit that is nearer than inOutDistance and updates it, or -1
+int IntersectTriangles( const Ray& ray, const TrianglePacket4& packet, float& inOutDistance );
@@ -0,0 +1,116 @@
+
+#include <algorithm>
+
+#include "RayCast.hpp"
+#include "Scene.hpp"
+
+uint32_t Scene::AddObject( std::shared_ptr<const Mesh> mesh, const glm::mat4& transform )
+{
+	SceneObject object;
+	object.mesh = std::move( mesh );
+	object.transform = transform;
+	object.inverseTransform = glm::inverse( transform );
+	object.worldBounds = object.mesh->GetBounds().Transformed( transform );
+
+	objects.push_back( std::move( object ) );
+	objectBounds.push_back( objects.back().worldBounds );
+	needsRebuild = true;
+
+	return objects.size() - 1;
+}
+
+void Scene::SetTransform( const uint32_t& index, const glm::mat4& transform )
+{
+	SceneObject& object = objects[index];
+	object.transform = transform;
+	object.inverseTransform = glm::inverse( transform );
+	object.worldBounds = object.mesh->GetBounds().Transformed( transform );
+	objectBounds[index] = object.worldBounds;
+
+	if ( !needsRebuild )
+	{
+		bvh.RefitPrimitive( index, objectBounds.data() );
+	}
+}
+
+void Scene::SetMesh( const uint32_t& index, std::shared_ptr<const Mesh> mesh )
+{
+	SceneObject& object = objects[index];
+	object.mesh = std::move( mesh );
+	object.worldBounds = object.mesh->GetBounds().Transformed( object.transform );
+	objectBounds[index] = object.worldBounds;
+
+	if ( !needsRebuild )
+	{
+		bvh.RefitPrimitive( index, objectBounds.data() );
+	}
+}
+
+void Scene::Update()
+{
+	if ( needsRebuild )
+	{
+		bvh.Build( objectBounds.data(), objectBounds.size() );
+		needsRebuild = false;
+	}
+}
+
+void Scene::CullVisible( const Frustum& frustum, TrackedVector<uint32_t, MemoryTag::Frame>& outVisible ) const
+{
+	bvh.CullFrustum( frustum, objectBounds.data(), outVisible );
+}
+
+bool Scene::Pick( const Ray& ray, PickResult& outResult ) const
+{
+	outResult = PickResult();
+	float closest = FLT_MAX;
+
+	bvh.IntersectRay( ray, closest, [&]( const uint32_t* objectIndices, const uint32_t& objectCount, float& objectClosest )
+	{
+		for ( uint32_t i = 0; i < objectCount; i++ )
+		{
+			const SceneObject& object = objects[objectIndices[i]];
+
+			// The direction isn't renormalised, so distances along it stay the same as in world space
+			const Ray localRay
+			(
+				glm::vec3( object.inverseTransform * glm::vec4( ray.origin, 1.0f ) ),
+				glm::vec3( object.inverseTransform * glm::vec4( ray.direction, 0.0f ) )
+			);
+
+			const Mesh& mesh = *object.mesh;
+			mesh.GetBvh().IntersectRay( localRay, objectClosest,
+				[&]( const uint32_t* triangleIndices, const uint32_t& triangleCount, float& triangleClosest )
+			{
+				// Gather the leaf's triangles 4 at a time
+				for ( uint32_t first = 0; first < triangleCount; first += 4 )
+				{
+					const uint32_t count = std::min( triangleCount - first, 4U );
+
+					TrianglePacket4 packet;
+					for ( uint32_t lane = 0; lane < count; lane++ )
+					{
+						const Triangle tri = mesh.GetTriangle( triangleIndices[first + lane] );
+						packet.Set( lane, tri.verts[0], tri.verts[1], tri.verts[2] );
+					}
+
+					const int lane = IntersectTriangles( localRay, packet, triangleClosest );
+					if ( lane >= 0 )
+					{
+						outResult.object = objectIndices[i];
+						outResult.triangle = triangleIndices[first + lane];
+					}
+				}
+			} );
+		}
+	} );
+
+	if ( outResult.object == Bvh::InvalidIndex )
+	{
+		return false;
+	}
+
+	outResult.distance = closest;
+	outResult.position = ray.origin + ray.direction * closest;
+	return true;
+}
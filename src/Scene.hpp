@@ -0,0 +1,66 @@
+
+#pragma once
+
+#include <memory>
+
+#include "Mesh.hpp"
+
+struct SceneObject
+{
+	// Shared, so the same mesh can be placed several times
+	std::shared_ptr<const Mesh> mesh;
+	glm::mat4 transform{ 1.0f };
+	// Rays get brought into model space instead of transforming the triangles
+	glm::mat4 inverseTransform{ 1.0f };
+
+	Aabb worldBounds;
+};
+
+struct PickResult
+{
+	uint32_t object{ Bvh::InvalidIndex };
+	uint32_t triangle{ Bvh::InvalidIndex };
+	float distance{ FLT_MAX };
+	glm::vec3 position{ 0.0f };
+};
+
+// All the renderable objects, plus a BVH over their world-space bounds
+class Scene
+{
+public:
+	uint32_t AddObject( std::shared_ptr<const Mesh> mesh, const glm::mat4& transform = glm::mat4( 1.0f ) );
+	// Moving an object only refits the part of the BVH above it, unless a rebuild is pending anyway
+	void SetTransform( const uint32_t& index, const glm::mat4& transform );
+	// E.g. when a mesh finished streaming in and replaces the placeholder, refits like SetTransform
+	void SetMesh( const uint32_t& index, std::shared_ptr<const Mesh> mesh );
+
+	// Call before querying; (re)builds the BVH if objects were added since the last build
+	void Update();
+
+	void CullVisible( const Frustum& frustum, TrackedVector<uint32_t, MemoryTag::Frame>& outVisible ) const;
+
+	// Finds the closest triangle along the ray, through the object BVH and then each mesh's triangle BVH
+	bool Pick( const Ray& ray, PickResult& outResult ) const;
+
+	const SceneObject& GetObject( const uint32_t& index ) const
+	{
+		return objects[index];
+	}
+
+	uint32_t GetObjectCount() const
+	{
+		return objects.size();
+	}
+
+	const Bvh& GetBvh() const
+	{
+		return bvh;
+	}
+
+private:
+	TrackedVector<SceneObject, MemoryTag::Scene> objects;
+	// Kept separately from the objects so the BVH can read them as a plain array
+	TrackedVector<Aabb, MemoryTag::Scene> objectBounds;
+	Bvh bvh;
+	bool needsRebuild{ false };
+};
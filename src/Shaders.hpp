@@ -0,0 +1,737 @@
+
+#pragma once
+
+// Vertex and pixel shaders for the kernels, see KernelsImpl.hpp
+// Like the kernels, this gets compiled once per instruction set, so no glm and no standard library in here
+//
+// A vertex shader is a functor that turns a packet of vertices into clip-space positions and up to
+// MaxVaryings values, which get interpolated across the triangle and handed to the pixel shader.
+// A pixel shader turns those into a colour, for a packet of pixels at once.
+// Both get constructed once per draw, so they can set up whatever they need from the DrawParameters
+//
+// Adding a material takes a vertex and a pixel shader that agree on their varyings, a value in the
+// Shader enum, and a ShaderProgram specialisation at the bottom of this file
+
+#include <math.h>
+
+#include "Kernels.hpp"
+#include "Simd.hpp"
+
+namespace THE_SIMD_NAMESPACE
+{
+namespace
+{
+	// A packet of vertices, one per lane
+	// Normals and texcoords are only loaded for the shaders that ask for them
+	struct VertexInput
+	{
+		FloatPacket position[3];
+		FloatPacket normal[3];
+		FloatPacket texCoord[2];
+	};
+
+	struct VertexOutput
+	{
+		FloatPacket position[4];
+		FloatPacket varyings[MaxVaryings];
+	};
+
+	// A block of pixels, the varyings are already perspective-corrected
+	struct PixelInput
+	{
+		FloatPacket varyings[MaxVaryings];
+		// The screen tile the block is in
+		uint32_t tileX;
+		uint32_t tileY;
+		// Which of the mesh's triangles the pixels belong to
+		uint32_t triangle;
+	};
+
+	// Column-major, like glm, every element broadcast over a whole packet
+	struct PacketMatrix
+	{
+		explicit PacketMatrix( const float* matrix )
+		{
+			for ( int i = 0; i < 16; i++ )
+			{
+				elements[i] = FloatPacket( matrix[i] );
+			}
+		}
+
+		// w = 1 for the point
+		void TransformPoint( const FloatPacket* point, FloatPacket* outPoint ) const
+		{
+			for ( int row = 0; row < 4; row++ )
+			{
+				outPoint[row] = elements[row] * point[0] + elements[4 + row] * point[1] + elements[8 + row] * point[2] + elements[12 + row];
+			}
+		}
+
+		// Only the upper 3x3, e.g. for directions
+		void TransformDirection( const FloatPacket* direction, FloatPacket* outDirection ) const
+		{
+			for ( int row = 0; row < 3; row++ )
+			{
+				outDirection[row] = elements[row] * direction[0] + elements[4 + row] * direction[1] + elements[8 + row] * direction[2];
+			}
+		}
+
+		FloatPacket elements[16];
+	};
+
+	// A 3x3 one, column-major as well
+	struct PacketMatrix3
+	{
+		explicit PacketMatrix3( const float* matrix )
+		{
+			for ( int i = 0; i < 9; i++ )
+			{
+				elements[i] = FloatPacket( matrix[i] );
+			}
+		}
+
+		void Transform( const FloatPacket* vector, FloatPacket* outVector ) const
+		{
+			for ( int row = 0; row < 3; row++ )
+			{
+				outVector[row] = elements[row] * vector[0] + elements[3 + row] * vector[1] + elements[6 + row] * vector[2];
+			}
+		}
+
+		FloatPacket elements[9];
+	};
+
+	FloatPacket Dot3( const FloatPacket* a, const FloatPacket* b )
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Zero-length vectors stay zero instead of turning into NaNs
+	void Normalize3( FloatPacket* vector )
+	{
+		const FloatPacket invLength = FloatPacket( 1.0f ) / Sqrt( Max( Dot3( vector, vector ), FloatPacket( 1e-12f ) ) );
+		for ( int i = 0; i < 3; i++ )
+		{
+			vector[i] = vector[i] * invLength;
+		}
+	}
+
+	// Adds one light's diffuse and Blinn-Phong specular for a packet of surface points
+	// The normal and the direction to the eye have to be normalised
+	void AccumulateLight( const LightParameters& light, const FloatPacket* position, const FloatPacket* normal,
+		const FloatPacket* toEye, const FloatPacket& shininess, FloatPacket* inOutDiffuse, FloatPacket* inOutSpecular )
+	{
+		const FloatPacket zero( 0.0f );
+		const FloatPacket one( 1.0f );
+
+		FloatPacket toLight[3];
+		FloatPacket attenuation = one;
+		if ( light.type == LightType::Directional )
+		{
+			for ( int i = 0; i < 3; i++ )
+			{
+				toLight[i] = FloatPacket( -light.direction[i] );
+			}
+		}
+		else
+		{
+			for ( int i = 0; i < 3; i++ )
+			{
+				toLight[i] = FloatPacket( light.position[i] ) - position[i];
+			}
+			const FloatPacket distanceSquared = Max( Dot3( toLight, toLight ), FloatPacket( 1e-12f ) );
+			const FloatPacket invDistance = one / Sqrt( distanceSquared );
+			for ( int i = 0; i < 3; i++ )
+			{
+				toLight[i] = toLight[i] * invDistance;
+			}
+
+			// Smoothly down to exactly nothing at the range, so culling lights by their range is exact
+			const FloatPacket falloff = Max( one - distanceSquared * FloatPacket( light.invRangeSquared ), zero );
+			attenuation = falloff * falloff;
+
+			if ( light.type == LightType::Spot )
+			{
+				const FloatPacket cosAngle = zero - (toLight[0] * FloatPacket( light.direction[0] )
+					+ toLight[1] * FloatPacket( light.direction[1] ) + toLight[2] * FloatPacket( light.direction[2] ));
+				const FloatPacket cone = Min( Max( (cosAngle - FloatPacket( light.cosOuter )) * FloatPacket( light.invConeWidth ), zero ), one );
+				attenuation = attenuation * cone * cone;
+			}
+		}
+
+		const FloatPacket nDotL = Max( Dot3( normal, toLight ), zero );
+
+		FloatPacket halfway[3]{ toLight[0] + toEye[0], toLight[1] + toEye[1], toLight[2] + toEye[2] };
+		Normalize3( halfway );
+		const FloatPacket nDotH = Max( Dot3( normal, halfway ), zero );
+		// Schlick's stand-in for pow( nDotH, shininess ), close enough for a highlight and a lot cheaper
+		// No highlights on the side facing away from the light
+		const FloatPacket highlight = nDotH / (shininess - shininess * nDotH + nDotH);
+		const FloatPacket specular = Select( nDotL > zero, zero, highlight ) * attenuation;
+		const FloatPacket diffuse = nDotL * attenuation;
+
+		for ( int i = 0; i < 3; i++ )
+		{
+			const FloatPacket color( light.color[i] );
+			inOutDiffuse[i] = inOutDiffuse[i] + color * diffuse;
+			inOutSpecular[i] = inOutSpecular[i] + color * specular;
+		}
+	}
+
+	// Bilinear with repeat wrapping, every lane from the same level
+	void SampleBilinear( const TextureLevel& level, const FloatPacket& u, const FloatPacket& v,
+		FloatPacket& r, FloatPacket& g, FloatPacket& b, FloatPacket& a )
+	{
+		const FloatPacket width( float( level.width ) );
+		const FloatPacket height( float( level.height ) );
+		const FloatPacket one( 1.0f );
+		const FloatPacket zero( 0.0f );
+
+		const FloatPacket x = u * width - FloatPacket( 0.5f );
+		const FloatPacket y = v * height - FloatPacket( 0.5f );
+		const FloatPacket x0 = Floor( x );
+		const FloatPacket y0 = Floor( y );
+		const FloatPacket fracX = x - x0;
+		const FloatPacket fracY = y - y0;
+
+		// Repeat addressing that also works for non-power-of-two sizes, clamped in case the division rounded badly
+		const FloatPacket left = Min( Max( x0 - Floor( x0 / width ) * width, zero ), width - one );
+		const FloatPacket top = Min( Max( y0 - Floor( y0 / height ) * height, zero ), height - one );
+		const FloatPacket right = Select( left + one >= width, left + one, zero );
+		const FloatPacket bottom = Select( top + one >= height, top + one, zero );
+
+		const IntPacket leftIndex = ToInt( left );
+		const IntPacket rightIndex = ToInt( right );
+		const IntPacket topIndex = ToInt( top );
+		const IntPacket bottomIndex = ToInt( bottom );
+
+		FloatPacket channels[4][4];
+		UnpackColor( Gather( level.texels, leftIndex, topIndex, level.width ), channels[0][0], channels[0][1], channels[0][2], channels[0][3] );
+		UnpackColor( Gather( level.texels, rightIndex, topIndex, level.width ), channels[1][0], channels[1][1], channels[1][2], channels[1][3] );
+		UnpackColor( Gather( level.texels, leftIndex, bottomIndex, level.width ), channels[2][0], channels[2][1], channels[2][2], channels[2][3] );
+		UnpackColor( Gather( level.texels, rightIndex, bottomIndex, level.width ), channels[3][0], channels[3][1], channels[3][2], channels[3][3] );
+
+		FloatPacket* outputs[4]{ &r, &g, &b, &a };
+		for ( int channel = 0; channel < 4; channel++ )
+		{
+			const FloatPacket upper = channels[0][channel] + (channels[1][channel] - channels[0][channel]) * fracX;
+			const FloatPacket lower = channels[2][channel] + (channels[3][channel] - channels[2][channel]) * fracX;
+			*outputs[channel] = upper + (lower - upper) * fracY;
+		}
+	}
+
+	// Samples the draw's texture for a block of pixels, from the mip level that fits how far the
+	// texcoords move from one pixel to the next
+	void SampleTexture( const DrawParameters& parameters, const FloatPacket& u, const FloatPacket& v,
+		FloatPacket& r, FloatPacket& g, FloatPacket& b, FloatPacket& a )
+	{
+		const float dudx = (u[1] - u[0]) * parameters.textureWidth;
+		const float dvdx = (v[1] - v[0]) * parameters.textureHeight;
+		const float dudy = (u[BlockWidth] - u[0]) * parameters.textureWidth;
+		const float dvdy = (v[BlockWidth] - v[0]) * parameters.textureHeight;
+		const float footprint = fmaxf( dudx * dudx + dvdx * dvdx, dudy * dudy + dvdy * dvdy );
+		const float lod = 0.5f * log2f( fmaxf( footprint, 1e-8f ) );
+
+		const TextureLevel level = parameters.selectTextureLevel( parameters.texture, lod );
+		SampleBilinear( level, u, v, r, g, b, a );
+	}
+
+	// Goes through the lights that reach into a screen tile
+	void AccumulateTileLights( const LightingParameters& lighting, const uint32_t& tileX, const uint32_t& tileY,
+		const FloatPacket* position, const FloatPacket* normal, const FloatPacket& shininess,
+		FloatPacket* inOutDiffuse, FloatPacket* inOutSpecular )
+	{
+		FloatPacket toEye[3];
+		for ( int i = 0; i < 3; i++ )
+		{
+			toEye[i] = FloatPacket( lighting.viewOrigin[i] ) - position[i];
+		}
+		Normalize3( toEye );
+
+		const uint32_t tile = tileY * lighting.tilesX + tileX;
+		const uint32_t end = lighting.tileLightOffsets[tile + 1];
+		for ( uint32_t i = lighting.tileLightOffsets[tile]; i < end; i++ )
+		{
+			AccumulateLight( lighting.lights[lighting.tileLightIndices[i]], position, normal, toEye, shininess, inOutDiffuse, inOutSpecular );
+		}
+	}
+
+	// Octahedral encoding into 16 bits per component, the normal has to be normalised
+	// The upper half of the octahedron maps onto a diamond, the lower half gets folded out into the corners
+	IntPacket PackNormal( const FloatPacket* normal )
+	{
+		const FloatPacket zero( 0.0f );
+		const FloatPacket one( 1.0f );
+		const FloatPacket minusOne( -1.0f );
+
+		const FloatPacket absX = Max( normal[0], zero - normal[0] );
+		const FloatPacket absY = Max( normal[1], zero - normal[1] );
+		const FloatPacket absZ = Max( normal[2], zero - normal[2] );
+		const FloatPacket invLength = one / Max( absX + absY + absZ, FloatPacket( 1e-12f ) );
+		FloatPacket x = normal[0] * invLength;
+		FloatPacket y = normal[1] * invLength;
+
+		const MaskPacket lowerHalf = normal[2] < zero;
+		const FloatPacket foldedX = (one - absY * invLength) * Select( x >= zero, minusOne, one );
+		const FloatPacket foldedY = (one - absX * invLength) * Select( y >= zero, minusOne, one );
+		x = Select( lowerHalf, x, foldedX );
+		y = Select( lowerHalf, y, foldedY );
+
+		const FloatPacket scale( 32767.5f );
+		return ToInt( x * scale + scale ) | ShiftLeft<16>( ToInt( y * scale + scale ) );
+	}
+
+	void UnpackNormal( const IntPacket& packed, FloatPacket* outNormal )
+	{
+		const FloatPacket zero( 0.0f );
+		const FloatPacket one( 1.0f );
+		const FloatPacket invScale( 1.0f / 32767.5f );
+
+		FloatPacket x = ToFloat( packed & IntPacket( 0xFFFF ) ) * invScale - one;
+		FloatPacket y = ToFloat( ShiftRight<16>( packed ) ) * invScale - one;
+		const FloatPacket z = one - Max( x, zero - x ) - Max( y, zero - y );
+
+		// Unfolds the lower half
+		const FloatPacket fold = Max( zero - z, zero );
+		x = x + Select( x >= zero, fold, zero - fold );
+		y = y + Select( y >= zero, fold, zero - fold );
+
+		outNormal[0] = x;
+		outNormal[1] = y;
+		outNormal[2] = z;
+		Normalize3( outNormal );
+	}
+
+	// Just the transform, plus the texcoords if the pixels want them
+	template<bool Textured>
+	struct UnlitVertexShader
+	{
+		static constexpr int VaryingCount = Textured ? 2 : 0;
+		static constexpr bool UsesNormals = false;
+		static constexpr bool UsesTexCoords = Textured;
+
+		explicit UnlitVertexShader( const DrawParameters& parameters )
+			: modelViewProj( parameters.modelViewProj )
+		{
+		}
+
+		void operator()( const VertexInput& input, VertexOutput& output ) const
+		{
+			modelViewProj.TransformPoint( input.position, output.position );
+			if ( Textured )
+			{
+				output.varyings[0] = input.texCoord[0];
+				output.varyings[1] = input.texCoord[1];
+			}
+		}
+
+		PacketMatrix modelViewProj;
+	};
+
+	// For the edges of the triangles, projected onto the screen once per vertex rather than once per edge
+	// The varyings are the position on screen, 1 / w and the outcode, see GetOutcode
+	struct WireframeVertexShader
+	{
+		static constexpr int VaryingCount = 4;
+		static constexpr bool UsesNormals = false;
+		static constexpr bool UsesTexCoords = false;
+
+		explicit WireframeVertexShader( const DrawParameters& parameters )
+			: transform( parameters )
+			, halfWidth( parameters.width * 0.5f )
+			, halfHeight( parameters.height * 0.5f )
+		{
+		}
+
+		void operator()( const VertexInput& input, VertexOutput& output ) const
+		{
+			transform( input, output );
+
+			const FloatPacket zero( 0.0f );
+			const FloatPacket one( 1.0f );
+			const FloatPacket* position = output.position;
+			const FloatPacket invW = one / position[3];
+			output.varyings[0] = (position[0] * invW + one) * halfWidth;
+			output.varyings[1] = (one - position[1] * invW) * halfHeight;
+			output.varyings[2] = invW;
+
+			const FloatPacket w = position[3];
+			const FloatPacket minusW = zero - w;
+			const auto bit = [&zero]( const MaskPacket& outside, const float& value )
+			{
+				return Select( outside, zero, FloatPacket( value ) );
+			};
+			output.varyings[3] = bit( position[0] < minusW, 1.0f ) + bit( position[0] > w, 2.0f ) + bit( position[1] < minusW, 4.0f )
+				+ bit( position[1] > w, 8.0f ) + bit( position[2] < minusW, 16.0f ) + bit( position[2] > w, 32.0f );
+		}
+
+		UnlitVertexShader<false> transform;
+		FloatPacket halfWidth;
+		FloatPacket halfHeight;
+	};
+
+	// The draw's colour, times the texture
+	template<bool Textured>
+	struct UnlitPixelShader
+	{
+		static constexpr int VaryingCount = Textured ? 2 : 0;
+
+		explicit UnlitPixelShader( const DrawParameters& parameters )
+			: parameters( parameters ), flatR( parameters.color[0] ), flatG( parameters.color[1] ),
+			flatB( parameters.color[2] ), flatA( parameters.color[3] )
+		{
+		}
+
+		void operator()( const PixelInput& input, FloatPacket& r, FloatPacket& g, FloatPacket& b, FloatPacket& a ) const
+		{
+			r = flatR;
+			g = flatG;
+			b = flatB;
+			a = flatA;
+
+			if ( Textured )
+			{
+				FloatPacket texelR, texelG, texelB, texelA;
+				SampleTexture( parameters, input.varyings[0], input.varyings[1], texelR, texelG, texelB, texelA );
+				r = r * texelR;
+				g = g * texelG;
+				b = b * texelB;
+				a = a * texelA;
+			}
+		}
+
+		const DrawParameters& parameters;
+		FloatPacket flatR, flatG, flatB, flatA;
+	};
+
+	// The normals as colours, mostly for looking at meshes
+	template<bool Textured>
+	struct VertexColorsVertexShader
+	{
+		static constexpr int VaryingCount = Textured ? 5 : 3;
+		static constexpr bool UsesNormals = true;
+		static constexpr bool UsesTexCoords = Textured;
+
+		explicit VertexColorsVertexShader( const DrawParameters& parameters )
+			: modelViewProj( parameters.modelViewProj )
+		{
+		}
+
+		void operator()( const VertexInput& input, VertexOutput& output ) const
+		{
+			modelViewProj.TransformPoint( input.position, output.position );
+			const FloatPacket half( 0.5f );
+			for ( int i = 0; i < 3; i++ )
+			{
+				output.varyings[i] = input.normal[i] * half + half;
+			}
+			if ( Textured )
+			{
+				output.varyings[3] = input.texCoord[0];
+				output.varyings[4] = input.texCoord[1];
+			}
+		}
+
+		PacketMatrix modelViewProj;
+	};
+
+	template<bool Textured>
+	struct VertexColorsPixelShader
+	{
+		static constexpr int VaryingCount = Textured ? 5 : 3;
+
+		explicit VertexColorsPixelShader( const DrawParameters& parameters )
+			: unlit( parameters )
+		{
+		}
+
+		void operator()( const PixelInput& input, FloatPacket& r, FloatPacket& g, FloatPacket& b, FloatPacket& a ) const
+		{
+			// Same thing as unlit, just with the texcoords further back
+			PixelInput unlitInput;
+			if ( Textured )
+			{
+				unlitInput.varyings[0] = input.varyings[3];
+				unlitInput.varyings[1] = input.varyings[4];
+			}
+			unlit( unlitInput, r, g, b, a );
+
+			r = r * input.varyings[0];
+			g = g * input.varyings[1];
+			b = b * input.varyings[2];
+		}
+
+		UnlitPixelShader<Textured> unlit;
+	};
+
+	// Ambient plus every light, evaluated at the vertices
+	// Goes through all the lights, since a vertex doesn't belong to any one screen tile
+	template<bool Textured>
+	struct GouraudVertexShader
+	{
+		// Diffuse and specular light, then the texcoords
+		static constexpr int VaryingCount = Textured ? 8 : 6;
+		static constexpr bool UsesNormals = true;
+		static constexpr bool UsesTexCoords = Textured;
+
+		explicit GouraudVertexShader( const DrawParameters& parameters )
+			: lighting( *parameters.lighting ), modelViewProj( parameters.modelViewProj ), model( parameters.model ),
+			normalMatrix( parameters.normalMatrix ), specular( parameters.specular ), shininess( parameters.shininess )
+		{
+		}
+
+		void operator()( const VertexInput& input, VertexOutput& output ) const
+		{
+			modelViewProj.TransformPoint( input.position, output.position );
+
+			FloatPacket position[4];
+			model.TransformPoint( input.position, position );
+			FloatPacket normal[3];
+			normalMatrix.Transform( input.normal, normal );
+			Normalize3( normal );
+
+			FloatPacket toEye[3];
+			for ( int i = 0; i < 3; i++ )
+			{
+				toEye[i] = FloatPacket( lighting.viewOrigin[i] ) - position[i];
+			}
+			Normalize3( toEye );
+
+			FloatPacket diffuse[3]{ FloatPacket( lighting.ambient[0] ), FloatPacket( lighting.ambient[1] ), FloatPacket( lighting.ambient[2] ) };
+			FloatPacket highlights[3]{ FloatPacket( 0.0f ), FloatPacket( 0.0f ), FloatPacket( 0.0f ) };
+			for ( uint32_t light = 0; light < lighting.lightCount; light++ )
+			{
+				AccumulateLight( lighting.lights[light], position, normal, toEye, shininess, diffuse, highlights );
+			}
+
+			for ( int i = 0; i < 3; i++ )
+			{
+				output.varyings[i] = diffuse[i];
+				output.varyings[3 + i] = highlights[i] * specular;
+			}
+			if ( Textured )
+			{
+				output.varyings[6] = input.texCoord[0];
+				output.varyings[7] = input.texCoord[1];
+			}
+		}
+
+		const LightingParameters& lighting;
+		PacketMatrix modelViewProj;
+		PacketMatrix model;
+		PacketMatrix3 normalMatrix;
+		FloatPacket specular;
+		FloatPacket shininess;
+	};
+
+	// Lit surface colour times the diffuse light, plus the highlights, which aren't tinted by the surface
+	template<bool Textured>
+	struct GouraudPixelShader
+	{
+		static constexpr int VaryingCount = Textured ? 8 : 6;
+
+		explicit GouraudPixelShader( const DrawParameters& parameters )
+			: unlit( parameters )
+		{
+		}
+
+		void operator()( const PixelInput& input, FloatPacket& r, FloatPacket& g, FloatPacket& b, FloatPacket& a ) const
+		{
+			PixelInput unlitInput;
+			if ( Textured )
+			{
+				unlitInput.varyings[0] = input.varyings[6];
+				unlitInput.varyings[1] = input.varyings[7];
+			}
+			unlit( unlitInput, r, g, b, a );
+
+			r = r * input.varyings[0] + input.varyings[3];
+			g = g * input.varyings[1] + input.varyings[4];
+			b = b * input.varyings[2] + input.varyings[5];
+		}
+
+		UnlitPixelShader<Textured> unlit;
+	};
+
+	// Hands the world-space position and normal on to the pixel shader, which does the lighting
+	template<bool Textured>
+	struct BlinnPhongVertexShader
+	{
+		// Position, normal, then the texcoords
+		static constexpr int VaryingCount = Textured ? 8 : 6;
+		static constexpr bool UsesNormals = true;
+		static constexpr bool UsesTexCoords = Textured;
+
+		explicit BlinnPhongVertexShader( const DrawParameters& parameters )
+			: modelViewProj( parameters.modelViewProj ), model( parameters.model ), normalMatrix( parameters.normalMatrix )
+		{
+		}
+
+		void operator()( const VertexInput& input, VertexOutput& output ) const
+		{
+			modelViewProj.TransformPoint( input.position, output.position );
+
+			FloatPacket position[4];
+			model.TransformPoint( input.position, position );
+			normalMatrix.Transform( input.normal, &output.varyings[3] );
+			for ( int i = 0; i < 3; i++ )
+			{
+				output.varyings[i] = position[i];
+			}
+			if ( Textured )
+			{
+				output.varyings[6] = input.texCoord[0];
+				output.varyings[7] = input.texCoord[1];
+			}
+		}
+
+		PacketMatrix modelViewProj;
+		PacketMatrix model;
+		PacketMatrix3 normalMatrix;
+	};
+
+	// Per pixel, going through only the lights that reach into the block's tile
+	template<bool Textured>
+	struct BlinnPhongPixelShader
+	{
+		static constexpr int VaryingCount = Textured ? 8 : 6;
+
+		explicit BlinnPhongPixelShader( const DrawParameters& parameters )
+			: unlit( parameters ), lighting( *parameters.lighting ), specular( parameters.specular ), shininess( parameters.shininess )
+		{
+		}
+
+		void operator()( const PixelInput& input, FloatPacket& r, FloatPacket& g, FloatPacket& b, FloatPacket& a ) const
+		{
+			PixelInput unlitInput;
+			if ( Textured )
+			{
+				unlitInput.varyings[0] = input.varyings[6];
+				unlitInput.varyings[1] = input.varyings[7];
+			}
+			unlit( unlitInput, r, g, b, a );
+
+			// Interpolated normals come out shorter than 1
+			FloatPacket normal[3]{ input.varyings[3], input.varyings[4], input.varyings[5] };
+			Normalize3( normal );
+
+			FloatPacket diffuse[3]{ FloatPacket( lighting.ambient[0] ), FloatPacket( lighting.ambient[1] ), FloatPacket( lighting.ambient[2] ) };
+			FloatPacket highlights[3]{ FloatPacket( 0.0f ), FloatPacket( 0.0f ), FloatPacket( 0.0f ) };
+			AccumulateTileLights( lighting, input.tileX, input.tileY, &input.varyings[0], normal, shininess, diffuse, highlights );
+
+			r = r * diffuse[0] + highlights[0] * specular;
+			g = g * diffuse[1] + highlights[1] * specular;
+			b = b * diffuse[2] + highlights[2] * specular;
+		}
+
+		UnlitPixelShader<Textured> unlit;
+		const LightingParameters& lighting;
+		FloatPacket specular;
+		FloatPacket shininess;
+	};
+
+	// Fills the G-buffer for deferred shading, see GBufferOutput in KernelsImpl.hpp
+	// The world-space position doesn't need to be stored, it comes back out of the depth
+	template<bool Textured>
+	struct GBufferVertexShader
+	{
+		// Normal, then the texcoords
+		static constexpr int VaryingCount = Textured ? 5 : 3;
+		static constexpr bool UsesNormals = true;
+		static constexpr bool UsesTexCoords = Textured;
+
+		explicit GBufferVertexShader( const DrawParameters& parameters )
+			: modelViewProj( parameters.modelViewProj ), normalMatrix( parameters.normalMatrix )
+		{
+		}
+
+		void operator()( const VertexInput& input, VertexOutput& output ) const
+		{
+			modelViewProj.TransformPoint( input.position, output.position );
+			normalMatrix.Transform( input.normal, output.varyings );
+			if ( Textured )
+			{
+				output.varyings[3] = input.texCoord[0];
+				output.varyings[4] = input.texCoord[1];
+			}
+		}
+
+		PacketMatrix modelViewProj;
+		PacketMatrix3 normalMatrix;
+	};
+
+	// Puts out a normalised normal and the unlit surface colour instead of a finished colour
+	template<bool Textured>
+	struct GBufferPixelShader
+	{
+		static constexpr int VaryingCount = Textured ? 5 : 3;
+
+		explicit GBufferPixelShader( const DrawParameters& parameters )
+			: unlit( parameters )
+		{
+		}
+
+		void operator()( const PixelInput& input, FloatPacket* outNormal, FloatPacket& r, FloatPacket& g, FloatPacket& b ) const
+		{
+			PixelInput unlitInput;
+			if ( Textured )
+			{
+				unlitInput.varyings[0] = input.varyings[3];
+				unlitInput.varyings[1] = input.varyings[4];
+			}
+			FloatPacket a;
+			unlit( unlitInput, r, g, b, a );
+
+			for ( int i = 0; i < 3; i++ )
+			{
+				outNormal[i] = input.varyings[i];
+			}
+			Normalize3( outNormal );
+		}
+
+		UnlitPixelShader<Textured> unlit;
+	};
+
+	// For rasterizing without a pixel shader, nothing gets interpolated
+	struct NullPixelShader
+	{
+		static constexpr int VaryingCount = 0;
+
+		explicit NullPixelShader( const DrawParameters& )
+		{
+		}
+	};
+
+	// Which vertex and pixel shader make up each value of the Shader enum
+	template<Shader Program, bool Textured>
+	struct ShaderProgram;
+
+	template<bool Textured>
+	struct ShaderProgram<Shader::Unlit, Textured>
+	{
+		using Vertex = UnlitVertexShader<Textured>;
+		using Pixel = UnlitPixelShader<Textured>;
+	};
+
+	template<bool Textured>
+	struct ShaderProgram<Shader::VertexColors, Textured>
+	{
+		using Vertex = VertexColorsVertexShader<Textured>;
+		using Pixel = VertexColorsPixelShader<Textured>;
+	};
+
+	template<bool Textured>
+	struct ShaderProgram<Shader::Gouraud, Textured>
+	{
+		using Vertex = GouraudVertexShader<Textured>;
+		using Pixel = GouraudPixelShader<Textured>;
+	};
+
+	template<bool Textured>
+	struct ShaderProgram<Shader::BlinnPhong, Textured>
+	{
+		using Vertex = BlinnPhongVertexShader<Textured>;
+		using Pixel = BlinnPhongPixelShader<Textured>;
+	};
+}
+}
@@ -0,0 +1,799 @@
+
+#pragma once
+
+#include <cstdint>
+#include <math.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#define THE_SSE 1
+#include <immintrin.h>
+#else
+#define THE_SSE 0
+#endif
+
+#if THE_SSE && defined( __AVX512F__ ) && defined( __AVX512BW__ ) && defined( __AVX512DQ__ ) && defined( __AVX512VL__ )
+#define THE_AVX512 1
+#else
+#define THE_AVX512 0
+#endif
+
+#if THE_SSE && defined( __AVX2__ )
+#define THE_AVX2 1
+#else
+#define THE_AVX2 0
+#endif
+
+// The kernels include this from files that are compiled with different instruction sets (see Kernels.hpp)
+// Each of those gets its own namespace, otherwise the linker is free to keep e.g. the AVX2 copy of an
+// inline function, and call it from code that is meant to run on any CPU
+#if THE_AVX512
+#define THE_SIMD_NAMESPACE SimdAvx512
+#elif THE_AVX2
+#define THE_SIMD_NAMESPACE SimdAvx2
+#elif THE_SSE
+#define THE_SIMD_NAMESPACE SimdSse2
+#else
+#define THE_SIMD_NAMESPACE SimdScalar
+#endif
+
+// Packets of 4, 8 or 16 floats, for pixel blocks and batches of vertices
+// SSE2, AVX2 and AVX-512 where the file is compiled for them, plain arrays where there is no SSE2
+// Pixel blocks are always 2 rows tall, so a packet of N lanes covers N/2 pixels of each row
+namespace THE_SIMD_NAMESPACE
+{
+#if THE_SSE
+struct Mask4
+{
+	Mask4() = default;
+	explicit Mask4( const __m128& value )
+		: value( value )
+	{
+	}
+
+	Mask4 operator&( const Mask4& other ) const { return Mask4( _mm_and_ps( value, other.value ) ); }
+	Mask4 operator|( const Mask4& other ) const { return Mask4( _mm_or_ps( value, other.value ) ); }
+	Mask4 AndNot( const Mask4& other ) const { return Mask4( _mm_andnot_ps( other.value, value ) ); }
+
+	// One bit per lane
+	int GetBits() const { return _mm_movemask_ps( value ); }
+	bool Any() const { return GetBits() != 0; }
+
+	// Every lane set, or none
+	static Mask4 FromBool( const bool& set ) { return Mask4( _mm_castsi128_ps( _mm_set1_epi32( set ? -1 : 0 ) ) ); }
+
+	__m128 value;
+};
+
+// Packed colours, 4 lanes of ARGB8888, or texel coordinates
+struct Int4
+{
+	Int4() = default;
+	Int4( const uint32_t& scalar )
+		: value( _mm_set1_epi32( int( scalar ) ) )
+	{
+	}
+	explicit Int4( const __m128i& value )
+		: value( value )
+	{
+	}
+
+	static Int4 Load( const uint32_t* source ) { return Int4( _mm_loadu_si128( reinterpret_cast<const __m128i*>( source ) ) ); }
+	void Store( uint32_t* destination ) const { _mm_storeu_si128( reinterpret_cast<__m128i*>( destination ), value ); }
+	// Past the caches, straight to memory, the destination has to be aligned to the packet size
+	// Needs a StreamFence before anything else may read what was written
+	void StoreStream( uint32_t* destination ) const { _mm_stream_si128( reinterpret_cast<__m128i*>( destination ), value ); }
+
+	// A 2x2 block, lanes 0 and 1 from the upper row, 2 and 3 from the lower one
+	static Int4 LoadBlock( const uint32_t* upper, const uint32_t* lower )
+	{
+		return Int4( _mm_unpacklo_epi64( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( upper ) ),
+			_mm_loadl_epi64( reinterpret_cast<const __m128i*>( lower ) ) ) );
+	}
+	void StoreBlock( uint32_t* upper, uint32_t* lower ) const
+	{
+		_mm_storel_epi64( reinterpret_cast<__m128i*>( upper ), value );
+		_mm_storel_epi64( reinterpret_cast<__m128i*>( lower ), _mm_unpackhi_epi64( value, value ) );
+	}
+
+	__m128i value;
+};
+
+struct Float4
+{
+	Float4() = default;
+	Float4( const float& scalar )
+		: value( _mm_set1_ps( scalar ) )
+	{
+	}
+	Float4( const float& a, const float& b, const float& c, const float& d )
+		: value( _mm_setr_ps( a, b, c, d ) )
+	{
+	}
+	explicit Float4( const __m128& value )
+		: value( value )
+	{
+	}
+
+	static Float4 Load( const float* source ) { return Float4( _mm_loadu_ps( source ) ); }
+	void Store( float* destination ) const { _mm_storeu_ps( destination, value ); }
+
+	static Float4 LoadBlock( const float* upper, const float* lower )
+	{
+		const __m128 low = _mm_castpd_ps( _mm_load_sd( reinterpret_cast<const double*>( upper ) ) );
+		return Float4( _mm_loadh_pi( low, reinterpret_cast<const __m64*>( lower ) ) );
+	}
+	void StoreBlock( float* upper, float* lower ) const
+	{
+		_mm_storel_pi( reinterpret_cast<__m64*>( upper ), value );
+		_mm_storeh_pi( reinterpret_cast<__m64*>( lower ), value );
+	}
+
+	float operator[]( const int& lane ) const
+	{
+		alignas( 16 ) float lanes[4];
+		_mm_store_ps( lanes, value );
+		return lanes[lane];
+	}
+
+	Float4 operator+( const Float4& other ) const { return Float4( _mm_add_ps( value, other.value ) ); }
+	Float4 operator-( const Float4& other ) const { return Float4( _mm_sub_ps( value, other.value ) ); }
+	Float4 operator*( const Float4& other ) const { return Float4( _mm_mul_ps( value, other.value ) ); }
+	Float4 operator/( const Float4& other ) const { return Float4( _mm_div_ps( value, other.value ) ); }
+
+	Mask4 operator<( const Float4& other ) const { return Mask4( _mm_cmplt_ps( value, other.value ) ); }
+	Mask4 operator<=( const Float4& other ) const { return Mask4( _mm_cmple_ps( value, other.value ) ); }
+	Mask4 operator>( const Float4& other ) const { return Mask4( _mm_cmpgt_ps( value, other.value ) ); }
+	Mask4 operator>=( const Float4& other ) const { return Mask4( _mm_cmpge_ps( value, other.value ) ); }
+	Mask4 operator==( const Float4& other ) const { return Mask4( _mm_cmpeq_ps( value, other.value ) ); }
+
+	__m128 value;
+};
+
+inline Float4 Min( const Float4& a, const Float4& b ) { return Float4( _mm_min_ps( a.value, b.value ) ); }
+inline Float4 Max( const Float4& a, const Float4& b ) { return Float4( _mm_max_ps( a.value, b.value ) ); }
+inline Float4 Sqrt( const Float4& value ) { return Float4( _mm_sqrt_ps( value.value ) ); }
+
+// Picks b where the mask is set, a elsewhere
+inline Float4 Select( const Mask4& mask, const Float4& a, const Float4& b )
+{
+	return Float4( _mm_or_ps( _mm_and_ps( mask.value, b.value ), _mm_andnot_ps( mask.value, a.value ) ) );
+}
+
+inline Int4 Select( const Mask4& mask, const Int4& a, const Int4& b )
+{
+	const __m128i mask32 = _mm_castps_si128( mask.value );
+	return Int4( _mm_or_si128( _mm_and_si128( mask32, b.value ), _mm_andnot_si128( mask32, a.value ) ) );
+}
+
+// SSE2 has no rounding instruction, so truncate and then fix up the negative ones
+inline Float4 Floor( const Float4& value )
+{
+	const __m128 truncated = _mm_cvtepi32_ps( _mm_cvttps_epi32( value.value ) );
+	return Float4( _mm_sub_ps( truncated, _mm_and_ps( _mm_cmpgt_ps( truncated, value.value ), _mm_set1_ps( 1.0f ) ) ) );
+}
+
+// Towards zero
+inline Int4 ToInt( const Float4& value )
+{
+	return Int4( _mm_cvttps_epi32( value.value ) );
+}
+
+// The lanes as signed integers
+inline Float4 ToFloat( const Int4& value )
+{
+	return Float4( _mm_cvtepi32_ps( value.value ) );
+}
+
+inline Int4 operator&( const Int4& a, const Int4& b ) { return Int4( _mm_and_si128( a.value, b.value ) ); }
+inline Int4 operator|( const Int4& a, const Int4& b ) { return Int4( _mm_or_si128( a.value, b.value ) ); }
+inline Mask4 operator==( const Int4& a, const Int4& b ) { return Mask4( _mm_castsi128_ps( _mm_cmpeq_epi32( a.value, b.value ) ) ); }
+template<int Bits> inline Int4 ShiftLeft( const Int4& value ) { return Int4( _mm_slli_epi32( value.value, Bits ) ); }
+// Shifts in zeroes
+template<int Bits> inline Int4 ShiftRight( const Int4& value ) { return Int4( _mm_srli_epi32( value.value, Bits ) ); }
+
+// texels[y * width + x] for every lane, SSE2 has no gathers
+inline Int4 Gather( const uint32_t* texels, const Int4& x, const Int4& y, const uint32_t& width )
+{
+	alignas( 16 ) int32_t xs[4];
+	alignas( 16 ) int32_t ys[4];
+	_mm_store_si128( reinterpret_cast<__m128i*>( xs ), x.value );
+	_mm_store_si128( reinterpret_cast<__m128i*>( ys ), y.value );
+	return Int4( _mm_setr_epi32( int( texels[size_t( ys[0] ) * width + xs[0]] ), int( texels[size_t( ys[1] ) * width + xs[1]] ),
+		int( texels[size_t( ys[2] ) * width + xs[2]] ), int( texels[size_t( ys[3] ) * width + xs[3]] ) ) );
+}
+
+// Colour channels in [0, 1] into ARGB8888
+inline Int4 PackColor( const Float4& r, const Float4& g, const Float4& b, const Float4& a )
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps( 1.0f );
+	const __m128 scale = _mm_set1_ps( 255.0f );
+	const auto channel = [&]( const Float4& value )
+	{
+		return _mm_cvtps_epi32( _mm_mul_ps( _mm_min_ps( _mm_max_ps( value.value, zero ), one ), scale ) );
+	};
+
+	return Int4( _mm_or_si128( _mm_or_si128( _mm_slli_epi32( channel( a ), 24 ), _mm_slli_epi32( channel( r ), 16 ) ),
+		_mm_or_si128( _mm_slli_epi32( channel( g ), 8 ), channel( b ) ) ) );
+}
+
+// ARGB8888 into channels in [0, 1]
+inline void UnpackColor( const Int4& color, Float4& r, Float4& g, Float4& b, Float4& a )
+{
+	const __m128i byteMask = _mm_set1_epi32( 0xFF );
+	const __m128 scale = _mm_set1_ps( 1.0f / 255.0f );
+	r = Float4( _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( color.value, 16 ), byteMask ) ), scale ) );
+	g = Float4( _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( color.value, 8 ), byteMask ) ), scale ) );
+	b = Float4( _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( color.value, byteMask ) ), scale ) );
+	a = Float4( _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( color.value, 24 ) ), scale ) );
+}
+#else
+struct Mask4
+{
+	Mask4() = default;
+
+	Mask4 operator&( const Mask4& other ) const { return FromBits( bits & other.bits ); }
+	Mask4 operator|( const Mask4& other ) const { return FromBits( bits | other.bits ); }
+	Mask4 AndNot( const Mask4& other ) const { return FromBits( bits & ~other.bits ); }
+
+	int GetBits() const { return bits; }
+	bool Any() const { return bits != 0; }
+
+	static Mask4 FromBool( const bool& set ) { return FromBits( set ? 0xF : 0 ); }
+
+	static Mask4 FromBits( const int& bits )
+	{
+		Mask4 mask;
+		mask.bits = bits & 0xF;
+		return mask;
+	}
+
+	int bits{ 0 };
+};
+
+struct Int4
+{
+	Int4() = default;
+	Int4( const uint32_t& scalar )
+		: lanes{ scalar, scalar, scalar, scalar }
+	{
+	}
+
+	static Int4 Load( const uint32_t* source ) { Int4 result; for ( int i = 0; i < 4; i++ ) result.lanes[i] = source[i]; return result; }
+	void Store( uint32_t* destination ) const { for ( int i = 0; i < 4; i++ ) destination[i] = lanes[i]; }
+	void StoreStream( uint32_t* destination ) const { Store( destination ); }
+
+	static Int4 LoadBlock( const uint32_t* upper, const uint32_t* lower )
+	{
+		Int4 result;
+		result.lanes[0] = upper[0]; result.lanes[1] = upper[1]; result.lanes[2] = lower[0]; result.lanes[3] = lower[1];
+		return result;
+	}
+	void StoreBlock( uint32_t* upper, uint32_t* lower ) const { upper[0] = lanes[0]; upper[1] = lanes[1]; lower[0] = lanes[2]; lower[1] = lanes[3]; }
+
+	uint32_t lanes[4];
+};
+
+struct Float4
+{
+	Float4() = default;
+	Float4( const float& scalar )
+		: lanes{ scalar, scalar, scalar, scalar }
+	{
+	}
+	Float4( const float& a, const float& b, const float& c, const float& d )
+		: lanes{ a, b, c, d }
+	{
+	}
+
+	static Float4 Load( const float* source ) { return Float4( source[0], source[1], source[2], source[3] ); }
+	void Store( float* destination ) const { for ( int i = 0; i < 4; i++ ) destination[i] = lanes[i]; }
+
+	static Float4 LoadBlock( const float* upper, const float* lower ) { return Float4( upper[0], upper[1], lower[0], lower[1] ); }
+	void StoreBlock( float* upper, float* lower ) const { upper[0] = lanes[0]; upper[1] = lanes[1]; lower[0] = lanes[2]; lower[1] = lanes[3]; }
+
+	float operator[]( const int& lane ) const { return lanes[lane]; }
+
+	template<typename Operation>
+	Float4 Apply( const Float4& other, Operation&& operation ) const
+	{
+		return Float4( operation( lanes[0], other.lanes[0] ), operation( lanes[1], other.lanes[1] ),
+			operation( lanes[2], other.lanes[2] ), operation( lanes[3], other.lanes[3] ) );
+	}
+
+	template<typename Operation>
+	Mask4 Compare( const Float4& other, Operation&& operation ) const
+	{
+		int bits = 0;
+		for ( int i = 0; i < 4; i++ ) bits |= operation( lanes[i], other.lanes[i] ) ? (1 << i) : 0;
+		return Mask4::FromBits( bits );
+	}
+
+	Float4 operator+( const Float4& other ) const { return Apply( other, []( float a, float b ) { return a + b; } ); }
+	Float4 operator-( const Float4& other ) const { return Apply( other, []( float a, float b ) { return a - b; } ); }
+	Float4 operator*( const Float4& other ) const { return Apply( other, []( float a, float b ) { return a * b; } ); }
+	Float4 operator/( const Float4& other ) const { return Apply( other, []( float a, float b ) { return a / b; } ); }
+
+	Mask4 operator<( const Float4& other ) const { return Compare( other, []( float a, float b ) { return a < b; } ); }
+	Mask4 operator<=( const Float4& other ) const { return Compare( other, []( float a, float b ) { return a <= b; } ); }
+	Mask4 operator>( const Float4& other ) const { return Compare( other, []( float a, float b ) { return a > b; } ); }
+	Mask4 operator>=( const Float4& other ) const { return Compare( other, []( float a, float b ) { return a >= b; } ); }
+	Mask4 operator==( const Float4& other ) const { return Compare( other, []( float a, float b ) { return a == b; } ); }
+
+	float lanes[4];
+};
+
+inline Float4 Min( const Float4& a, const Float4& b ) { return a.Apply( b, []( float x, float y ) { return x < y ? x : y; } ); }
+inline Float4 Max( const Float4& a, const Float4& b ) { return a.Apply( b, []( float x, float y ) { return x > y ? x : y; } ); }
+inline Float4 Sqrt( const Float4& value ) { return value.Apply( value, []( float x, float ) { return sqrtf( x ); } ); }
+
+inline Float4 Select( const Mask4& mask, const Float4& a, const Float4& b )
+{
+	Float4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = (mask.bits & (1 << i)) ? b.lanes[i] : a.lanes[i];
+	return result;
+}
+
+inline Int4 Select( const Mask4& mask, const Int4& a, const Int4& b )
+{
+	Int4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = (mask.bits & (1 << i)) ? b.lanes[i] : a.lanes[i];
+	return result;
+}
+
+inline Float4 Floor( const Float4& value )
+{
+	Float4 result;
+	for ( int i = 0; i < 4; i++ )
+	{
+		const float truncated = float( int( value.lanes[i] ) );
+		result.lanes[i] = truncated > value.lanes[i] ? truncated - 1.0f : truncated;
+	}
+	return result;
+}
+
+inline Int4 ToInt( const Float4& value )
+{
+	Int4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = uint32_t( int( value.lanes[i] ) );
+	return result;
+}
+
+inline Float4 ToFloat( const Int4& value )
+{
+	return Float4( float( int( value.lanes[0] ) ), float( int( value.lanes[1] ) ), float( int( value.lanes[2] ) ), float( int( value.lanes[3] ) ) );
+}
+
+inline Int4 operator&( const Int4& a, const Int4& b )
+{
+	Int4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = a.lanes[i] & b.lanes[i];
+	return result;
+}
+
+inline Int4 operator|( const Int4& a, const Int4& b )
+{
+	Int4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = a.lanes[i] | b.lanes[i];
+	return result;
+}
+
+inline Mask4 operator==( const Int4& a, const Int4& b )
+{
+	int bits = 0;
+	for ( int i = 0; i < 4; i++ ) bits |= (a.lanes[i] == b.lanes[i] ? 1 : 0) << i;
+	return Mask4::FromBits( bits );
+}
+
+template<int Bits>
+inline Int4 ShiftLeft( const Int4& value )
+{
+	Int4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = value.lanes[i] << Bits;
+	return result;
+}
+
+template<int Bits>
+inline Int4 ShiftRight( const Int4& value )
+{
+	Int4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = value.lanes[i] >> Bits;
+	return result;
+}
+
+inline Int4 Gather( const uint32_t* texels, const Int4& x, const Int4& y, const uint32_t& width )
+{
+	Int4 result;
+	for ( int i = 0; i < 4; i++ ) result.lanes[i] = texels[size_t( y.lanes[i] ) * width + x.lanes[i]];
+	return result;
+}
+
+inline Int4 PackColor( const Float4& r, const Float4& g, const Float4& b, const Float4& a )
+{
+	const auto channel = []( const float& value )
+	{
+		return uint32_t( (value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value) * 255.0f + 0.5f );
+	};
+
+	Int4 result;
+	for ( int i = 0; i < 4; i++ )
+	{
+		result.lanes[i] = (channel( a[i] ) << 24) | (channel( r[i] ) << 16) | (channel( g[i] ) << 8) | channel( b[i] );
+	}
+	return result;
+}
+
+inline void UnpackColor( const Int4& color, Float4& r, Float4& g, Float4& b, Float4& a )
+{
+	const auto channel = [&color]( const int& lane, const int& shift )
+	{
+		return ((color.lanes[lane] >> shift) & 0xFF) * (1.0f / 255.0f);
+	};
+
+	r = Float4( channel( 0, 16 ), channel( 1, 16 ), channel( 2, 16 ), channel( 3, 16 ) );
+	g = Float4( channel( 0, 8 ), channel( 1, 8 ), channel( 2, 8 ), channel( 3, 8 ) );
+	b = Float4( channel( 0, 0 ), channel( 1, 0 ), channel( 2, 0 ), channel( 3, 0 ) );
+	a = Float4( channel( 0, 24 ), channel( 1, 24 ), channel( 2, 24 ), channel( 3, 24 ) );
+}
+#endif
+
+#if THE_AVX2
+struct Mask8
+{
+	Mask8() = default;
+	explicit Mask8( const __m256& value )
+		: value( value )
+	{
+	}
+
+	Mask8 operator&( const Mask8& other ) const { return Mask8( _mm256_and_ps( value, other.value ) ); }
+	Mask8 operator|( const Mask8& other ) const { return Mask8( _mm256_or_ps( value, other.value ) ); }
+	Mask8 AndNot( const Mask8& other ) const { return Mask8( _mm256_andnot_ps( other.value, value ) ); }
+
+	int GetBits() const { return _mm256_movemask_ps( value ); }
+	bool Any() const { return GetBits() != 0; }
+
+	static Mask8 FromBool( const bool& set ) { return Mask8( _mm256_castsi256_ps( _mm256_set1_epi32( set ? -1 : 0 ) ) ); }
+
+	__m256 value;
+};
+
+struct Int8
+{
+	Int8() = default;
+	Int8( const uint32_t& scalar )
+		: value( _mm256_set1_epi32( int( scalar ) ) )
+	{
+	}
+	explicit Int8( const __m256i& value )
+		: value( value )
+	{
+	}
+
+	static Int8 Load( const uint32_t* source ) { return Int8( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( source ) ) ); }
+	void Store( uint32_t* destination ) const { _mm256_storeu_si256( reinterpret_cast<__m256i*>( destination ), value ); }
+	void StoreStream( uint32_t* destination ) const { _mm256_stream_si256( reinterpret_cast<__m256i*>( destination ), value ); }
+
+	// A 4x2 block
+	static Int8 LoadBlock( const uint32_t* upper, const uint32_t* lower )
+	{
+		return Int8( _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( upper ) ) ),
+			_mm_loadu_si128( reinterpret_cast<const __m128i*>( lower ) ), 1 ) );
+	}
+	void StoreBlock( uint32_t* upper, uint32_t* lower ) const
+	{
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( upper ), _mm256_castsi256_si128( value ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>( lower ), _mm256_extracti128_si256( value, 1 ) );
+	}
+
+	__m256i value;
+};
+
+struct Float8
+{
+	Float8() = default;
+	Float8( const float& scalar )
+		: value( _mm256_set1_ps( scalar ) )
+	{
+	}
+	explicit Float8( const __m256& value )
+		: value( value )
+	{
+	}
+
+	static Float8 Load( const float* source ) { return Float8( _mm256_loadu_ps( source ) ); }
+	void Store( float* destination ) const { _mm256_storeu_ps( destination, value ); }
+
+	static Float8 LoadBlock( const float* upper, const float* lower )
+	{
+		return Float8( _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( upper ) ), _mm_loadu_ps( lower ), 1 ) );
+	}
+	void StoreBlock( float* upper, float* lower ) const
+	{
+		_mm_storeu_ps( upper, _mm256_castps256_ps128( value ) );
+		_mm_storeu_ps( lower, _mm256_extractf128_ps( value, 1 ) );
+	}
+
+	float operator[]( const int& lane ) const
+	{
+		alignas( 32 ) float lanes[8];
+		_mm256_store_ps( lanes, value );
+		return lanes[lane];
+	}
+
+	Float8 operator+( const Float8& other ) const { return Float8( _mm256_add_ps( value, other.value ) ); }
+	Float8 operator-( const Float8& other ) const { return Float8( _mm256_sub_ps( value, other.value ) ); }
+	Float8 operator*( const Float8& other ) const { return Float8( _mm256_mul_ps( value, other.value ) ); }
+	Float8 operator/( const Float8& other ) const { return Float8( _mm256_div_ps( value, other.value ) ); }
+
+	Mask8 operator<( const Float8& other ) const { return Mask8( _mm256_cmp_ps( value, other.value, _CMP_LT_OQ ) ); }
+	Mask8 operator<=( const Float8& other ) const { return Mask8( _mm256_cmp_ps( value, other.value, _CMP_LE_OQ ) ); }
+	Mask8 operator>( const Float8& other ) const { return Mask8( _mm256_cmp_ps( value, other.value, _CMP_GT_OQ ) ); }
+	Mask8 operator>=( const Float8& other ) const { return Mask8( _mm256_cmp_ps( value, other.value, _CMP_GE_OQ ) ); }
+	Mask8 operator==( const Float8& other ) const { return Mask8( _mm256_cmp_ps( value, other.value, _CMP_EQ_OQ ) ); }
+
+	__m256 value;
+};
+
+inline Float8 Min( const Float8& a, const Float8& b ) { return Float8( _mm256_min_ps( a.value, b.value ) ); }
+inline Float8 Max( const Float8& a, const Float8& b ) { return Float8( _mm256_max_ps( a.value, b.value ) ); }
+inline Float8 Sqrt( const Float8& value ) { return Float8( _mm256_sqrt_ps( value.value ) ); }
+
+inline Float8 Select( const Mask8& mask, const Float8& a, const Float8& b )
+{
+	return Float8( _mm256_blendv_ps( a.value, b.value, mask.value ) );
+}
+
+inline Int8 Select( const Mask8& mask, const Int8& a, const Int8& b )
+{
+	return Int8( _mm256_castps_si256( _mm256_blendv_ps( _mm256_castsi256_ps( a.value ), _mm256_castsi256_ps( b.value ), mask.value ) ) );
+}
+
+inline Float8 Floor( const Float8& value )
+{
+	return Float8( _mm256_floor_ps( value.value ) );
+}
+
+inline Int8 ToInt( const Float8& value )
+{
+	return Int8( _mm256_cvttps_epi32( value.value ) );
+}
+
+inline Float8 ToFloat( const Int8& value )
+{
+	return Float8( _mm256_cvtepi32_ps( value.value ) );
+}
+
+inline Int8 operator&( const Int8& a, const Int8& b ) { return Int8( _mm256_and_si256( a.value, b.value ) ); }
+inline Int8 operator|( const Int8& a, const Int8& b ) { return Int8( _mm256_or_si256( a.value, b.value ) ); }
+inline Mask8 operator==( const Int8& a, const Int8& b ) { return Mask8( _mm256_castsi256_ps( _mm256_cmpeq_epi32( a.value, b.value ) ) ); }
+template<int Bits> inline Int8 ShiftLeft( const Int8& value ) { return Int8( _mm256_slli_epi32( value.value, Bits ) ); }
+template<int Bits> inline Int8 ShiftRight( const Int8& value ) { return Int8( _mm256_srli_epi32( value.value, Bits ) ); }
+
+inline Int8 Gather( const uint32_t* texels, const Int8& x, const Int8& y, const uint32_t& width )
+{
+	const __m256i index = _mm256_add_epi32( _mm256_mullo_epi32( y.value, _mm256_set1_epi32( int( width ) ) ), x.value );
+	return Int8( _mm256_i32gather_epi32( reinterpret_cast<const int*>( texels ), index, 4 ) );
+}
+
+inline Int8 PackColor( const Float8& r, const Float8& g, const Float8& b, const Float8& a )
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps( 1.0f );
+	const __m256 scale = _mm256_set1_ps( 255.0f );
+	const auto channel = [&]( const Float8& value )
+	{
+		return _mm256_cvtps_epi32( _mm256_mul_ps( _mm256_min_ps( _mm256_max_ps( value.value, zero ), one ), scale ) );
+	};
+
+	return Int8( _mm256_or_si256( _mm256_or_si256( _mm256_slli_epi32( channel( a ), 24 ), _mm256_slli_epi32( channel( r ), 16 ) ),
+		_mm256_or_si256( _mm256_slli_epi32( channel( g ), 8 ), channel( b ) ) ) );
+}
+
+inline void UnpackColor( const Int8& color, Float8& r, Float8& g, Float8& b, Float8& a )
+{
+	const __m256i byteMask = _mm256_set1_epi32( 0xFF );
+	const __m256 scale = _mm256_set1_ps( 1.0f / 255.0f );
+	r = Float8( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( color.value, 16 ), byteMask ) ), scale ) );
+	g = Float8( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( color.value, 8 ), byteMask ) ), scale ) );
+	b = Float8( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256( color.value, byteMask ) ), scale ) );
+	a = Float8( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_srli_epi32( color.value, 24 ) ), scale ) );
+}
+#endif
+
+#if THE_AVX512
+// AVX-512 compares give one bit per lane instead of a vector
+struct Mask16
+{
+	Mask16() = default;
+	explicit Mask16( const __mmask16& value )
+		: value( value )
+	{
+	}
+
+	Mask16 operator&( const Mask16& other ) const { return Mask16( __mmask16( value & other.value ) ); }
+	Mask16 operator|( const Mask16& other ) const { return Mask16( __mmask16( value | other.value ) ); }
+	Mask16 AndNot( const Mask16& other ) const { return Mask16( __mmask16( value & ~other.value ) ); }
+
+	int GetBits() const { return value; }
+	bool Any() const { return value != 0; }
+
+	static Mask16 FromBool( const bool& set ) { return Mask16( __mmask16( set ? 0xFFFF : 0 ) ); }
+
+	__mmask16 value;
+};
+
+struct Int16
+{
+	Int16() = default;
+	Int16( const uint32_t& scalar )
+		: value( _mm512_set1_epi32( int( scalar ) ) )
+	{
+	}
+	explicit Int16( const __m512i& value )
+		: value( value )
+	{
+	}
+
+	static Int16 Load( const uint32_t* source ) { return Int16( _mm512_loadu_si512( source ) ); }
+	void Store( uint32_t* destination ) const { _mm512_storeu_si512( destination, value ); }
+	void StoreStream( uint32_t* destination ) const { _mm512_stream_si512( reinterpret_cast<__m512i*>( destination ), value ); }
+
+	// An 8x2 block
+	static Int16 LoadBlock( const uint32_t* upper, const uint32_t* lower )
+	{
+		return Int16( _mm512_inserti64x4( _mm512_castsi256_si512( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( upper ) ) ),
+			_mm256_loadu_si256( reinterpret_cast<const __m256i*>( lower ) ), 1 ) );
+	}
+	void StoreBlock( uint32_t* upper, uint32_t* lower ) const
+	{
+		_mm256_storeu_si256( reinterpret_cast<__m256i*>( upper ), _mm512_castsi512_si256( value ) );
+		_mm256_storeu_si256( reinterpret_cast<__m256i*>( lower ), _mm512_extracti64x4_epi64( value, 1 ) );
+	}
+
+	__m512i value;
+};
+
+struct Float16
+{
+	Float16() = default;
+	Float16( const float& scalar )
+		: value( _mm512_set1_ps( scalar ) )
+	{
+	}
+	explicit Float16( const __m512& value )
+		: value( value )
+	{
+	}
+
+	static Float16 Load( const float* source ) { return Float16( _mm512_loadu_ps( source ) ); }
+	void Store( float* destination ) const { _mm512_storeu_ps( destination, value ); }
+
+	static Float16 LoadBlock( const float* upper, const float* lower )
+	{
+		return Float16( _mm512_insertf32x8( _mm512_castps256_ps512( _mm256_loadu_ps( upper ) ), _mm256_loadu_ps( lower ), 1 ) );
+	}
+	void StoreBlock( float* upper, float* lower ) const
+	{
+		_mm256_storeu_ps( upper, _mm512_castps512_ps256( value ) );
+		_mm256_storeu_ps( lower, _mm512_extractf32x8_ps( value, 1 ) );
+	}
+
+	float operator[]( const int& lane ) const
+	{
+		alignas( 64 ) float lanes[16];
+		_mm512_store_ps( lanes, value );
+		return lanes[lane];
+	}
+
+	Float16 operator+( const Float16& other ) const { return Float16( _mm512_add_ps( value, other.value ) ); }
+	Float16 operator-( const Float16& other ) const { return Float16( _mm512_sub_ps( value, other.value ) ); }
+	Float16 operator*( const Float16& other ) const { return Float16( _mm512_mul_ps( value, other.value ) ); }
+	Float16 operator/( const Float16& other ) const { return Float16( _mm512_div_ps( value, other.value ) ); }
+
+	Mask16 operator<( const Float16& other ) const { return Mask16( _mm512_cmp_ps_mask( value, other.value, _CMP_LT_OQ ) ); }
+	Mask16 operator<=( const Float16& other ) const { return Mask16( _mm512_cmp_ps_mask( value, other.value, _CMP_LE_OQ ) ); }
+	Mask16 operator>( const Float16& other ) const { return Mask16( _mm512_cmp_ps_mask( value, other.value, _CMP_GT_OQ ) ); }
+	Mask16 operator>=( const Float16& other ) const { return Mask16( _mm512_cmp_ps_mask( value, other.value, _CMP_GE_OQ ) ); }
+	Mask16 operator==( const Float16& other ) const { return Mask16( _mm512_cmp_ps_mask( value, other.value, _CMP_EQ_OQ ) ); }
+
+	__m512 value;
+};
+
+inline Float16 Min( const Float16& a, const Float16& b ) { return Float16( _mm512_min_ps( a.value, b.value ) ); }
+inline Float16 Max( const Float16& a, const Float16& b ) { return Float16( _mm512_max_ps( a.value, b.value ) ); }
+inline Float16 Sqrt( const Float16& value ) { return Float16( _mm512_sqrt_ps( value.value ) ); }
+
+inline Float16 Select( const Mask16& mask, const Float16& a, const Float16& b )
+{
+	return Float16( _mm512_mask_blend_ps( mask.value, a.value, b.value ) );
+}
+
+inline Int16 Select( const Mask16& mask, const Int16& a, const Int16& b )
+{
+	return Int16( _mm512_mask_blend_epi32( mask.value, a.value, b.value ) );
+}
+
+inline Float16 Floor( const Float16& value )
+{
+	return Float16( _mm512_roundscale_ps( value.value, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC ) );
+}
+
+inline Int16 ToInt( const Float16& value )
+{
+	return Int16( _mm512_cvttps_epi32( value.value ) );
+}
+
+inline Float16 ToFloat( const Int16& value )
+{
+	return Float16( _mm512_cvtepi32_ps( value.value ) );
+}
+
+inline Int16 operator&( const Int16& a, const Int16& b ) { return Int16( _mm512_and_si512( a.value, b.value ) ); }
+inline Int16 operator|( const Int16& a, const Int16& b ) { return Int16( _mm512_or_si512( a.value, b.value ) ); }
+inline Mask16 operator==( const Int16& a, const Int16& b ) { return Mask16( _mm512_cmpeq_epi32_mask( a.value, b.value ) ); }
+template<int Bits> inline Int16 ShiftLeft( const Int16& value ) { return Int16( _mm512_slli_epi32( value.value, Bits ) ); }
+template<int Bits> inline Int16 ShiftRight( const Int16& value ) { return Int16( _mm512_srli_epi32( value.value, Bits ) ); }
+
+inline Int16 Gather( const uint32_t* texels, const Int16& x, const Int16& y, const uint32_t& width )
+{
+	const __m512i index = _mm512_add_epi32( _mm512_mullo_epi32( y.value, _mm512_set1_epi32( int( width ) ) ), x.value );
+	return Int16( _mm512_i32gather_epi32( index, texels, 4 ) );
+}
+
+inline Int16 PackColor( const Float16& r, const Float16& g, const Float16& b, const Float16& a )
+{
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 one = _mm512_set1_ps( 1.0f );
+	const __m512 scale = _mm512_set1_ps( 255.0f );
+	const auto channel = [&]( const Float16& value )
+	{
+		return _mm512_cvtps_epi32( _mm512_mul_ps( _mm512_min_ps( _mm512_max_ps( value.value, zero ), one ), scale ) );
+	};
+
+	return Int16( _mm512_or_si512( _mm512_or_si512( _mm512_slli_epi32( channel( a ), 24 ), _mm512_slli_epi32( channel( r ), 16 ) ),
+		_mm512_or_si512( _mm512_slli_epi32( channel( g ), 8 ), channel( b ) ) ) );
+}
+
+inline void UnpackColor( const Int16& color, Float16& r, Float16& g, Float16& b, Float16& a )
+{
+	const __m512i byteMask = _mm512_set1_epi32( 0xFF );
+	const __m512 scale = _mm512_set1_ps( 1.0f / 255.0f );
+	r = Float16( _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_and_si512( _mm512_srli_epi32( color.value, 16 ), byteMask ) ), scale ) );
+	g = Float16( _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_and_si512( _mm512_srli_epi32( color.value, 8 ), byteMask ) ), scale ) );
+	b = Float16( _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_and_si512( color.value, byteMask ) ), scale ) );
+	a = Float16( _mm512_mul_ps( _mm512_cvtepi32_ps( _mm512_srli_epi32( color.value, 24 ) ), scale ) );
+}
+#endif
+
+// The widest packets this file is compiled for
+#if THE_AVX512
+using FloatPacket = Float16;
+using IntPacket = Int16;
+using MaskPacket = Mask16;
+constexpr int PacketWidth = 16;
+#elif THE_AVX2
+using FloatPacket = Float8;
+using IntPacket = Int8;
+using MaskPacket = Mask8;
+constexpr int PacketWidth = 8;
+#else
+using FloatPacket = Float4;
+using IntPacket = Int4;
+using MaskPacket = Mask4;
+constexpr int PacketWidth = 4;
+#endif
+
+// Pixel blocks are 2 rows of this many pixels
+constexpr int BlockWidth = PacketWidth / 2;
+
+// Makes the streaming stores before it visible to everything after it
+inline void StreamFence()
+{
+#if THE_SSE
+	_mm_sfence();
+#endif
+}
+}
+
+using namespace THE_SIMD_NAMESPACE;
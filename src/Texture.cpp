@@ -0,0 +1,327 @@
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "SDL.h"
+
+#include "MappedFile.hpp"
+#include "Memory.hpp"
+#include "Texture.hpp"
+
+constexpr uint32_t TextureFileHeader::Magic;
+constexpr uint32_t TextureFileHeader::CurrentVersion;
+
+namespace
+{
+	constexpr uint64_t LevelAlignment = 64;
+
+	inline glm::vec4 UnpackColor( const uint32_t& argb )
+	{
+		return glm::vec4( (argb >> 16) & 0xFF, (argb >> 8) & 0xFF, argb & 0xFF, argb >> 24 ) * (1.0f / 255.0f);
+	}
+
+	// Repeat addressing that also works for non-power-of-two sizes
+	inline uint32_t Wrap( const int& coord, const uint32_t& size )
+	{
+		const int wrapped = coord % int( size );
+		return wrapped < 0 ? wrapped + size : wrapped;
+	}
+
+	using TextureLevel = TrackedVector<uint32_t, MemoryTag::Texture>;
+
+	// 2x2 box filter, the last row/column gets reused on odd sizes
+	TextureLevel Downsample( const TextureLevel& source, const uint32_t& width, const uint32_t& height )
+	{
+		const uint32_t newWidth = glm::max( width / 2, 1U );
+		const uint32_t newHeight = glm::max( height / 2, 1U );
+		TextureLevel result( size_t( newWidth ) * newHeight );
+
+		for ( uint32_t y = 0; y < newHeight; y++ )
+		{
+			const uint32_t y0 = glm::min( y * 2, height - 1 );
+			const uint32_t y1 = glm::min( y * 2 + 1, height - 1 );
+			for ( uint32_t x = 0; x < newWidth; x++ )
+			{
+				const uint32_t x0 = glm::min( x * 2, width - 1 );
+				const uint32_t x1 = glm::min( x * 2 + 1, width - 1 );
+				const uint32_t texels[4]
+				{
+					source[size_t( y0 ) * width + x0], source[size_t( y0 ) * width + x1],
+					source[size_t( y1 ) * width + x0], source[size_t( y1 ) * width + x1]
+				};
+
+				uint32_t packed = 0;
+				for ( uint32_t shift = 0; shift < 32; shift += 8 )
+				{
+					uint32_t sum = 2; // Rounding
+					for ( const uint32_t& texel : texels )
+					{
+						sum += (texel >> shift) & 0xFF;
+					}
+					packed |= (sum / 4) << shift;
+				}
+				result[size_t( y ) * newWidth + x] = packed;
+			}
+		}
+
+		return result;
+	}
+
+	// Decodes the source image and writes out its whole mip chain
+	bool BuildTextureFile( const char* sourcePath, const char* path )
+	{
+		TextureFileHeader header{};
+		header.magic = TextureFileHeader::Magic;
+		header.version = TextureFileHeader::CurrentVersion;
+		if ( !GetFileStamp( sourcePath, header.sourceSize, header.sourceTime ) )
+		{
+			return false;
+		}
+
+		SDL_Surface* loaded = SDL_LoadBMP( sourcePath );
+		if ( loaded == nullptr )
+		{
+			return false;
+		}
+
+		SDL_Surface* surface = SDL_ConvertSurfaceFormat( loaded, SDL_PIXELFORMAT_ARGB8888, 0 );
+		SDL_FreeSurface( loaded );
+		if ( surface == nullptr )
+		{
+			return false;
+		}
+
+		header.width = surface->w;
+		header.height = surface->h;
+
+		TrackedVector<TextureLevel, MemoryTag::Texture> levels( 1 );
+		levels[0].resize( size_t( header.width ) * header.height );
+		SDL_LockSurface( surface );
+		for ( uint32_t y = 0; y < header.height; y++ )
+		{
+			std::memcpy( &levels[0][size_t( y ) * header.width], static_cast<const char*>( surface->pixels ) + size_t( y ) * surface->pitch,
+				header.width * sizeof( uint32_t ) );
+		}
+		SDL_UnlockSurface( surface );
+		SDL_FreeSurface( surface );
+
+		uint32_t width = header.width;
+		uint32_t height = header.height;
+		while ( (width > 1 || height > 1) && levels.size() < MaxMipLevels )
+		{
+			levels.push_back( Downsample( levels.back(), width, height ) );
+			width = glm::max( width / 2, 1U );
+			height = glm::max( height / 2, 1U );
+		}
+		header.levelCount = levels.size();
+
+		uint64_t offset = sizeof( TextureFileHeader );
+		for ( uint32_t level = 0; level < header.levelCount; level++ )
+		{
+			offset = (offset + LevelAlignment - 1) & ~(LevelAlignment - 1);
+			header.levelOffsets[level] = offset;
+			offset += levels[level].size() * sizeof( uint32_t );
+		}
+
+		// Into a file of its own first, then renamed over the old one, so a crash or another process mapping
+		// the texture meanwhile never sees a valid header over missing levels
+		std::string temporaryPath;
+		std::FILE* file = CreateTemporaryFile( path, temporaryPath );
+		if ( file == nullptr )
+		{
+			return false;
+		}
+
+		static const char zeroes[LevelAlignment]{};
+		bool ok = std::fwrite( &header, sizeof( header ), 1, file ) == 1;
+		offset = sizeof( TextureFileHeader );
+		for ( uint32_t level = 0; level < header.levelCount && ok; level++ )
+		{
+			const uint64_t padding = header.levelOffsets[level] - offset;
+			const uint64_t size = levels[level].size() * sizeof( uint32_t );
+			ok = std::fwrite( zeroes, 1, padding, file ) == padding
+				&& std::fwrite( levels[level].data(), 1, size, file ) == size;
+			offset = header.levelOffsets[level] + size;
+		}
+
+		ok = (std::fclose( file ) == 0) && ok;
+		return CommitTemporaryFile( temporaryPath, path, ok );
+	}
+
+	// Maps the mip chain file if it's valid and up to date with the source
+	bool MapTextureFile( const char* sourcePath, const char* path, MappedFile& file )
+	{
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if ( !GetFileStamp( sourcePath, sourceSize, sourceTime ) )
+		{
+			return false;
+		}
+
+		if ( !file.Open( path ) || file.GetSize() < sizeof( TextureFileHeader ) )
+		{
+			return false;
+		}
+
+		const TextureFileHeader& header = *reinterpret_cast<const TextureFileHeader*>( file.GetData() );
+		if ( header.magic != TextureFileHeader::Magic || header.version != TextureFileHeader::CurrentVersion
+			|| header.sourceSize != sourceSize || header.sourceTime != sourceTime
+			|| header.width == 0 || header.height == 0 || header.levelCount == 0 || header.levelCount > MaxMipLevels )
+		{
+			file.Close();
+			return false;
+		}
+
+		for ( uint32_t level = 0; level < header.levelCount; level++ )
+		{
+			const uint64_t size = uint64_t( glm::max( header.width >> level, 1U ) ) * glm::max( header.height >> level, 1U ) * sizeof( uint32_t );
+			if ( header.levelOffsets[level] > file.GetSize() || size > file.GetSize() - header.levelOffsets[level] )
+			{
+				file.Close();
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+Texture::Texture() = default;
+Texture::~Texture()
+{
+	// So the memory accounting sees the levels go
+	for ( uint32_t level = 0; level < MaxMipLevels; level++ )
+	{
+		Evict( level );
+	}
+}
+
+uint32_t Texture::SelectLevel( const float& lod ) const
+{
+	uint32_t level = uint32_t( glm::clamp( lod + 0.5f, 0.0f, float( levelCount - 1 ) ) );
+
+	// Only write when the bit isn't there yet, so samplers on different threads mostly just read the same cache line
+	const uint32_t bit = 1U << level;
+	if ( !(requestedLevels.load( std::memory_order_relaxed ) & bit) )
+	{
+		requestedLevels.fetch_or( bit, std::memory_order_relaxed );
+	}
+
+	// The pinned tail guarantees this stops
+	if ( levels[level] == nullptr )
+	{
+		while ( levels[level] == nullptr )
+		{
+			level++;
+		}
+
+		// Also counts as used, so it doesn't get evicted while it's the best there is
+		const uint32_t fallbackBit = 1U << level;
+		if ( !(requestedLevels.load( std::memory_order_relaxed ) & fallbackBit) )
+		{
+			requestedLevels.fetch_or( fallbackBit, std::memory_order_relaxed );
+		}
+	}
+
+	return level;
+}
+
+glm::vec4 Texture::Sample( const glm::vec2& uv, const float& lod ) const
+{
+	if ( levelCount == 0 )
+	{
+		// Magenta, the universal "something's missing"
+		return glm::vec4( 1.0f, 0.0f, 1.0f, 1.0f );
+	}
+
+	const uint32_t level = SelectLevel( lod );
+	const uint32_t levelWidth = GetWidth( level );
+	const uint32_t levelHeight = GetHeight( level );
+	const uint32_t* texels = levels[level];
+
+	const float x = uv.x * levelWidth - 0.5f;
+	const float y = uv.y * levelHeight - 0.5f;
+	const float x0 = glm::floor( x );
+	const float y0 = glm::floor( y );
+	const float fracX = x - x0;
+	const float fracY = y - y0;
+
+	const uint32_t left = Wrap( int( x0 ), levelWidth );
+	const uint32_t right = Wrap( int( x0 ) + 1, levelWidth );
+	const size_t top = size_t( Wrap( int( y0 ), levelHeight ) ) * levelWidth;
+	const size_t bottom = size_t( Wrap( int( y0 ) + 1, levelHeight ) ) * levelWidth;
+
+	const glm::vec4 upper = glm::mix( UnpackColor( texels[top + left] ), UnpackColor( texels[top + right] ), fracX );
+	const glm::vec4 lower = glm::mix( UnpackColor( texels[bottom + left] ), UnpackColor( texels[bottom + right] ), fracX );
+	return glm::mix( upper, lower, fracY );
+}
+
+std::unique_ptr<uint32_t[]> Texture::ReadLevel( const uint32_t& level ) const
+{
+	const size_t texelCount = size_t( GetWidth( level ) ) * GetHeight( level );
+	std::unique_ptr<uint32_t[]> data( new uint32_t[texelCount] );
+	std::memcpy( data.get(), file->GetData() + levelOffsets[level], texelCount * sizeof( uint32_t ) );
+	return data;
+}
+
+void Texture::MakeResident( const uint32_t& level, std::unique_ptr<uint32_t[]> data ) const
+{
+	Evict( level );
+	TrackAllocation( MemoryTag::Texture, GetLevelBytes( level ) );
+	levelStorage[level] = std::move( data );
+	levels[level] = levelStorage[level].get();
+}
+
+void Texture::Evict( const uint32_t& level ) const
+{
+	levels[level] = nullptr;
+	if ( levelStorage[level] != nullptr )
+	{
+		TrackFree( MemoryTag::Texture, GetLevelBytes( level ) );
+		levelStorage[level].reset();
+	}
+}
+
+bool LoadTexture( const char* path, Texture& outTexture )
+{
+	const std::string filePath = std::string( path ) + ".srtex";
+
+	std::unique_ptr<MappedFile> file( new MappedFile() );
+	if ( !MapTextureFile( path, filePath.c_str(), *file ) )
+	{
+		if ( !BuildTextureFile( path, filePath.c_str() ) || !MapTextureFile( path, filePath.c_str(), *file ) )
+		{
+			return false;
+		}
+	}
+
+	const TextureFileHeader& header = *reinterpret_cast<const TextureFileHeader*>( file->GetData() );
+	outTexture.width = header.width;
+	outTexture.height = header.height;
+	outTexture.levelCount = header.levelCount;
+	for ( uint32_t level = 0; level < header.levelCount; level++ )
+	{
+		outTexture.levelOffsets[level] = header.levelOffsets[level];
+	}
+	outTexture.file = std::move( file );
+
+	// Even the last level might be bigger than the pinning threshold, if the texture is huge
+	outTexture.firstPinnedLevel = outTexture.levelCount - 1;
+	for ( uint32_t level = 0; level < outTexture.levelCount; level++ )
+	{
+		if ( size_t( outTexture.GetWidth( level ) ) * outTexture.GetHeight( level ) <= PinnedLevelTexels )
+		{
+			outTexture.firstPinnedLevel = level;
+			break;
+		}
+	}
+
+	for ( uint32_t level = outTexture.firstPinnedLevel; level < outTexture.levelCount; level++ )
+	{
+		outTexture.MakeResident( level, outTexture.ReadLevel( level ) );
+	}
+
+	return true;
+}
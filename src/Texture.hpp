@@ -0,0 +1,123 @@
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "glm/glm.hpp"
+
+class MappedFile;
+
+constexpr uint32_t MaxMipLevels = 16;
+// Levels this small or smaller are always resident, so sampling always has something to fall back to
+constexpr uint32_t PinnedLevelTexels = 64 * 64;
+
+// The whole mip chain of a texture as it sits on disk, next to the source image (path + ".srtex")
+// Each level is ARGB8888, tightly packed, and starts on a 64-byte boundary
+struct TextureFileHeader
+{
+	static constexpr uint32_t Magic = 'S' | ('R' << 8) | ('T' << 16) | ('X' << 24);
+	static constexpr uint32_t CurrentVersion = 1;
+
+	uint32_t magic;
+	uint32_t version;
+
+	// Same as with mesh caches, to know when the source image changed
+	uint64_t sourceSize;
+	int64_t sourceTime;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t padding;
+
+	uint64_t levelOffsets[MaxMipLevels];
+};
+
+// A mipmapped texture of which only some levels are in memory at any time
+// The coarse tail is always resident, the finer levels get streamed in and out by the TextureCache
+class Texture
+{
+public:
+	Texture();
+	~Texture();
+
+	Texture( const Texture& ) = delete;
+	Texture& operator=( const Texture& ) = delete;
+
+	// Bilinear, from the level that lod picks, or the closest coarser one if that's not resident
+	// Notes down the level it wanted, which is what drives the streaming
+	glm::vec4 Sample( const glm::vec2& uv, const float& lod ) const;
+
+	// The level Sample would read for this lod: that one if it's resident, otherwise the closest coarser one
+	// Notes the wanted level down the same way. The texture has to have at least one level
+	uint32_t SelectLevel( const float& lod ) const;
+
+	// Null when not resident
+	const uint32_t* GetLevelTexels( const uint32_t& level ) const
+	{
+		return levels[level];
+	}
+
+	uint32_t GetWidth( const uint32_t& level = 0 ) const
+	{
+		return glm::max( width >> level, 1U );
+	}
+
+	uint32_t GetHeight( const uint32_t& level = 0 ) const
+	{
+		return glm::max( height >> level, 1U );
+	}
+
+	uint32_t GetLevelCount() const
+	{
+		return levelCount;
+	}
+
+	size_t GetLevelBytes( const uint32_t& level ) const
+	{
+		return size_t( GetWidth( level ) ) * GetHeight( level ) * sizeof( uint32_t );
+	}
+
+	bool IsLevelResident( const uint32_t& level ) const
+	{
+		return levels[level] != nullptr;
+	}
+
+	// Every level from this one onwards stays in memory
+	uint32_t GetFirstPinnedLevel() const
+	{
+		return firstPinnedLevel;
+	}
+
+private:
+	friend class TextureCache;
+	friend bool LoadTexture( const char* path, Texture& outTexture );
+
+	// Copies a level out of the mapped file, safe to call from any thread
+	std::unique_ptr<uint32_t[]> ReadLevel( const uint32_t& level ) const;
+	// These two only happen between frames, when nothing is sampling
+	// Residency isn't part of what the texture looks like, hence const
+	void MakeResident( const uint32_t& level, std::unique_ptr<uint32_t[]> data ) const;
+	void Evict( const uint32_t& level ) const;
+
+	std::unique_ptr<MappedFile> file;
+	uint64_t levelOffsets[MaxMipLevels]{};
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	uint32_t levelCount{ 0 };
+	uint32_t firstPinnedLevel{ 0 };
+
+	// Null when not resident
+	mutable const uint32_t* levels[MaxMipLevels]{};
+	mutable std::unique_ptr<uint32_t[]> levelStorage[MaxMipLevels];
+
+	// One bit per level that a sampler asked for since the cache last looked
+	mutable std::atomic<uint32_t> requestedLevels{ 0 };
+	// Bookkeeping for the cache, main thread only
+	mutable uint32_t lastUsedFrame[MaxMipLevels]{};
+	mutable bool levelStreaming[MaxMipLevels]{};
+};
+
+// Builds the mip chain file from a .bmp if it's missing or stale, maps it, and reads in the pinned levels
+bool LoadTexture( const char* path, Texture& outTexture );
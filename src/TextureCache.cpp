@@ -0,0 +1,174 @@
+
+#include <algorithm>
+
+#include "TextureCache.hpp"
+
+TextureCache::TextureCache( AssetManager& assets, ThreadPool& pool, const size_t& budgetBytes )
+	: assets( assets ), pool( pool ), completions( std::make_shared<Completions>() ), budget( budgetBytes )
+{
+}
+
+TextureCache::~TextureCache()
+{
+	std::lock_guard<std::mutex> lock( completions->mutex );
+	completions->cancelled = true;
+}
+
+AssetHandle<Texture> TextureCache::Request( const std::string& path )
+{
+	return assets.RequestTexture( path, [this]( const Asset<Texture>& asset )
+	{
+		if ( !asset.IsReady() || std::find( textures.begin(), textures.end(), asset.Get() ) != textures.end() )
+		{
+			return;
+		}
+
+		const Texture& texture = *asset.Get();
+		for ( uint32_t level = texture.GetFirstPinnedLevel(); level < texture.GetLevelCount(); level++ )
+		{
+			residentBytes += texture.GetLevelBytes( level );
+		}
+
+		textures.push_back( asset.Get() );
+	} );
+}
+
+void TextureCache::Update()
+{
+	frame++;
+
+	// Whatever got streamed in since last time can be sampled from now on
+	std::vector<StreamedLevel> streamed;
+	{
+		std::lock_guard<std::mutex> lock( completions->mutex );
+		streamed.swap( completions->finished );
+	}
+
+	for ( StreamedLevel& level : streamed )
+	{
+		level.texture->MakeResident( level.level, std::move( level.data ) );
+		level.texture->levelStreaming[level.level] = false;
+		streamingCount--;
+		// Counts as used, or it'd be the first thing to go
+		level.texture->lastUsedFrame[level.level] = frame;
+	}
+
+	// See what the samplers asked for
+	struct Wanted
+	{
+		const std::shared_ptr<const Texture>* texture;
+		uint32_t level;
+		size_t bytes;
+	};
+
+	std::vector<Wanted> wanted;
+	for ( const auto& texture : textures )
+	{
+		const uint32_t requested = texture->requestedLevels.exchange( 0, std::memory_order_relaxed );
+		for ( uint32_t level = 0; level < texture->GetLevelCount(); level++ )
+		{
+			if ( !(requested & (1U << level)) )
+			{
+				continue;
+			}
+
+			texture->lastUsedFrame[level] = frame;
+			if ( !texture->IsLevelResident( level ) && !texture->levelStreaming[level] )
+			{
+				wanted.push_back( { &texture, level, texture->GetLevelBytes( level ) } );
+			}
+		}
+	}
+
+	// Coarse levels first, they're cheap and fix the blurriest spots
+	std::sort( wanted.begin(), wanted.end(), []( const Wanted& a, const Wanted& b )
+	{
+		return a.bytes < b.bytes;
+	} );
+
+	for ( const Wanted& request : wanted )
+	{
+		if ( residentBytes + request.bytes > budget )
+		{
+			EvictLeastRecentlyUsed( residentBytes + request.bytes - budget );
+			// Everything else is in use, and the rest of the list is only bigger
+			if ( residentBytes + request.bytes > budget )
+			{
+				break;
+			}
+		}
+
+		const std::shared_ptr<const Texture>& texture = *request.texture;
+		texture->levelStreaming[request.level] = true;
+		streamingCount++;
+		residentBytes += request.bytes;
+
+		std::shared_ptr<Completions> shared = completions;
+		const uint32_t level = request.level;
+		pool.Submit( [shared, texture, level]()
+		{
+			{
+				std::lock_guard<std::mutex> lock( shared->mutex );
+				if ( shared->cancelled )
+				{
+					return;
+				}
+			}
+
+			std::unique_ptr<uint32_t[]> data = texture->ReadLevel( level );
+
+			std::lock_guard<std::mutex> lock( shared->mutex );
+			shared->finished.push_back( { texture, level, std::move( data ) } );
+		} );
+	}
+
+	// In case the budget went down
+	if ( residentBytes > budget )
+	{
+		EvictLeastRecentlyUsed( residentBytes - budget );
+	}
+}
+
+size_t TextureCache::EvictLeastRecentlyUsed( const size_t& bytesNeeded )
+{
+	struct Candidate
+	{
+		const Texture* texture;
+		uint32_t level;
+		uint32_t lastUsed;
+		size_t bytes;
+	};
+
+	std::vector<Candidate> candidates;
+	for ( const auto& texture : textures )
+	{
+		for ( uint32_t level = 0; level < texture->GetFirstPinnedLevel(); level++ )
+		{
+			if ( texture->IsLevelResident( level ) && texture->lastUsedFrame[level] < frame )
+			{
+				candidates.push_back( { texture.get(), level, texture->lastUsedFrame[level], texture->GetLevelBytes( level ) } );
+			}
+		}
+	}
+
+	// Oldest first, and among equally old ones, the biggest
+	std::sort( candidates.begin(), candidates.end(), []( const Candidate& a, const Candidate& b )
+	{
+		return a.lastUsed != b.lastUsed ? a.lastUsed < b.lastUsed : a.bytes > b.bytes;
+	} );
+
+	size_t freed = 0;
+	for ( const Candidate& candidate : candidates )
+	{
+		if ( freed >= bytesNeeded )
+		{
+			break;
+		}
+
+		candidate.texture->Evict( candidate.level );
+		residentBytes -= candidate.bytes;
+		freed += candidate.bytes;
+	}
+
+	return freed;
+}
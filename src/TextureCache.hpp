@@ -0,0 +1,72 @@
+
+#pragma once
+
+#include "AssetManager.hpp"
+
+// Keeps the resident mip levels of all textures within a memory budget
+// Samplers note which levels they wanted; each frame the cache streams in the ones that are missing,
+// coarsest first, and makes room by evicting the levels that went unused the longest
+class TextureCache
+{
+public:
+	TextureCache( AssetManager& assets, ThreadPool& pool, const size_t& budgetBytes );
+	~TextureCache();
+
+	// Loads in the background, the texture takes part in the budget once it's ready
+	AssetHandle<Texture> Request( const std::string& path );
+
+	// Call once per frame, while nothing is sampling
+	void Update();
+
+	void SetBudget( const size_t& budgetBytes )
+	{
+		budget = budgetBytes;
+	}
+
+	size_t GetBudget() const
+	{
+		return budget;
+	}
+
+	// Includes levels that are still being streamed in
+	size_t GetResidentBytes() const
+	{
+		return residentBytes;
+	}
+
+	// Levels on their way in, they're there after the Update that follows them being done
+	uint32_t GetStreamingCount() const
+	{
+		return streamingCount;
+	}
+
+private:
+	// Evicts unpinned levels that weren't used this frame, least recently used first,
+	// until at least bytesNeeded are freed. Returns how much it freed
+	size_t EvictLeastRecentlyUsed( const size_t& bytesNeeded );
+
+	struct StreamedLevel
+	{
+		std::shared_ptr<const Texture> texture;
+		uint32_t level;
+		std::unique_ptr<uint32_t[]> data;
+	};
+
+	// Shared with the streaming tasks, same as in the asset manager
+	struct Completions
+	{
+		std::mutex mutex;
+		std::vector<StreamedLevel> finished;
+		bool cancelled{ false };
+	};
+
+	AssetManager& assets;
+	ThreadPool& pool;
+	std::shared_ptr<Completions> completions;
+
+	std::vector<std::shared_ptr<const Texture>> textures;
+	size_t budget;
+	size_t residentBytes{ 0 };
+	uint32_t streamingCount{ 0 };
+	uint32_t frame{ 1 };
+};
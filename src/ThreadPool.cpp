@@ -0,0 +1,116 @@
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "PerfCounters.hpp"
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool( uint32_t threadCount )
+{
+	if ( threadCount == 0 )
+	{
+		threadCount = std::max( std::thread::hardware_concurrency(), 2U ) - 1;
+	}
+
+	workers.reserve( threadCount );
+	for ( uint32_t i = 0; i < threadCount; i++ )
+	{
+		workers.emplace_back( &ThreadPool::WorkerLoop, this );
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		quitting = true;
+		tasks.clear();
+	}
+	taskAvailable.notify_all();
+
+	for ( std::thread& worker : workers )
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit( std::function<void()> task )
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		tasks.push_back( std::move( task ) );
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::ParallelFor( const uint32_t& count, const std::function<void( uint32_t )>& function )
+{
+	if ( count == 0 )
+	{
+		return;
+	}
+
+	// Shared, since helpers that only get to run after everything is done still look at it
+	struct Job
+	{
+		const std::function<void( uint32_t )>* function;
+		uint32_t count;
+		std::atomic<uint32_t> next{ 0 };
+		std::atomic<uint32_t> finished{ 0 };
+		std::mutex mutex;
+		std::condition_variable allFinished;
+	};
+
+	auto job = std::allocate_shared<Job>( TrackedAllocator<Job, MemoryTag::Jobs>() );
+	job->function = &function;
+	job->count = count;
+
+	const auto work = [job]()
+	{
+		uint32_t index;
+		while ( (index = job->next++) < job->count )
+		{
+			(*job->function)( index );
+			// Before the job can be over, so it still counts towards the stage it was for
+			GetPerfCounters().Sample();
+			if ( ++job->finished == job->count )
+			{
+				std::lock_guard<std::mutex> lock( job->mutex );
+				job->allFinished.notify_all();
+			}
+		}
+	};
+
+	const uint32_t helpers = std::min<uint32_t>( GetThreadCount(), count - 1 );
+	for ( uint32_t i = 0; i < helpers; i++ )
+	{
+		Submit( work );
+	}
+	work();
+
+	std::unique_lock<std::mutex> lock( job->mutex );
+	job->allFinished.wait( lock, [&job]() { return job->finished == job->count; } );
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while ( true )
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock( mutex );
+			taskAvailable.wait( lock, [this]() { return quitting || !tasks.empty(); } );
+			if ( quitting )
+			{
+				return;
+			}
+
+			task = std::move( tasks.front() );
+			tasks.pop_front();
+		}
+
+		task();
+		GetPerfCounters().Sample();
+	}
+}
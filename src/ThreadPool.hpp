@@ -0,0 +1,47 @@
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Memory.hpp"
+
+// A fixed set of worker threads pulling tasks off a shared queue
+class ThreadPool
+{
+public:
+	// 0 means one less than the number of hardware threads, leaving one for the main thread
+	explicit ThreadPool( uint32_t threadCount = 0 );
+	// Finishes the tasks that are already running, drops the ones that haven't started yet
+	~ThreadPool();
+
+	ThreadPool( const ThreadPool& ) = delete;
+	ThreadPool& operator=( const ThreadPool& ) = delete;
+
+	void Submit( std::function<void()> task );
+
+	// Calls function( i ) for every i below count, spread over the workers and the calling thread,
+	// and returns once all of them are done
+	// The calling thread works through the indices too, so this finishes even while every worker is
+	// stuck on something long-running like a file load
+	void ParallelFor( const uint32_t& count, const std::function<void( uint32_t )>& function );
+
+	uint32_t GetThreadCount() const
+	{
+		return workers.size();
+	}
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>, TrackedAllocator<std::function<void()>, MemoryTag::Jobs>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	bool quitting{ false };
+};